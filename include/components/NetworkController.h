@@ -2,23 +2,70 @@
 
 #pragma once
 
+#include <array>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+
+#include "networking/Client.h"
+#include "networking/Interpolation.h"
 #include "objects/Component.h"
 #include "utils/Vector2.h"
 
-class Client;
-
 class NetworkController final : public Component {
+  /**
+   * \brief The seconds between two refreshes of the network statistics shown
+   * in game.
+   */
+  constexpr static double kStatsInterval = 1.0;
+
+  /**
+   * \brief The amount of refreshes between two reports of the network
+   * statistics in the console.
+   */
+  constexpr static uint32_t kReportIntervals = 10;
+
+  /**
+   * \brief A remote player or bullet, which is drawn between the positions
+   * the snapshots gave it.
+   */
+  struct remote_t {
+    std::weak_ptr<GameObject> object{};
+    InterpolationBuffer buffer{};
+  };
+
   std::unique_ptr<Client> client_;
+  std::array<client_event_t, Client::kEventQueueSize> events_{};
   std::weak_ptr<GameObject> players_;
   std::weak_ptr<GameObject> bullets_;
+  std::weak_ptr<GameObject> walls_;
+  std::weak_ptr<GameObject> overlay_;
+  std::unordered_map<uint64_t, remote_t> remotes_{};
+  InterpolationClock clock_{};
+  double tickDuration_{0.0};
+  uint32_t snapshot_{Snapshot::kNoBase};
+  uint32_t snapshotInterval_{std::numeric_limits<uint32_t>::max()};
+  NetworkStats::summary_t report_{};
+  double statsElapsed_{0.0};
+  double reportElapsed_{0.0};
+  uint32_t reportIntervals_{0};
 
-  void createPlayer(uint8_t id, const Vector2<float>& position) const noexcept;
-  void createPlayer(uint8_t id) const noexcept;
-  void removePlayer(uint8_t id) const noexcept;
-  void movePlayer(uint8_t player,
+  void createPlayer(uint32_t id, const Vector2<float>& position) const noexcept;
+  void removePlayer(uint32_t id) noexcept;
+  void movePlayer(uint32_t player,
                   const Vector2<float>& position) const noexcept;
-  void createBullet(const Vector2<float>& position,
-                    const Vector2<double>& velocity) const noexcept;
+  void receiveSnapshot(uint32_t tick) noexcept;
+  void updateEntity(uint64_t entity, uint32_t tick,
+                    const Vector2<float>& position) noexcept;
+  void removeEntity(uint64_t entity) noexcept;
+  void interpolate() noexcept;
+  void updateStats() noexcept;
+  void createBullet(uint32_t id, const Vector2<float>& position) const noexcept;
+  void createWall(uint32_t id, const Vector2<float>& position) const noexcept;
+
+  [[nodiscard]] std::shared_ptr<GameObject> localPlayer() const noexcept;
+  [[nodiscard]] static std::shared_ptr<GameObject> findChild(
+      const std::weak_ptr<GameObject>& parent, uint32_t id) noexcept;
 
  public:
   explicit NetworkController(std::weak_ptr<GameObject> gameObject) noexcept;
@@ -31,5 +78,12 @@ class NetworkController final : public Component {
     return client_;
   }
 
+  /**
+   * \brief The tick the remote players are drawn at, which the server rewinds
+   * the local player's shots to.
+   * \return The tick, or Snapshot::kNoBase before the first snapshot.
+   */
+  [[nodiscard]] uint32_t viewTick() const noexcept;
+
   [[nodiscard]] Json::Value toJson() const noexcept override;
 };
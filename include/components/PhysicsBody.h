@@ -41,14 +41,15 @@ class PhysicsBody final : public Component {
       b2BodyType value) noexcept;
   [[nodiscard]] static PhysicsBodyMask getBodyMaskFromName(
       const std::string& value) noexcept;
+
+  void refresh() noexcept;
+
+ public:
   [[nodiscard]] static uint16_t getMaskFromJson(
       const Json::Value& json) noexcept;
   [[nodiscard]] static b2BodyType getBodyTypeFromName(
       const std::string& value) noexcept;
 
-  void refresh() noexcept;
-
- public:
   explicit PhysicsBody(std::weak_ptr<GameObject> gameObject) noexcept;
   ~PhysicsBody() noexcept override;
 
@@ -2,7 +2,9 @@
 
 #pragma once
 
+#include "networking/Prediction.h"
 #include "objects/Component.h"
+#include "utils/Vector2.h"
 
 class Transform;
 class PhysicsBody;
@@ -15,6 +17,8 @@ class PlayerController final : public Component {
   std::shared_ptr<PhysicsBody> physicsBody_{};
   std::weak_ptr<GameObject> bullets_{};
   std::weak_ptr<NetworkController> network_{};
+  Prediction prediction_{};
+  Vector2<float> velocity_{};
 
  public:
   explicit PlayerController(std::weak_ptr<GameObject> gameObject) noexcept;
@@ -38,6 +42,18 @@ class PlayerController final : public Component {
   }
   inline uint8_t& bulletClip() noexcept { return bulletClip_; }
 
+  /**
+   * \brief Applies a correction from the server, replaying the movement
+   * predicted since the position it refers to.
+   * \param sequence The sequence of the last position the server applied.
+   * \param position Where the server put the player after it.
+   */
+  void reconcile(uint32_t sequence, const Vector2<float>& position) noexcept;
+
+  [[nodiscard]] inline const Prediction& prediction() const noexcept {
+    return prediction_;
+  }
+
   [[nodiscard]] Json::Value toJson() const noexcept override;
   void patch(const Json::Value& json) noexcept override;
 };
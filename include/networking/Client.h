@@ -4,83 +4,250 @@
 
 #include <SDL_net.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <variant>
 
+#include "networking/LinkConditioner.h"
+#include "networking/Messages.h"
+#include "networking/NetworkStats.h"
+#include "networking/Protocol.h"
+#include "networking/ReliableChannel.h"
+#include "networking/Snapshot.h"
+#include "networking/Socket.h"
+#include "networking/UploadPolicy.h"
 #include "utils/Buffer.h"
+#include "utils/DebugAssert.h"
+#include "utils/Registry.h"
+#include "utils/SpscQueue.h"
 #include "utils/Vector2.h"
 
 enum class ClientStatus : uint8_t { kPending, kRunning, kClosed };
 enum class IncomingClientEvent : uint8_t {
   kPlayerIdentify,
-  kPlayerConnect,
-  kPlayerDisconnect,
-  kPlayerInsertPosition,
   kPlayerUpdatePosition,
-  kBulletShoot
+  kWorldSnapshot,
+  kPong,
+  // Produced by the client from the snapshots, never sent by the server:
+  kEntityUpdate,
+  kEntityRemove,
+  // Produced by the client when the game disconnects it:
+  kPlayerDisconnect
 };
-enum class OutgoingClientEvent : uint8_t { kUpdatePosition, kBulletShoot };
 
-struct client_event_base_t {};
-
-struct client_event_identify_t : public client_event_base_t {
-  explicit client_event_identify_t(uint8_t id) : id_(id) {}
-  uint8_t id_;
+struct client_event_identify_t {
+  client_event_identify_t(uint32_t id, uint32_t tickRate)
+      : id_(id), tickRate_(tickRate) {}
+  uint32_t id_;
+  uint32_t tickRate_;
 };
 
-struct client_event_connect_t : public client_event_base_t {
-  explicit client_event_connect_t(uint8_t player) : player_(player) {}
-  uint8_t player_;
+struct client_event_disconnect_t {
+  explicit client_event_disconnect_t(uint32_t player) : player_(player) {}
+  uint32_t player_;
 };
 
-struct client_event_disconnect_t : public client_event_base_t {
-  explicit client_event_disconnect_t(uint8_t player) : player_(player) {}
-  uint8_t player_;
+struct client_event_player_update_t {
+  client_event_player_update_t(uint32_t player, uint32_t sequence,
+                               Vector2<float> position)
+      : player_(player), sequence_(sequence), position_(std::move(position)) {}
+  uint32_t player_;
+  uint32_t sequence_;
+  Vector2<float> position_;
 };
 
-struct client_event_player_insert_t : public client_event_base_t {
-  client_event_player_insert_t(uint8_t player, Vector2<float> position)
-      : player_(player), position_(std::move(position)) {}
-  uint8_t player_;
-  Vector2<float> position_;
+/**
+ * \brief Precedes the changes of every snapshot the client applies.
+ */
+struct client_event_snapshot_t {
+  explicit client_event_snapshot_t(uint32_t tick) : tick_(tick) {}
+  uint32_t tick_;
 };
 
-struct client_event_player_update_t : public client_event_base_t {
-  client_event_player_update_t(uint8_t player, Vector2<float> position)
-      : player_(player), position_(std::move(position)) {}
-  uint8_t player_;
+struct client_event_entity_update_t {
+  client_event_entity_update_t(uint64_t entity, uint32_t tick,
+                               Vector2<float> position)
+      : entity_(entity), tick_(tick), position_(std::move(position)) {}
+  uint64_t entity_;
+  uint32_t tick_;
   Vector2<float> position_;
 };
 
-struct client_event_bullet_shoot_t : public client_event_base_t {
-  client_event_bullet_shoot_t(Vector2<float> position, Vector2<double> velocity)
-      : position_(std::move(position)), velocity_(std::move(velocity)) {}
-  Vector2<float> position_;
-  Vector2<double> velocity_;
+struct client_event_entity_remove_t {
+  explicit client_event_entity_remove_t(uint64_t entity) : entity_(entity) {}
+  uint64_t entity_;
 };
 
+/**
+ * \brief The payload of a client_event_t, stored inline so queueing an event
+ * never allocates.
+ */
+using client_event_data_t =
+    std::variant<std::monostate, client_event_identify_t,
+                 client_event_disconnect_t, client_event_player_update_t,
+                 client_event_snapshot_t, client_event_entity_update_t,
+                 client_event_entity_remove_t>;
+
 struct client_event_t {
   IncomingClientEvent event;
-  client_event_base_t* data;
+  client_event_data_t data;
+};
+
+/**
+ * \brief The data of ClientMessage::kUpdatePosition, a position and the
+ * sequence of the movement command that led to it, which the UploadPolicy
+ * decides whether or not to send along with the velocity of the player.
+ */
+struct client_position_t {
+  uint32_t sequence;
+  Vector2<float> position;
+  Vector2<float> velocity;
+};
+
+/**
+ * \brief The data of ClientMessage::kBulletShoot, the angle the player shot
+ * at and the tick of the snapshots the other players were drawn at.
+ */
+struct client_shoot_t {
+  float angle;
+  uint32_t tick;
 };
 
 class Client {
-  ClientStatus status_ = ClientStatus::kPending;
-  std::unique_ptr<Buffer> buffer_{};
-  std::queue<client_event_t> events_{};
-  std::mutex event_mutex_{};
+ public:
+  /**
+   * \brief The amount of events the network thread can queue before the game
+   * thread reads them.
+   */
+  constexpr static size_t kEventQueueSize = 1024;
+
+  /**
+   * \brief The interval at which the datagram thread sends the pending frames
+   * and acknowledgements.
+   */
+  constexpr static int32_t kDatagramInterval = 16;
+
+  /**
+   * \brief The interval at which the server is pinged to measure the round
+   * trip.
+   */
+  constexpr static std::chrono::milliseconds kPingInterval{250};
+
+ private:
+  using event_queue_t = SpscQueue<client_event_t, kEventQueueSize>;
+
+  struct snapshot_t {
+    uint32_t tick{Snapshot::kNoBase};
+    Snapshot::entities_t entities{};
+  };
+
+  /**
+   * \brief The parts of the snapshot being received, which is only decoded
+   * once all of them arrived.
+   */
+  struct snapshot_assembly_t {
+    uint32_t tick{Snapshot::kNoBase};
+    uint32_t base{Snapshot::kNoBase};
+    uint32_t received{0};
+    uint8_t count{0};
+    std::array<std::vector<uint8_t>, Snapshot::kMaximumParts> parts{};
+  };
+
+  using clock = std::chrono::steady_clock;
+
+  /**
+   * \brief The amount of pings awaiting their pong, a pong that arrives after
+   * as many later pings were sent is not measured.
+   */
+  constexpr static size_t kPingHistory = 16;
+
+  constexpr static uint32_t kPositionKey = 0;
+  constexpr static uint32_t kAcknowledgeKey = 1;
+
+  /**
+   * \brief The largest message the client sends, either the datagram bind
+   * request or a position.
+   */
+  constexpr static size_t kMaximumMessageSize =
+      std::max(BindDatagramMessage::kSize, UpdatePositionMessage::kSize);
+
+  // Set by the TCP and the game threads, and read by all three:
+  std::atomic<ClientStatus> status_{ClientStatus::kPending};
+  Protocol::receive_buffer_t received_{};
+
+  // The TCP and the UDP threads both produce into the queue, one message at a
+  // time under message_mutex_, so the game reads the events in the order their
+  // messages were handled:
+  event_queue_t events_{};
+  std::mutex message_mutex_{};
+
   TCPsocket socket_;
+  Socket datagram_{};
+  ReliableChannel channel_{};
+  std::mutex channel_mutex_{};
+  LinkConditioner conditioner_{};
+  UploadPolicy uploads_{};
+  NetworkStats stats_{};
+
+  // Sent by the game thread, and answered on either network thread. The time
+  // a ping was sent at, zero once it was answered:
+  std::array<std::atomic<clock::rep>, kPingHistory> pings_{};
+  clock::time_point nextPing_{};
+  uint32_t ping_{0};
+  uint32_t serverAddress_{0};
+  uint16_t serverPort_{0};
+  std::atomic<uint32_t> token_{0};
+  std::atomic<bool> identified_{false};
+  std::atomic<bool> datagramReady_{false};
   uint32_t remoteEvent_{0};
   uint32_t event_{0};
-  uint8_t id_{0};
+  // Set on the TCP thread, and read by the datagram thread to bind:
+  std::atomic<uint32_t> id_{Handle::kInvalid};
+  std::atomic<bool> disconnected_{false};
 
-  void deserializeMessage(uint8_t* message) noexcept;
+  // Both the TCP and the UDP threads may receive snapshots, which they handle
+  // under message_mutex_:
+  std::array<snapshot_t, Snapshot::kHistorySize> snapshots_{};
+  snapshot_assembly_t assembly_{};
+  std::vector<uint8_t> snapshotEntries_{};
+  Snapshot::entities_t decoded_{};
+  uint32_t appliedSnapshot_{Snapshot::kNoBase};
+  std::atomic<uint32_t> receivedSnapshot_{Snapshot::kNoBase};
+  uint32_t acknowledgedSnapshot_{Snapshot::kNoBase};
+
+  void deserializeMessage(const uint8_t* message, size_t size) noexcept;
+  void handleMessage(const uint8_t* message, size_t size) noexcept;
+
+  // The handlers of every message the server sends, one of them missing fails
+  // to compile in handleMessage():
+  void handle(PlayerIdentifyMessage, uint32_t id, uint32_t token,
+              uint32_t tickRate) noexcept;
+  void handle(PlayerUpdatePositionMessage, uint32_t player, uint32_t sequence,
+              const Vector2<float>& position) noexcept;
+  void handle(WorldSnapshotMessage, uint32_t tick, uint32_t base, uint8_t part,
+              uint8_t count, const body_field_t::value_t& entries) noexcept;
+  void handle(PongMessage, uint32_t sequence) noexcept;
+
+  void applySnapshot() noexcept;
+  void acknowledgeSnapshot() noexcept;
+  void ping() noexcept;
+  void listenDatagrams() noexcept;
+  void receiveDatagrams() noexcept;
+  bool sendDatagram(const uint8_t* message, size_t size, bool reliable,
+                    uint32_t key = kPositionKey) noexcept;
 
   inline void pushEvent(const client_event_t& event) noexcept {
-    std::lock_guard<std::mutex> guard(event_mutex_);
-    events_.push(event);
+    // The game thread drains the queue every frame, so it only fills up when
+    // the game stalls, in which case the newest events are dropped:
+    if (!events_.push(event)) {
+      debug_print("[CLIENT] Event queue is full, dropping event %i.\n",
+                  event.event);
+    }
   }
 
  public:
@@ -88,39 +255,79 @@ class Client {
   ~Client() noexcept;
   void run() noexcept;
 
-  [[nodiscard]] inline const uint8_t& id() const noexcept { return id_; }
+  [[nodiscard]] inline uint32_t id() const noexcept {
+    return id_.load(std::memory_order_acquire);
+  }
 
   [[nodiscard]] inline bool running() const noexcept {
-    return status_ == ClientStatus::kRunning;
+    return status_.load(std::memory_order_acquire) == ClientStatus::kRunning;
+  }
+
+  /**
+   * \brief Copies the statistics of the connection so far.
+   */
+  [[nodiscard]] NetworkStats::summary_t stats() noexcept;
+
+  /**
+   * \brief Takes what changed in the statistics since the last call, must be
+   * called from the game thread.
+   */
+  [[nodiscard]] inline NetworkStats::summary_t statsInterval() noexcept {
+    return stats_.interval(stats());
+  }
+
+  [[nodiscard]] inline const UploadPolicy& uploads() const noexcept {
+    return uploads_;
+  }
+
+  [[nodiscard]] inline size_t eventQueueHighWaterMark() const noexcept {
+    return events_.highWaterMark();
   }
 
   inline void disconnect() noexcept {
-    pushEvent({IncomingClientEvent::kPlayerDisconnect,
-               new client_event_disconnect_t{id_}});
-    status_ = ClientStatus::kClosed;
+    // This is called from the game thread, which only consumes the queue, so
+    // the event is kept aside and returned first by the next readEvents():
+    disconnected_.store(true, std::memory_order_release);
+    status_.store(ClientStatus::kClosed, std::memory_order_release);
   }
 
-  inline void send(uint8_t* message, int32_t size) noexcept {
-    buffer_->writeUint32(message, event_, 0);
+  inline void send(uint8_t* message, size_t size) noexcept {
+    BufferWriter writer{message, size, Protocol::kSizeOffset};
+    writer.writeUint16(static_cast<uint16_t>(size));
+    writer.writeUint32(event_);
 
-    if (SDLNet_TCP_Send(socket_, message, size) != size) {
+    const auto length = static_cast<int32_t>(size);
+    if (SDLNet_TCP_Send(socket_, message, length) != length) {
       // Not all bits were sent, meaning an abrupt disconnection or unknown
       // socket error.
       disconnect();
       return;
     }
 
+    stats_.sent(message[Protocol::kTypeOffset], size);
     ++event_;
   }
 
-  void send(OutgoingClientEvent event, const void* data = nullptr) noexcept;
+  void send(ClientMessage type, const void* data = nullptr) noexcept;
 
-  inline bool readEvent(client_event_t* event) noexcept {
-    std::lock_guard<std::mutex> guard(event_mutex_);
-    if (events_.empty()) return false;
+  /**
+   * \brief Takes every pending event at once, acknowledges the latest
+   * snapshot they came from, and pings the server when it is due, must be
+   * called from the game thread.
+   * \param events The destination, must fit at least size events.
+   * \param size The maximum amount of events to take.
+   * \return The amount of events taken.
+   */
+  inline size_t readEvents(client_event_t* events, size_t size) noexcept {
+    size_t count = 0;
+    if (size != 0 && disconnected_.exchange(false, std::memory_order_acq_rel)) {
+      events[count++] = {IncomingClientEvent::kPlayerDisconnect,
+                         client_event_disconnect_t{id()}};
+    }
 
-    *event = events_.front();
-    events_.pop();
-    return true;
+    count += events_.drain(events + count, size - count);
+    acknowledgeSnapshot();
+    ping();
+    return count;
   }
 };
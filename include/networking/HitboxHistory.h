@@ -0,0 +1,114 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utils/Vector2.h"
+
+/**
+ * \brief Where the players of a simulation were during the last kCapacity
+ * ticks, so a shot can be checked against the world its shooter saw rather
+ * than the one the server has moved on to. Every player shares the same
+ * hitbox, so a tick only stores each player's handle and center, one array per
+ * field, which a rewind walks linearly. The arrays keep their capacity as the
+ * ring wraps around, so recording a tick does not allocate once every frame
+ * has grown to fit the players.
+ *
+ * \note Not thread-safe, it is owned by a room of the server.
+ */
+class HitboxHistory final {
+ public:
+  /**
+   * \brief The amount of ticks kept, a second at the default tick rate.
+   */
+  constexpr static size_t kCapacity = 64;
+
+  /**
+   * \brief A hitbox a segment went through.
+   */
+  struct hit_t {
+    uint32_t id;
+    Vector2<float> center;
+    float fraction;
+  };
+
+ private:
+  struct frame_t {
+    uint32_t tick{0};
+    bool recorded{false};
+    std::vector<uint32_t> ids{};
+    std::vector<float> x{};
+    std::vector<float> y{};
+  };
+
+  std::array<frame_t, kCapacity> frames_{};
+  Vector2<float> extent_{};
+
+  [[nodiscard]] inline frame_t& frame(uint32_t tick) noexcept {
+    return frames_[tick % kCapacity];
+  }
+
+  [[nodiscard]] inline const frame_t& frame(uint32_t tick) const noexcept {
+    return frames_[tick % kCapacity];
+  }
+
+ public:
+  /**
+   * \brief Sets the half of the size of the players' hitbox.
+   */
+  inline void extent(const Vector2<float>& extent) noexcept {
+    extent_ = extent;
+  }
+
+  /**
+   * \brief Starts recording a tick, replacing the one kCapacity ticks older.
+   */
+  inline void begin(uint32_t tick) noexcept {
+    auto& data = frame(tick);
+    data.tick = tick;
+    data.recorded = true;
+    data.ids.clear();
+    data.x.clear();
+    data.y.clear();
+  }
+
+  /**
+   * \brief Records where a player was at the tick being recorded.
+   * \param tick The tick passed to the last begin().
+   * \param id The handle of the player.
+   * \param center The center of its hitbox.
+   */
+  inline void add(uint32_t tick, uint32_t id,
+                  const Vector2<float>& center) noexcept {
+    auto& data = frame(tick);
+    data.ids.push_back(id);
+    data.x.push_back(center.x());
+    data.y.push_back(center.y());
+  }
+
+  /**
+   * \brief Whether or not the players' hitboxes at a tick are still kept.
+   */
+  [[nodiscard]] inline bool contains(uint32_t tick) const noexcept {
+    const auto& data = frame(tick);
+    return data.recorded && data.tick == tick;
+  }
+
+  /**
+   * \brief Finds the first hitbox a moving box went through at a tick.
+   * \param tick The tick, which must be contains().
+   * \param from Where the center of the box starts.
+   * \param to Where the center of the box ends.
+   * \param size The half of the size of the box.
+   * \param ignore The handle of a player that cannot be hit, the shooter.
+   * \param hit The output, only written to when there is a hit.
+   * \return Whether or not there was one.
+   */
+  bool sweep(uint32_t tick, const Vector2<float>& from,
+             const Vector2<float>& to, const Vector2<float>& size,
+             uint32_t ignore, hit_t* hit) const noexcept;
+};
@@ -0,0 +1,72 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "networking/Snapshot.h"
+#include "utils/Vector2.h"
+
+/**
+ * \brief A spatial hash of the entities of a snapshot, which finds the ones
+ * around a position without walking all of them. Each cell of kCellSize units
+ * is hashed into one of kBucketCount buckets, and the buckets are stored one
+ * after the other, so rebuilding it every tick does not allocate once the
+ * index list has grown to fit the world.
+ *
+ * \note Not thread-safe, it is owned by a room of the server.
+ */
+class InterestGrid final {
+ public:
+  constexpr static float kCellSize = 128.f;
+  constexpr static size_t kBucketCount = 1024;
+
+ private:
+  // Keeps the cell coordinates far from overflowing, whatever a body's
+  // position is:
+  constexpr static float kMaximumCell = 1048576.f;
+
+  const Snapshot::entities_t* entities_{nullptr};
+  std::array<uint32_t, kBucketCount + 1> offsets_{};
+  std::vector<uint32_t> indices_{};
+
+  [[nodiscard]] static int32_t cell(float value) noexcept;
+
+  [[nodiscard]] static inline size_t bucket(int32_t x, int32_t y) noexcept {
+    return ((static_cast<uint32_t>(x) * 73856093u) ^
+            (static_cast<uint32_t>(y) * 19349663u)) %
+           kBucketCount;
+  }
+
+ public:
+  /**
+   * \brief Indexes the entities of a snapshot, replacing the previous ones.
+   * \param entities The entities, which must outlive the queries.
+   */
+  void build(const Snapshot::entities_t& entities) noexcept;
+
+  /**
+   * \brief Finds the entities inside a rectangle.
+   * \param center The center of the rectangle.
+   * \param extent The half of the rectangle's size.
+   * \param indices The output, replaced with the indices of the entities in
+   * ascending order, which is also their key order.
+   */
+  void query(const Vector2<float>& center, const Vector2<float>& extent,
+             std::vector<uint32_t>* indices) const noexcept;
+
+  /**
+   * \brief Whether or not a position is inside a rectangle.
+   */
+  [[nodiscard]] static inline bool contains(
+      const Vector2<float>& center, const Vector2<float>& extent,
+      const Vector2<float>& position) noexcept {
+    return position.x() >= center.x() - extent.x() &&
+           position.x() <= center.x() + extent.x() &&
+           position.y() >= center.y() - extent.y() &&
+           position.y() <= center.y() + extent.y();
+  }
+};
@@ -0,0 +1,131 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/Vector2.h"
+
+/**
+ * \brief The latest positions the server sent for a remote entity, each of
+ * them stamped with the time of the snapshot it came in, so the entity can be
+ * drawn at any time between them instead of jumping to each one as it
+ * arrives. The samples are kept in a ring, so pushing one never allocates.
+ *
+ * \note Not thread-safe, it is owned by the game thread.
+ */
+class InterpolationBuffer final {
+ public:
+  /**
+   * \brief The amount of samples kept, which covers over a second of
+   * snapshots, far more than the delay they are drawn behind.
+   */
+  constexpr static size_t kCapacity = 32;
+
+  /**
+   * \brief The longest time an entity keeps moving past its latest sample,
+   * after which it stops until the next one arrives.
+   */
+  constexpr static double kMaximumExtrapolation = 0.25;
+
+ private:
+  struct sample_t {
+    double time;
+    Vector2<float> position;
+  };
+
+  std::array<sample_t, kCapacity> samples_{};
+  size_t next_{0};
+  size_t size_{0};
+
+  /**
+   * \brief Gets a sample, in time order from the oldest one kept.
+   */
+  [[nodiscard]] inline const sample_t& at(size_t index) const noexcept {
+    return samples_[(next_ + kCapacity - size_ + index) % kCapacity];
+  }
+
+ public:
+  /**
+   * \brief Adds a sample, replacing the oldest one when the buffer is full.
+   * \param time The time of the snapshot it came in, in seconds. A sample not
+   * newer than the latest one arrived out of order, and is ignored.
+   * \param position The position of the entity at that time.
+   */
+  void push(double time, const Vector2<float>& position) noexcept;
+
+  /**
+   * \brief Finds the position of the entity at a given time: between the two
+   * samples around it, or moving on from the latest one for a brief gap.
+   * \param time The time, in seconds.
+   * \note Must not be called while empty().
+   */
+  [[nodiscard]] Vector2<float> sample(double time) const noexcept;
+
+  /**
+   * \brief Repeats the latest position at a later time, for an entity that
+   * did not move since.
+   */
+  inline void hold(double time) noexcept {
+    if (size_ != 0) push(time, at(size_ - 1).position);
+  }
+
+  [[nodiscard]] inline bool empty() const noexcept { return size_ == 0; }
+};
+
+/**
+ * \brief The time remote entities are drawn at, which runs at the pace of the
+ * game a delay behind the latest snapshot. The delay leaves room for the next
+ * snapshot to arrive before it is needed, and is read in milliseconds from the
+ * OBSTACLE_RUN_INTERPOLATION_DELAY environment variable.
+ *
+ * \note Not thread-safe, it is owned by the game thread.
+ */
+class InterpolationClock final {
+ public:
+  /**
+   * \brief The delay when none is given, two snapshots at 20 Hz.
+   */
+  constexpr static double kDefaultDelay = 0.1;
+
+  /**
+   * \brief How far the clock may drift from its target before it jumps to it
+   * instead of catching up, after a stall or on the first snapshot.
+   */
+  constexpr static double kMaximumDrift = 0.25;
+
+  /**
+   * \brief The share of the drift the clock catches up with per second, so
+   * the jitter of the snapshots does not change the speed entities move at.
+   */
+  constexpr static double kCatchUpRate = 2.0;
+
+ private:
+  double delay_;
+  double time_{0.0};
+  double latest_{0.0};
+  bool started_{false};
+
+ public:
+  InterpolationClock() noexcept;
+
+  /**
+   * \brief Reports the time of a snapshot that arrived.
+   */
+  inline void receive(double time) noexcept {
+    if (!started_ || time > latest_) latest_ = time;
+    started_ = true;
+  }
+
+  /**
+   * \brief Moves the clock forwards, called once per frame.
+   * \param delta The seconds since the last frame.
+   */
+  void advance(double delta) noexcept;
+
+  [[nodiscard]] inline double time() const noexcept { return time_; }
+
+  [[nodiscard]] inline double delay() const noexcept { return delay_; }
+};
@@ -0,0 +1,53 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "networking/Socket.h"
+
+/**
+ * \brief Sends datagrams through a simulated bad link, so the UDP transport can
+ * be tested over loopback. The percentage of datagrams to drop and the
+ * milliseconds to delay them are read from the OBSTACLE_RUN_PACKET_LOSS and
+ * OBSTACLE_RUN_LATENCY environment variables, datagrams are sent right away
+ * when neither is set.
+ *
+ * \note Not thread-safe.
+ */
+class LinkConditioner final {
+  struct delayed_t {
+    std::chrono::steady_clock::time_point at;
+    std::vector<uint8_t> data;
+    uint32_t ipAddress;
+    uint16_t port;
+  };
+
+  std::deque<delayed_t> delayed_{};
+  std::mt19937 random_{std::random_device{}()};
+  std::chrono::milliseconds latency_{0};
+  uint32_t loss_{0};
+
+ public:
+  LinkConditioner() noexcept;
+
+  [[nodiscard]] inline bool enabled() const noexcept {
+    return loss_ != 0 || latency_.count() != 0;
+  }
+
+  /**
+   * \brief Sends, drops or delays a datagram.
+   */
+  void send(const Socket& socket, const uint8_t* data, size_t size,
+            uint32_t ipAddress, uint16_t port) noexcept;
+
+  /**
+   * \brief Sends the delayed datagrams that are due, call it regularly.
+   */
+  void update(const Socket& socket) noexcept;
+};
@@ -0,0 +1,427 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "networking/Protocol.h"
+#include "networking/Snapshot.h"
+#include "utils/Buffer.h"
+#include "utils/Vector2.h"
+
+/**
+ * \brief The types of the messages the server sends, in the order of their
+ * schemas in ServerMessages.
+ */
+enum class ServerMessage : uint8_t {
+  kPlayerIdentify,
+  kPlayerUpdatePosition,
+  kWorldSnapshot,
+  kPong
+};
+
+/**
+ * \brief The types of the messages the client sends, in the order of their
+ * schemas in ClientMessages.
+ */
+enum class ClientMessage : uint8_t {
+  kUpdatePosition,
+  kBulletShoot,
+  kBindDatagram,
+  kAcknowledgeSnapshot,
+  kPing
+};
+
+/**
+ * \brief The name of a message type, for the network statistics.
+ */
+[[nodiscard]] constexpr inline const char* name(ServerMessage type) noexcept {
+  switch (type) {
+    case ServerMessage::kPlayerIdentify:
+      return "identify";
+    case ServerMessage::kPlayerUpdatePosition:
+      return "correction";
+    case ServerMessage::kWorldSnapshot:
+      return "snapshot";
+    case ServerMessage::kPong:
+      return "pong";
+  }
+  return "unknown";
+}
+
+[[nodiscard]] constexpr inline const char* name(ClientMessage type) noexcept {
+  switch (type) {
+    case ClientMessage::kUpdatePosition:
+      return "position";
+    case ClientMessage::kBulletShoot:
+      return "shoot";
+    case ClientMessage::kBindDatagram:
+      return "bind";
+    case ClientMessage::kAcknowledgeSnapshot:
+      return "ack";
+    case ClientMessage::kPing:
+      return "ping";
+  }
+  return "unknown";
+}
+
+// The fields a message is made of. Each of them knows its size on the wire
+// and how to write and read its value at a given address:
+
+struct uint8_field_t {
+  using value_t = uint8_t;
+  constexpr static size_t kSize = sizeof(uint8_t);
+
+  [[nodiscard]] constexpr static inline size_t size(value_t) noexcept {
+    return kSize;
+  }
+
+  static inline void write(uint8_t* data, value_t value) noexcept {
+    data[0] = value;
+  }
+
+  [[nodiscard]] static inline value_t read(const uint8_t* data,
+                                           size_t) noexcept {
+    return data[0];
+  }
+};
+
+struct uint32_field_t {
+  using value_t = uint32_t;
+  constexpr static size_t kSize = sizeof(uint32_t);
+
+  [[nodiscard]] constexpr static inline size_t size(value_t) noexcept {
+    return kSize;
+  }
+
+  static inline void write(uint8_t* data, value_t value) noexcept {
+    const Buffer buffer{};
+    buffer.writeUint32(data, value, 0);
+  }
+
+  [[nodiscard]] static inline value_t read(const uint8_t* data,
+                                           size_t) noexcept {
+    const Buffer buffer{};
+    return buffer.readUInt32(data, 0);
+  }
+};
+
+/**
+ * \brief A position, quantized by Protocol::writePosition().
+ */
+struct position_field_t {
+  using value_t = Vector2<float>;
+  constexpr static size_t kSize = Protocol::kPositionSize;
+
+  [[nodiscard]] static inline size_t size(const value_t&) noexcept {
+    return kSize;
+  }
+
+  static inline void write(uint8_t* data, const value_t& value) noexcept {
+    Protocol::writePosition(data, value, 0);
+  }
+
+  [[nodiscard]] static inline value_t read(const uint8_t* data,
+                                           size_t) noexcept {
+    return Protocol::readPosition(data, 0);
+  }
+};
+
+/**
+ * \brief An angle, quantized by Protocol::writeAngle().
+ */
+struct angle_field_t {
+  using value_t = float;
+  constexpr static size_t kSize = Protocol::kAngleSize;
+
+  [[nodiscard]] constexpr static inline size_t size(value_t) noexcept {
+    return kSize;
+  }
+
+  static inline void write(uint8_t* data, value_t value) noexcept {
+    Protocol::writeAngle(data, value, 0);
+  }
+
+  [[nodiscard]] static inline value_t read(const uint8_t* data,
+                                           size_t) noexcept {
+    return Protocol::readAngle(data, 0);
+  }
+};
+
+/**
+ * \brief The bytes that fill the rest of a message, only allowed as its last
+ * field. A message with a body has a minimum size instead of an exact one.
+ */
+struct body_field_t {
+  struct value_t {
+    const uint8_t* data{nullptr};
+    size_t size{0};
+  };
+
+  constexpr static size_t kSize = 0;
+
+  [[nodiscard]] static inline size_t size(const value_t& value) noexcept {
+    return value.size;
+  }
+
+  static inline void write(uint8_t* data, const value_t& value) noexcept {
+    if (value.size != 0) std::memcpy(data, value.data, value.size);
+  }
+
+  [[nodiscard]] static inline value_t read(const uint8_t* data,
+                                           size_t remaining) noexcept {
+    return {data, remaining};
+  }
+};
+
+/**
+ * \brief The schema of a message: its type and its fields, in order. The
+ * offset of every field and the size of the message are computed at compile
+ * time, so encoding and decoding it are fixed-size writes and reads:
+ *
+ * | header {7} | field... |
+ *
+ * \tparam Type The type of the message, a ServerMessage or a ClientMessage.
+ * \tparam Fields The fields that follow the header.
+ */
+template <auto Type, typename... Fields>
+class Message final {
+  using offsets_t = std::array<size_t, sizeof...(Fields) + 1>;
+  using last_t = std::tuple_element_t<sizeof...(Fields),
+                                      std::tuple<void, Fields...>>;
+
+  constexpr static offsets_t offsets() noexcept {
+    offsets_t offsets{};
+    const size_t sizes[] = {Fields::kSize..., 0};
+    offsets[0] = Protocol::kHeaderSize;
+    for (size_t i = 0; i < sizeof...(Fields); ++i) {
+      offsets[i + 1] = offsets[i] + sizes[i];
+    }
+    return offsets;
+  }
+
+  constexpr static offsets_t kOffsets = offsets();
+
+  template <size_t... I>
+  static inline void write(uint8_t* message, std::index_sequence<I...>,
+                           const typename Fields::value_t&... values) noexcept {
+    (Fields::write(message + kOffsets[I], values), ...);
+  }
+
+  template <typename Values, size_t... I>
+  static inline void read(const uint8_t* message, size_t size,
+                          std::index_sequence<I...>, Values* values) noexcept {
+    ((std::get<I>(*values) =
+          Fields::read(message + kOffsets[I], size - kOffsets[I])),
+     ...);
+  }
+
+ public:
+  using type_t = decltype(Type);
+  using values_t = std::tuple<typename Fields::value_t...>;
+
+  constexpr static type_t kType = Type;
+
+  /**
+   * \brief Whether or not the message ends with a body_field_t.
+   */
+  constexpr static bool kBody = std::is_same_v<last_t, body_field_t>;
+
+  static_assert(
+      (static_cast<size_t>(std::is_same_v<Fields, body_field_t>) + ... + 0) ==
+          static_cast<size_t>(kBody),
+      "A body may only be the last field of a message");
+
+  /**
+   * \brief The size of the message, header included, and without its body.
+   */
+  constexpr static size_t kSize = kOffsets[sizeof...(Fields)];
+
+  static_assert(kSize <= Protocol::kMaximumFrameSize,
+                "A message must fit a frame");
+
+  /**
+   * \brief Gets the offset of a field from the start of the message.
+   */
+  template <size_t Index>
+  [[nodiscard]] constexpr static inline size_t offset() noexcept {
+    static_assert(Index < sizeof...(Fields), "'Index' must name a field");
+    return kOffsets[Index];
+  }
+
+  /**
+   * \brief Writes the type and the fields of the message, leaving the frame
+   * size and the event counter to whoever sends it.
+   * \param message The output, which must fit the message.
+   * \param values The value of each field.
+   * \return The size of the message.
+   */
+  template <size_t N>
+  static inline size_t encode(
+      uint8_t (&message)[N],
+      const typename Fields::value_t&... values) noexcept {
+    static_assert(N >= kSize, "The buffer must fit the message");
+    const auto size = (Fields::size(values) + ... + Protocol::kHeaderSize);
+    assert(((void)"The body must fit the buffer", size <= N));
+
+    message[Protocol::kTypeOffset] = static_cast<uint8_t>(Type);
+    write(message, std::index_sequence_for<Fields...>{}, values...);
+    return size;
+  }
+
+  /**
+   * \brief Reads the fields of a received message.
+   * \param message The message, header included.
+   * \param size The size of the message.
+   * \param values The output, the value of each field.
+   * \return Whether or not the message is of this type and of its exact size,
+   * or at least its size if it has a body.
+   */
+  static inline bool decode(const uint8_t* message, size_t size,
+                            values_t* values) noexcept {
+    if (kBody ? size < kSize : size != kSize) return false;
+    if (message[Protocol::kTypeOffset] != static_cast<uint8_t>(Type)) {
+      return false;
+    }
+
+    read(message, size, std::index_sequence_for<Fields...>{}, values);
+    return true;
+  }
+};
+
+/**
+ * \brief The messages one side receives, listed in the order of their types,
+ * which dispatches each of them to its handler through a table built at
+ * compile time.
+ */
+template <typename... Messages>
+class MessageSet final {
+  template <size_t... I>
+  constexpr static bool ordered(std::index_sequence<I...>) noexcept {
+    return ((static_cast<size_t>(Messages::kType) == I) && ...);
+  }
+
+  static_assert(ordered(std::index_sequence_for<Messages...>{}),
+                "The messages must be listed in the order of their types");
+
+  template <typename Message, typename Handler>
+  static bool receive(const uint8_t* message, size_t size,
+                      Handler& handler) noexcept {
+    typename Message::values_t values;
+    if (!Message::decode(message, size, &values)) return false;
+
+    std::apply([&](const auto&... fields) { handler(Message{}, fields...); },
+               values);
+    return true;
+  }
+
+ public:
+  constexpr static size_t kCount = sizeof...(Messages);
+
+  /**
+   * \brief Decodes a message and calls the handler with it.
+   * \param message The message, header included.
+   * \param size The size of the message.
+   * \param handler The callable invoked with (Message, fields...), which must
+   * accept every message of the set, so a message one side sends and the
+   * other does not handle fails to compile.
+   * \return Whether or not the message was one of the set, and well-formed.
+   */
+  template <typename Handler>
+  static bool dispatch(const uint8_t* message, size_t size,
+                       Handler&& handler) noexcept {
+    using receiver_t = bool (*)(const uint8_t*, size_t, Handler&);
+    constexpr receiver_t receivers[] = {&receive<Messages, Handler>...};
+
+    if (size < Protocol::kHeaderSize) return false;
+
+    const auto type = message[Protocol::kTypeOffset];
+    return type < kCount && receivers[type](message, size, handler);
+  }
+};
+
+// The messages the server sends:
+
+/**
+ * \brief The ID of the player, the token that binds its datagrams, and the
+ * tick rate of the server, which turns the tick of a snapshot into its time.
+ */
+using PlayerIdentifyMessage =
+    Message<ServerMessage::kPlayerIdentify, uint32_field_t, uint32_field_t,
+            uint32_field_t>;
+/**
+ * \brief A correction of the client's own player: its ID, the sequence of the
+ * last position the server applied, and where it put the player after it.
+ */
+using PlayerUpdatePositionMessage =
+    Message<ServerMessage::kPlayerUpdatePosition, uint32_field_t,
+            uint32_field_t, position_field_t>;
+
+/**
+ * \brief A part of a snapshot: its tick, base, part and parts, and the
+ * entries it carries as the body.
+ */
+using WorldSnapshotMessage =
+    Message<ServerMessage::kWorldSnapshot, uint32_field_t, uint32_field_t,
+            uint8_field_t, uint8_field_t, body_field_t>;
+
+/**
+ * \brief The sequence of the ping it answers.
+ */
+using PongMessage = Message<ServerMessage::kPong, uint32_field_t>;
+
+using ServerMessages =
+    MessageSet<PlayerIdentifyMessage, PlayerUpdatePositionMessage,
+               WorldSnapshotMessage, PongMessage>;
+
+static_assert(WorldSnapshotMessage::offset<0>() - Protocol::kHeaderSize ==
+                      Snapshot::kTickOffset &&
+                  WorldSnapshotMessage::offset<1>() - Protocol::kHeaderSize ==
+                      Snapshot::kBaseOffset &&
+                  WorldSnapshotMessage::offset<2>() - Protocol::kHeaderSize ==
+                      Snapshot::kPartOffset &&
+                  WorldSnapshotMessage::offset<3>() - Protocol::kHeaderSize ==
+                      Snapshot::kPartsOffset &&
+                  WorldSnapshotMessage::kSize - Protocol::kHeaderSize ==
+                      Snapshot::kHeaderSize,
+              "The snapshot message must match the layout of Snapshot");
+
+// The messages the client sends:
+
+/**
+ * \brief The sequence of the movement command that led to a position, and the
+ * position.
+ */
+using UpdatePositionMessage =
+    Message<ClientMessage::kUpdatePosition, uint32_field_t, position_field_t>;
+
+/**
+ * \brief The angle the player shot at, and the tick of the snapshots the
+ * client saw the other players at, which the server rewinds the shot to.
+ */
+using BulletShootMessage =
+    Message<ClientMessage::kBulletShoot, angle_field_t, uint32_field_t>;
+
+/**
+ * \brief The ID and the token the client was identified with.
+ */
+using BindDatagramMessage =
+    Message<ClientMessage::kBindDatagram, uint32_field_t, uint32_field_t>;
+using AcknowledgeSnapshotMessage =
+    Message<ClientMessage::kAcknowledgeSnapshot, uint32_field_t>;
+
+/**
+ * \brief A sequence the server answers with a PongMessage.
+ */
+using PingMessage = Message<ClientMessage::kPing, uint32_field_t>;
+
+using ClientMessages =
+    MessageSet<UpdatePositionMessage, BulletShootMessage, BindDatagramMessage,
+               AcknowledgeSnapshotMessage, PingMessage>;
@@ -0,0 +1,175 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/**
+ * \brief The traffic of a connection: the messages and bytes sent and received
+ * per message type, the messages dropped for arriving out of order, the round
+ * trip time and its jitter, the depth of its queues, and the heap allocations
+ * made while handling what it received. The counters are
+ * updated by the network threads and read by any other. The round trip is
+ * smoothed as TCP does, and its jitter is the smoothed deviation of each
+ * sample from it.
+ *
+ * The bytes are those of the messages, headers included, but not those of the
+ * transport they travel through.
+ */
+class NetworkStats final {
+ public:
+  /**
+   * \brief The amount of message types counted, either side has fewer.
+   */
+  constexpr static size_t kTypes = 8;
+
+  /**
+   * \brief The weight of a round trip sample in the smoothed round trip.
+   */
+  constexpr static double kRoundTripGain = 1.0 / 8.0;
+
+  /**
+   * \brief The weight of a round trip's deviation in the jitter.
+   */
+  constexpr static double kJitterGain = 1.0 / 16.0;
+
+  /**
+   * \brief Which side of the connection the statistics are kept by, as it
+   * tells apart the types of the messages sent from the received ones.
+   */
+  enum class Side : uint8_t { kClient, kServer };
+
+  struct counters_t {
+    uint64_t messages{0};
+    uint64_t bytes{0};
+  };
+
+  /**
+   * \brief A copy of the statistics at a point in time, or of what changed in
+   * an interval.
+   */
+  struct summary_t {
+    std::array<counters_t, kTypes> in{};
+    std::array<counters_t, kTypes> out{};
+    uint64_t dropped{0};
+    uint64_t reliableSent{0};
+    uint64_t resent{0};
+    uint64_t allocations{0};
+    uint64_t roundTrips{0};
+    double roundTrip{0.0};
+    double jitter{0.0};
+    size_t inboundQueue{0};
+    size_t outboundQueue{0};
+
+    [[nodiscard]] counters_t totalIn() const noexcept;
+    [[nodiscard]] counters_t totalOut() const noexcept;
+
+    /**
+     * \brief Adds the statistics of another connection, the round trip is
+     * averaged by the samples of each, and the queues keep the deepest.
+     */
+    summary_t& operator+=(const summary_t& other) noexcept;
+  };
+
+ private:
+  struct atomic_counters_t {
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> bytes{0};
+  };
+
+  std::array<atomic_counters_t, kTypes> in_{};
+  std::array<atomic_counters_t, kTypes> out_{};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> allocations_{0};
+
+  // Both the TCP and the UDP threads may measure a round trip:
+  mutable std::mutex roundTrip_mutex_{};
+  uint64_t roundTrips_{0};
+  double roundTrip_{0.0};
+  double jitter_{0.0};
+
+  // Only accessed by the thread that reports the intervals:
+  summary_t reported_{};
+
+  static void count(atomic_counters_t& counters, size_t size) noexcept {
+    counters.messages.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+
+ public:
+  /**
+   * \brief Counts a message received, before it is handled.
+   * \param type The type of the message, a type out of range is not counted.
+   * \param size The size of the message, header included.
+   */
+  inline void received(uint8_t type, size_t size) noexcept {
+    if (type < kTypes) count(in_[type], size);
+  }
+
+  /**
+   * \brief Counts a message sent.
+   * \param type The type of the message, a type out of range is not counted.
+   * \param size The size of the message, header included.
+   */
+  inline void sent(uint8_t type, size_t size) noexcept {
+    if (type < kTypes) count(out_[type], size);
+  }
+
+  /**
+   * \brief Counts a message dropped as its event counter did not match the
+   * one expected.
+   */
+  inline void dropped() noexcept {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief Counts the heap allocations a network thread made while it read
+   * and handled messages, which only the builds that count them report.
+   * \param count The difference of Allocations::count() around the handling.
+   */
+  inline void allocated(size_t count) noexcept {
+    if (count != 0) allocations_.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief Adds a round trip sample.
+   * \param milliseconds The time between a ping and its pong.
+   */
+  void roundTrip(double milliseconds) noexcept;
+
+  /**
+   * \brief Copies the statistics so far.
+   * \param reliableSent The reliable frames written, resends included.
+   * \param resent The reliable frames written again.
+   * \param inboundQueue The events waiting to be handled.
+   * \param outboundQueue The messages waiting to be sent or acknowledged.
+   * \note The transport and the queues are owned by the connection, which
+   * passes them along.
+   */
+  [[nodiscard]] summary_t summary(uint64_t reliableSent, uint64_t resent,
+                                  size_t inboundQueue,
+                                  size_t outboundQueue) const noexcept;
+
+  /**
+   * \brief Takes what changed since the last call, the round trip and the
+   * queues are kept as they are now.
+   * \param now The statistics so far, from summary().
+   */
+  [[nodiscard]] summary_t interval(const summary_t& now) noexcept;
+
+  /**
+   * \brief Describes the statistics in a line, as the rates over an interval.
+   * \param summary What changed in the interval.
+   * \param seconds The length of the interval.
+   * \param side The side that kept the statistics.
+   */
+  [[nodiscard]] static std::string describe(const summary_t& summary,
+                                            double seconds,
+                                            Side side) noexcept;
+};
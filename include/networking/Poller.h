@@ -0,0 +1,68 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "networking/Socket.h"
+
+#if __linux__
+#define OBSTACLE_RUN_EPOLL 1
+#else
+#define OBSTACLE_RUN_EPOLL 0
+#if !_WIN32
+#include <poll.h>
+#endif
+#endif
+
+struct poller_event_t {
+  void* data;
+  bool readable;
+  bool closed;
+};
+
+/**
+ * \brief Waits for readiness on many sockets at once. It is backed by epoll on
+ * Linux, and by poll/WSAPoll everywhere else.
+ *
+ * \note Not thread-safe, add(), remove() and wait() must be called from the
+ * same thread.
+ */
+class Poller final {
+#if OBSTACLE_RUN_EPOLL
+  int epoll_;
+#else
+  std::vector<pollfd> descriptors_{};
+  std::vector<void*> data_{};
+#endif
+
+ public:
+  Poller() noexcept;
+  Poller(const Poller&) = delete;
+  ~Poller() noexcept;
+
+  Poller& operator=(const Poller&) = delete;
+
+  [[nodiscard]] bool valid() const noexcept;
+
+  /**
+   * \brief Watches a socket for incoming data.
+   * \param socket The socket to watch.
+   * \param data The value reported back by wait() when the socket is ready.
+   */
+  bool add(const Socket& socket, void* data) noexcept;
+
+  void remove(const Socket& socket) noexcept;
+
+  /**
+   * \brief Waits until any watched socket becomes ready or the timeout
+   * expires.
+   * \param events The output array of ready sockets.
+   * \param size The capacity of events.
+   * \param timeout The maximum amount of milliseconds to wait.
+   * \return The amount of events written.
+   */
+  size_t wait(poller_event_t* events, size_t size, int32_t timeout) noexcept;
+};
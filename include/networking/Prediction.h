@@ -0,0 +1,95 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/Vector2.h"
+
+/**
+ * \brief The movement commands of the local player that the server has not
+ * confirmed yet. The player moves as soon as its input is read, and every
+ * position it reports is numbered by the command that led to it. When the
+ * server corrects one of them, the commands that followed are replayed from
+ * the corrected position, and the player is eased into the result instead of
+ * snapping to it. The commands are kept in a ring, so recording one never
+ * allocates.
+ *
+ * \note Not thread-safe, it is owned by the game thread.
+ */
+class Prediction final {
+ public:
+  /**
+   * \brief The amount of commands kept, two seconds of frames at 60 FPS,
+   * far more than a round trip. A correction for an older one is ignored.
+   */
+  constexpr static size_t kCapacity = 128;
+
+  /**
+   * \brief The share of the remaining error corrected per second.
+   */
+  constexpr static float kSmoothingRate = 10.f;
+
+  /**
+   * \brief The error past which the player is moved right away, as easing it
+   * over such a distance would look like it slides through the world.
+   */
+  constexpr static float kSnapDistance = 128.f;
+
+ private:
+  struct command_t {
+    Vector2<float> velocity;
+    float duration;
+  };
+
+  std::array<command_t, kCapacity> commands_{};
+  Vector2<float> error_{};
+  uint32_t next_{0};
+  uint32_t confirmed_{0};
+  uint32_t corrections_{0};
+
+  [[nodiscard]] inline command_t& at(uint32_t sequence) noexcept {
+    return commands_[sequence % kCapacity];
+  }
+
+ public:
+  /**
+   * \brief Records the command of a frame.
+   * \param velocity The velocity the input gave the player.
+   * \param duration The seconds the velocity was applied for.
+   * \return The sequence of the command, which is reported to the server along
+   * with the position the player reached.
+   */
+  uint32_t record(const Vector2<float>& velocity, float duration) noexcept;
+
+  /**
+   * \brief Replays the commands that followed a corrected one.
+   * \param sequence The last command the server applied.
+   * \param position The position the server put the player at after it.
+   * \param current The position the player is at now.
+   * \return Whether or not the correction was applied, a correction older than
+   * the last one, or for a command no longer kept, is ignored.
+   */
+  bool reconcile(uint32_t sequence, const Vector2<float>& position,
+                 const Vector2<float>& current) noexcept;
+
+  /**
+   * \brief Takes the share of the remaining error to correct this frame.
+   * \param delta The seconds since the last frame.
+   * \return The offset to move the player by.
+   */
+  [[nodiscard]] Vector2<float> smooth(float delta) noexcept;
+
+  /**
+   * \brief The amount of corrections applied so far.
+   */
+  [[nodiscard]] inline uint32_t corrections() const noexcept {
+    return corrections_;
+  }
+
+  [[nodiscard]] inline const Vector2<float>& error() const noexcept {
+    return error_;
+  }
+};
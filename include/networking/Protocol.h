@@ -0,0 +1,157 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/Buffer.h"
+#include "utils/RingBuffer.h"
+#include "utils/Vector2.h"
+
+/**
+ * \brief The framing shared by Client and Server. Every frame starts with its
+ * total size, so the receiver can reassemble them from the TCP stream no
+ * matter how the packets were split or coalesced on the way:
+ *
+ * | size {2} | event counter {4} | type {1} | payload {size - 7} |
+ */
+class Protocol final {
+ public:
+  Protocol() = delete;
+  ~Protocol() = delete;
+
+  constexpr static size_t kSizeOffset = 0;
+  constexpr static size_t kCounterOffset = kSizeOffset + sizeof(uint16_t);
+  constexpr static size_t kTypeOffset = kCounterOffset + sizeof(uint32_t);
+  constexpr static size_t kHeaderSize = kTypeOffset + sizeof(uint8_t);
+
+  /**
+   * \brief The size of the part of the header that is specific to each
+   * connection, the bytes that follow it are identical for every recipient.
+   */
+  constexpr static size_t kPrefixSize = kTypeOffset;
+
+  /**
+   * \brief The largest frame a peer may send, bigger sizes are treated as a
+   * protocol violation.
+   */
+  constexpr static size_t kMaximumFrameSize = 1024;
+
+  /**
+   * \brief The size of each connection's receive buffer, it must be able to
+   * hold at least one frame of the maximum size.
+   */
+  constexpr static size_t kReceiveBufferSize = 4096;
+
+  static_assert(kReceiveBufferSize >= kMaximumFrameSize,
+                "The receive buffer must fit the largest frame");
+
+  using receive_buffer_t = RingBuffer<kReceiveBufferSize>;
+
+  /**
+   * \brief The amount of players a server holds at once, each of them is
+   * identified by a Handle to one of this many slots.
+   */
+  constexpr static size_t kMaximumPlayers = 1024;
+
+  /**
+   * \brief The bounds of the world on both axes, a position past them is
+   * clamped when it is written.
+   */
+  constexpr static float kWorldExtent = 32768.f;
+
+  /**
+   * \brief The bits of a quantized coordinate, which puts its steps 1/16 of a
+   * unit apart within the world extent.
+   */
+  constexpr static uint32_t kCoordinateBits = 20;
+
+  /**
+   * \brief The bits of a quantized angle, whose steps are 0.02 degrees apart.
+   */
+  constexpr static uint32_t kAngleBits = 14;
+
+  constexpr static size_t kPositionSize = (kCoordinateBits * 2 + 7) / 8;
+  constexpr static size_t kAngleSize = (kAngleBits + 7) / 8;
+
+  static inline void writePosition(uint8_t* buffer,
+                                   const Vector2<float>& position,
+                                   size_t offset) noexcept {
+    BitWriter writer{buffer + offset, kPositionSize};
+    writer.writeQuantized(position.x(), -kWorldExtent, kWorldExtent,
+                          kCoordinateBits);
+    writer.writeQuantized(position.y(), -kWorldExtent, kWorldExtent,
+                          kCoordinateBits);
+    writer.flush();
+  }
+
+  [[nodiscard]] static inline Vector2<float> readPosition(
+      const uint8_t* buffer, size_t offset) noexcept {
+    BitReader reader{buffer + offset, kPositionSize};
+    const auto x =
+        reader.readQuantized(-kWorldExtent, kWorldExtent, kCoordinateBits);
+    const auto y =
+        reader.readQuantized(-kWorldExtent, kWorldExtent, kCoordinateBits);
+    return {x, y};
+  }
+
+  static inline void writeAngle(uint8_t* buffer, float angle,
+                                size_t offset) noexcept {
+    BitWriter writer{buffer + offset, kAngleSize};
+    writer.writeAngle(angle, kAngleBits);
+    writer.flush();
+  }
+
+  [[nodiscard]] static inline float readAngle(const uint8_t* buffer,
+                                              size_t offset) noexcept {
+    BitReader reader{buffer + offset, kAngleSize};
+    return reader.readAngle(kAngleBits);
+  }
+
+  static inline void writePosition(BufferWriter& writer,
+                                   const Vector2<float>& position) noexcept {
+    if (auto* at = writer.claim(kPositionSize)) writePosition(at, position, 0);
+  }
+
+  [[nodiscard]] static inline Vector2<float> readPosition(
+      BufferReader& reader) noexcept {
+    const auto* at = reader.take(kPositionSize);
+    return at ? readPosition(at, 0) : Vector2<float>{};
+  }
+
+  static inline void writeAngle(BufferWriter& writer, float angle) noexcept {
+    if (auto* at = writer.claim(kAngleSize)) writeAngle(at, angle, 0);
+  }
+
+  [[nodiscard]] static inline float readAngle(BufferReader& reader) noexcept {
+    const auto* at = reader.take(kAngleSize);
+    return at ? readAngle(at, 0) : 0.f;
+  }
+
+  /**
+   * \brief Extracts every complete frame from the buffer, leaving any trailing
+   * partial frame in place until the rest of it is received.
+   * \param buffer The connection's receive buffer.
+   * \param handler The callable invoked with (const uint8_t* frame, size_t
+   * size) for each complete frame.
+   * \return Whether or not all frames were well-formed.
+   */
+  template <typename Handler>
+  static bool drain(receive_buffer_t& buffer, Handler&& handler) noexcept {
+    const Buffer reader{};
+    uint8_t frame[kMaximumFrameSize];
+    while (buffer.size() >= sizeof(uint16_t)) {
+      buffer.peek(frame, sizeof(uint16_t));
+      const size_t size = reader.readUInt16(frame, kSizeOffset);
+      if (size < kHeaderSize || size > kMaximumFrameSize) return false;
+      if (buffer.size() < size) break;
+
+      buffer.peek(frame, size);
+      buffer.consume(size);
+      handler(static_cast<const uint8_t*>(frame), size);
+    }
+
+    return true;
+  }
+};
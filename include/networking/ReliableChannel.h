@@ -0,0 +1,275 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+
+#include "networking/Protocol.h"
+#include "utils/Buffer.h"
+
+/**
+ * \brief The state of the UDP transport with a single peer. Every datagram
+ * acknowledges the latest 33 datagrams received from the peer, and carries
+ * frames in the same format as the TCP stream:
+ *
+ * | sequence {2} | ack {2} | ack bits {4} | frame... |
+ *
+ * The counter of a frame holds either its reliable id or kUnreliable.
+ * Unreliable frames are sent once, a newer one with the same key replacing
+ * the pending one, and are discarded when they arrive after a newer datagram.
+ * Reliable frames are resent until a datagram holding them is acknowledged,
+ * and are delivered in the order they were sent. Those sent while the window
+ * is full wait behind it, in order, for the peer to acknowledge the oldest.
+ *
+ * \note Not thread-safe.
+ */
+class ReliableChannel final {
+ public:
+  /**
+   * \brief The largest datagram the channel writes, small enough to never be
+   * fragmented.
+   */
+  constexpr static size_t kMaximumDatagramSize = 1200;
+
+  constexpr static size_t kSequenceOffset = 0;
+  constexpr static size_t kAckOffset = kSequenceOffset + sizeof(uint16_t);
+  constexpr static size_t kAckBitsOffset = kAckOffset + sizeof(uint16_t);
+  constexpr static size_t kHeaderSize = kAckBitsOffset + sizeof(uint32_t);
+
+  /**
+   * \brief The counter of the frames that are not reliable.
+   */
+  constexpr static uint32_t kUnreliable = 0xFFFFFFFFu;
+
+  /**
+   * \brief The largest payload a reliable frame may carry, larger messages
+   * must be sent through TCP.
+   */
+  constexpr static size_t kMaximumPayloadSize = 64 - Protocol::kPrefixSize;
+
+  /**
+   * \brief The largest payload an unreliable frame may carry, it must fit a
+   * datagram on its own.
+   */
+  constexpr static size_t kMaximumUnreliablePayloadSize =
+      kMaximumDatagramSize - kHeaderSize - Protocol::kPrefixSize;
+
+  /**
+   * \brief The amount of reliable frames that may be awaiting acknowledgement
+   * or awaiting the delivery of an earlier one.
+   */
+  constexpr static size_t kWindowSize = 64;
+
+  /**
+   * \brief The amount of reliable frames that may wait for room in the window,
+   * a peer that leaves this many behind it no longer acknowledges anything.
+   */
+  constexpr static size_t kMaximumQueued = 1024;
+
+  /**
+   * \brief The amount of distinct keys unreliable frames may be pending for.
+   */
+  constexpr static size_t kUnreliableSize = 64;
+
+  /**
+   * \brief The time a reliable frame waits for an acknowledgement before it
+   * is sent again.
+   */
+  constexpr static std::chrono::milliseconds kResendDelay{100};
+
+ private:
+  using time_point_t = std::chrono::steady_clock::time_point;
+
+  template <size_t Size>
+  struct basic_frame_t {
+    std::array<uint8_t, Protocol::kPrefixSize + Size> data;
+    size_t size;
+  };
+
+  using frame_t = basic_frame_t<kMaximumPayloadSize>;
+  using unreliable_frame_t = basic_frame_t<kMaximumUnreliablePayloadSize>;
+
+  struct outgoing_t {
+    frame_t frame;
+    time_point_t sentAt;
+    uint16_t sequence;
+    bool sent;
+    bool pending;
+  };
+
+  struct unreliable_t {
+    unreliable_frame_t frame;
+    uint32_t key;
+  };
+
+  Buffer buffer_{};
+  std::array<outgoing_t, kWindowSize> outgoing_{};
+  // Numbered from nextOutgoing_ on, so only the window has to be full:
+  std::deque<frame_t> queued_{};
+  std::array<frame_t, kWindowSize> incoming_{};
+  std::array<bool, kWindowSize> buffered_{};
+  std::array<unreliable_t, kUnreliableSize> unreliable_{};
+  size_t unreliableCount_{0};
+  uint32_t nextOutgoing_{0};
+  uint32_t oldestOutgoing_{0};
+  uint32_t nextIncoming_{0};
+  uint16_t sequence_{0};
+  // Acknowledges a datagram 2^16 - 1 sequences away until one is received:
+  uint16_t remoteSequence_{0xFFFFu};
+  uint32_t receivedBits_{0};
+  uint64_t reliableSent_{0};
+  uint64_t resent_{0};
+  bool received_{false};
+  bool acknowledge_{false};
+
+  /**
+   * \brief Compares two sequence numbers, handling the wrap-around.
+   */
+  [[nodiscard]] static inline bool newer(uint16_t a, uint16_t b) noexcept {
+    return a != b && static_cast<uint16_t>(a - b) < 0x8000u;
+  }
+
+  template <size_t Size>
+  void writeFrame(basic_frame_t<Size>& frame, uint32_t counter,
+                  const uint8_t* payload, size_t size) noexcept {
+    frame.size = Protocol::kPrefixSize + size;
+    buffer_.writeUint16(frame.data.data(), static_cast<uint16_t>(frame.size),
+                        Protocol::kSizeOffset);
+    buffer_.writeUint32(frame.data.data(), counter, Protocol::kCounterOffset);
+    std::memcpy(frame.data.data() + Protocol::kPrefixSize, payload, size);
+  }
+
+  /**
+   * \brief Updates the acknowledgements owed to the peer with a new datagram.
+   * \return Whether or not it is the newest datagram received so far.
+   */
+  bool track(uint16_t sequence) noexcept;
+
+  /**
+   * \brief Releases the reliable frames the peer acknowledged.
+   */
+  void acknowledged(uint16_t ack, uint32_t ackBits) noexcept;
+
+ public:
+  /**
+   * \brief Queues a frame to be sent until the peer acknowledges it, after
+   * every reliable frame queued before it.
+   * \param payload The frame without its prefix.
+   * \param size The size of the payload.
+   * \return Whether or not it was queued, the payload may be too large or
+   * kMaximumQueued frames may already wait for the window.
+   */
+  bool sendReliable(const uint8_t* payload, size_t size) noexcept;
+
+  /**
+   * \brief Queues a frame for the next datagram only, replacing the one
+   * pending with the same key.
+   * \param key The identity of the value the frame carries.
+   * \param payload The frame without its prefix.
+   * \param size The size of the payload.
+   * \return Whether or not it was queued.
+   */
+  bool sendUnreliable(uint32_t key, const uint8_t* payload,
+                      size_t size) noexcept;
+
+  /**
+   * \brief Writes the next datagram, call it until it returns 0 to send every
+   * pending frame and acknowledgement.
+   * \param datagram The output, must fit kMaximumDatagramSize bytes.
+   * \return The size of the datagram, 0 if there is nothing to send.
+   */
+  size_t write(uint8_t* datagram) noexcept;
+
+  /**
+   * \brief The amount of reliable frames waiting for an acknowledgement, or
+   * for room in the window.
+   */
+  [[nodiscard]] inline size_t pendingReliable() const noexcept {
+    return nextOutgoing_ - oldestOutgoing_ + queued_.size();
+  }
+
+  /**
+   * \brief The amount of times a reliable frame was written, resends
+   * included.
+   */
+  [[nodiscard]] inline uint64_t reliableSent() const noexcept {
+    return reliableSent_;
+  }
+
+  /**
+   * \brief The amount of times a reliable frame was not acknowledged in time
+   * and was written again, which is an upper bound of the frames lost.
+   */
+  [[nodiscard]] inline uint64_t resent() const noexcept { return resent_; }
+
+  /**
+   * \brief Reads a datagram received from the peer.
+   * \param datagram The datagram.
+   * \param size The size of the datagram.
+   * \param handler The callable invoked with (const uint8_t* frame, size_t
+   * size) for each frame that can be delivered.
+   * \return Whether or not the datagram was well-formed.
+   */
+  template <typename Handler>
+  bool read(const uint8_t* datagram, size_t size, Handler&& handler) noexcept {
+    if (size < kHeaderSize) return false;
+
+    acknowledged(buffer_.readUInt16(datagram, kAckOffset),
+                 buffer_.readUInt32(datagram, kAckBitsOffset));
+    const auto newest = track(buffer_.readUInt16(datagram, kSequenceOffset));
+
+    auto offset = kHeaderSize;
+    while (offset != size) {
+      if (size - offset < Protocol::kHeaderSize) return false;
+
+      const auto* frame = datagram + offset;
+      const size_t length = buffer_.readUInt16(frame, Protocol::kSizeOffset);
+      if (length < Protocol::kHeaderSize || length > size - offset) {
+        return false;
+      }
+
+      offset += length;
+      const auto counter = buffer_.readUInt32(frame, Protocol::kCounterOffset);
+      if (counter != kUnreliable && length > sizeof(frame_t::data)) {
+        return false;
+      }
+
+      if (counter == kUnreliable) {
+        // A newer datagram already superseded the values it carries:
+        if (newest) handler(frame, length);
+        continue;
+      }
+
+      // Already delivered, or too far ahead to be buffered:
+      const auto ahead = counter - nextIncoming_;
+      if (ahead >= kWindowSize) continue;
+
+      if (ahead != 0) {
+        const auto index = counter % kWindowSize;
+        std::memcpy(incoming_[index].data.data(), frame, length);
+        incoming_[index].size = length;
+        buffered_[index] = true;
+        continue;
+      }
+
+      handler(frame, length);
+      ++nextIncoming_;
+
+      // Deliver the frames that were waiting for this one:
+      while (buffered_[nextIncoming_ % kWindowSize]) {
+        const auto index = nextIncoming_ % kWindowSize;
+        buffered_[index] = false;
+        handler(static_cast<const uint8_t*>(incoming_[index].data.data()),
+                incoming_[index].size);
+        ++nextIncoming_;
+      }
+    }
+
+    return true;
+  }
+};
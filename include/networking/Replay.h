@@ -0,0 +1,145 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * \brief The binary log of the traffic a server received, which it can replay
+ * without sockets. The log starts with a header, and follows with an entry per
+ * connection, message and disconnection, each of them stamped with the tick of
+ * the network thread it happened at, which the rooms' ticks follow to within
+ * one.
+ *
+ * Header: "ORRL", version (u8), tick rate (u32), rooms (u32).
+ * Entry: kind (u8), ticks since the previous entry (varint), client (varint),
+ * then for a connection the room (varint), and for a message its size
+ * (varint) followed by the message from its type on, as the rest of its
+ * prefix is only meaningful to the transport.
+ */
+class Replay final {
+ public:
+  constexpr static uint8_t kVersion = 1;
+  constexpr static size_t kHeaderSize =
+      4 + sizeof(uint8_t) + sizeof(uint32_t) * 2;
+
+  enum class Kind : uint8_t { kConnect, kMessage, kDisconnect };
+
+  struct entry_t {
+    Kind kind;
+    uint64_t tick;
+    uint32_t client;
+    uint32_t room;
+    const uint8_t* data;
+    size_t size;
+  };
+
+  /**
+   * \brief Writes a log. The entries are buffered and written out once per
+   * second of ticks, so recording adds no system call to each message.
+   *
+   * \note Not thread-safe, it is owned by the server's network thread.
+   */
+  class Recorder final {
+    constexpr static size_t kBufferSize = 1u << 16u;
+
+    std::FILE* file_;
+    std::vector<uint8_t> buffer_{};
+    uint64_t tick_{0};
+    uint64_t stamped_{0};
+    uint64_t written_{0};
+    uint64_t entries_{0};
+    uint32_t tickRate_;
+
+    void begin(Kind kind, uint32_t client) noexcept;
+    void write() noexcept;
+
+   public:
+    /**
+     * \brief Creates a log, replacing the file if it exists.
+     * \param path The path of the file.
+     * \param tickRate The tick rate of the server.
+     * \param rooms The amount of rooms of the server.
+     */
+    Recorder(const std::string& path, uint32_t tickRate,
+             uint32_t rooms) noexcept;
+    ~Recorder() noexcept;
+
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    [[nodiscard]] inline bool valid() const noexcept {
+      return file_ != nullptr;
+    }
+
+    /**
+     * \brief Moves on to a tick of the network thread, which stamps the
+     * entries that follow.
+     */
+    void tick(uint64_t tick) noexcept;
+
+    void connect(uint32_t client, uint32_t room) noexcept;
+
+    /**
+     * \brief Records a message, which must have passed the checks of its
+     * transport.
+     * \param client The client that sent it.
+     * \param message The message, prefix included.
+     * \param size The size of the message.
+     */
+    void message(uint32_t client, const uint8_t* message,
+                 size_t size) noexcept;
+
+    void disconnect(uint32_t client) noexcept;
+
+    [[nodiscard]] inline uint64_t entries() const noexcept {
+      return entries_;
+    }
+  };
+
+  /**
+   * \brief Reads a log, which is loaded at once so replaying it does not wait
+   * on the disk.
+   */
+  class Reader final {
+    std::vector<uint8_t> data_{};
+    size_t offset_{kHeaderSize};
+    uint64_t tick_{0};
+    uint32_t tickRate_{0};
+    uint32_t rooms_{0};
+    bool valid_{false};
+
+   public:
+    /**
+     * \brief Loads a log.
+     * \param path The path of the file.
+     */
+    explicit Reader(const std::string& path) noexcept;
+
+    /**
+     * \brief Whether or not the log was loaded and every entry read so far is
+     * well-formed.
+     */
+    [[nodiscard]] inline bool valid() const noexcept { return valid_; }
+
+    [[nodiscard]] inline uint32_t tickRate() const noexcept {
+      return tickRate_;
+    }
+
+    [[nodiscard]] inline uint32_t rooms() const noexcept { return rooms_; }
+
+    [[nodiscard]] inline size_t size() const noexcept { return data_.size(); }
+
+    /**
+     * \brief Reads the next entry.
+     * \param entry The output, whose data points into the log.
+     * \return Whether or not there was one, check valid() to tell the end of
+     * the log from a malformed entry.
+     */
+    bool next(entry_t* entry) noexcept;
+  };
+};
@@ -2,14 +2,34 @@
 
 #pragma once
 
-#include <SDL_net.h>
-
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
 #include <mutex>
-#include <queue>
-#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
-
+#include <variant>
+#include <vector>
+
+#include "networking/InterestGrid.h"
+#include "networking/LinkConditioner.h"
+#include "networking/Messages.h"
+#include "networking/NetworkStats.h"
+#include "networking/Poller.h"
+#include "networking/Protocol.h"
+#include "networking/ReliableChannel.h"
+#include "networking/Replay.h"
+#include "networking/SharedPayload.h"
+#include "networking/Simulation.h"
+#include "networking/Snapshot.h"
+#include "networking/Socket.h"
 #include "utils/Buffer.h"
+#include "utils/Registry.h"
+#include "utils/SpscQueue.h"
 #include "utils/Vector2.h"
 
 class Server : public std::enable_shared_from_this<Server> {
@@ -18,148 +38,682 @@ class Server : public std::enable_shared_from_this<Server> {
     kConnect,
     kDisconnect,
     kUpdatePosition,
-    kBulletShoot
+    kBulletShoot,
+    kPing
   };
-  enum class OutgoingMessageType : uint8_t {
-    kPlayerIdentify,
-    kPlayerConnect,
-    kPlayerDisconnect,
-    kPlayerInsertPosition,
-    kPlayerUpdatePosition,
-    kBulletShoot
-  };
-  enum class IncomingMessageType : uint8_t { kUpdatePosition, kBulletShoot };
   class ServerClient;
 
-  struct client_event_base_t {};
-
-  struct client_event_connect_t : public client_event_base_t {
+  struct client_event_connect_t {
     explicit client_event_connect_t(uint32_t ipAddress)
         : ipAddress_(ipAddress) {}
     uint32_t ipAddress_;
   };
 
-  struct client_event_disconnect_t : public client_event_base_t {};
+  struct client_event_disconnect_t {};
 
-  struct client_event_player_update_t : public client_event_base_t {
-    explicit client_event_player_update_t(Vector2<float> position)
-        : position_(std::move(position)) {}
+  struct client_event_player_update_t {
+    client_event_player_update_t(uint32_t sequence, Vector2<float> position)
+        : sequence_(sequence), position_(std::move(position)) {}
+    uint32_t sequence_;
     Vector2<float> position_;
   };
 
-  struct client_event_bullet_shoot_t : public client_event_base_t {
-    explicit client_event_bullet_shoot_t(float angle) : angle_(angle) {}
+  struct client_event_bullet_shoot_t {
+    client_event_bullet_shoot_t(float angle, uint32_t tick)
+        : angle_(angle), tick_(tick) {}
     float angle_;
+    uint32_t tick_;
   };
 
+  struct client_event_ping_t {
+    explicit client_event_ping_t(uint32_t sequence) : sequence_(sequence) {}
+    uint32_t sequence_;
+  };
+
+  /**
+   * \brief The payload of a client_event_t, held by value in the event queue.
+   */
+  using client_event_data_t =
+      std::variant<std::monostate, client_event_connect_t,
+                   client_event_disconnect_t, client_event_player_update_t,
+                   client_event_bullet_shoot_t, client_event_ping_t>;
+
   struct client_event_t {
     ClientEvent event;
     ServerClient* client;
-    client_event_base_t* data;
+    client_event_data_t data;
+  };
+
+  /**
+   * \brief The entities a client was sent at a given tick.
+   */
+  struct world_snapshot_t {
+    uint32_t tick{Snapshot::kNoBase};
+    Snapshot::entities_t entities{};
   };
 
   class ServerClient {
-    ClientStatus status_ = ClientStatus::kPending;
-    std::unique_ptr<Buffer> buffer_{};
-    std::queue<client_event_t> events_{};
-    std::mutex event_mutex_{};
-    std::weak_ptr<Server> server_;
-    TCPsocket socket_;
-    uint8_t id_{0};
+   public:
+    /**
+     * \brief The amount of events the network thread can queue before the
+     * room's worker reads them.
+     */
+    constexpr static size_t kEventQueueSize = 256;
+
+    /**
+     * \brief The amount of messages the outgoing list reserves up front, so a
+     * typical tick does not need to grow it.
+     */
+    constexpr static size_t kOutgoingMessages = 256;
+
+    /**
+     * \brief The amount of messages a client may have waiting to be sent,
+     * past it the queued position updates and snapshots are dropped to catch
+     * up.
+     */
+    constexpr static size_t kMaximumOutgoingMessages = 1024;
+
+    /**
+     * \brief The amount of consecutive ticks a client may stay over
+     * kMaximumOutgoingMessages, even after dropping its position updates,
+     * before it is disconnected.
+     */
+    constexpr static uint32_t kMaximumOverloadedTicks = 120;
+
+    /**
+     * \brief The hard limit of messages waiting to be sent, a client going
+     * past it is disconnected right away.
+     */
+    constexpr static size_t kEvictionOutgoingMessages = 8192;
+
+   private:
+    constexpr static size_t kNoPendingPosition =
+        std::numeric_limits<size_t>::max();
+    constexpr static uint32_t kSnapshotKey = Protocol::kMaximumPlayers;
+
+    struct outgoing_message_t {
+      std::array<uint8_t, Protocol::kPrefixSize> prefix;
+      SharedPayload payload;
+    };
+
+    // Closed by either thread, and read by both:
+    std::atomic<ClientStatus> status_{ClientStatus::kPending};
+    Protocol::receive_buffer_t received_{};
+    SpscQueue<client_event_t, kEventQueueSize> events_{};
+    std::vector<outgoing_message_t> outgoing_{};
+    std::array<size_t, Protocol::kMaximumPlayers> pendingPositions_{};
+    size_t written_{0};
+    uint32_t overloadedTicks_{0};
+    ReliableChannel channel_{};
+    std::mutex channel_mutex_{};
+    std::atomic<bool> datagram_{false};
+    uint32_t datagramAddress_{0};
+    uint16_t datagramPort_{0};
+    uint32_t token_{0};
+    std::atomic<uint32_t> acknowledgedSnapshot_{Snapshot::kNoBase};
+    std::array<world_snapshot_t, Snapshot::kHistorySize> views_{};
+    Socket socket_;
+    uint32_t id_;
     uint32_t event_{0};
     uint32_t remoteEvent_{0};
-    Vector2<float> position_{};
-
-    void parseMessage(uint8_t* message) noexcept;
-    bool sendIdentify() noexcept;
-
-    inline void pushEvent(const client_event_t& event) noexcept {
-      std::lock_guard<std::mutex> guard(event_mutex_);
-      events_.push(event);
+    uint32_t sequence_{0};
+    bool left_{false};
+    bool replayed_{false};
+    NetworkStats stats_{};
+    Replay::Recorder* recorder_{nullptr};
+
+    void parseMessage(const uint8_t* message, size_t size) noexcept;
+    void handleMessage(const uint8_t* message, size_t size) noexcept;
+
+    // The handlers of every message a client sends, one of them missing fails
+    // to compile in handleMessage():
+    void handle(UpdatePositionMessage, uint32_t sequence,
+                const Vector2<float>& position) noexcept;
+    void handle(BulletShootMessage, float angle, uint32_t tick) noexcept;
+    void handle(BindDatagramMessage, uint32_t id, uint32_t token) noexcept;
+    void handle(AcknowledgeSnapshotMessage, uint32_t tick) noexcept;
+    void handle(PingMessage, uint32_t sequence) noexcept;
+
+    bool sendIdentify(uint32_t tickRate) noexcept;
+    bool queueDatagram(const SharedPayload& payload) noexcept;
+    size_t write() noexcept;
+    void dropUpdates() noexcept;
+
+    inline bool pushEvent(const client_event_t& event) noexcept {
+      return events_.push(event);
     }
 
    public:
-    ServerClient(std::weak_ptr<Server> server, TCPsocket socket) noexcept;
+    /**
+     * \brief Identifies a new connection.
+     * \param id The handle the client is registered with.
+     * \param tickRate The tick rate of the server, sent to the client.
+     */
+    ServerClient(uint32_t id, Socket socket, uint32_t ipAddress,
+                 uint16_t port, uint32_t tickRate) noexcept;
+
+    /**
+     * \brief Creates a client whose messages come from a log instead of a
+     * socket, what it is sent is discarded.
+     * \param id The handle the client was registered with.
+     */
+    explicit ServerClient(uint32_t id) noexcept;
     ~ServerClient() noexcept;
 
-    void run() noexcept;
+    /**
+     * \brief Reads the pending data from the socket, called by the network
+     * thread whenever the poller reports it as readable.
+     * \return Whether or not the connection is still open.
+     */
+    bool receive() noexcept;
+
+    /**
+     * \brief Handles a message read from a log, as if it was received.
+     * \param data The message from its type on, as Replay records it.
+     * \param size The size of the message.
+     */
+    void replay(const uint8_t* data, size_t size) noexcept;
+
+    /**
+     * \brief Records every message this client sends from now on, called by
+     * the network thread before the client is admitted.
+     * \param recorder The log, nullptr to stop recording.
+     */
+    inline void record(Replay::Recorder* recorder) noexcept {
+      recorder_ = recorder;
+    }
 
     [[nodiscard]] inline bool running() const noexcept {
       return status_ == ClientStatus::kRunning;
     }
 
-    [[nodiscard]] inline const uint8_t& id() const noexcept { return id_; }
+    [[nodiscard]] inline uint32_t id() const noexcept { return id_; }
+
+    [[nodiscard]] inline const Socket& socket() const noexcept {
+      return socket_;
+    }
+
+    /**
+     * \brief The secret sent with the identify message, which the client
+     * repeats to prove it owns the UDP address it binds.
+     */
+    [[nodiscard]] inline uint32_t token() const noexcept { return token_; }
+
+    /**
+     * \brief The latest snapshot the client received, which the next one is
+     * encoded against.
+     */
+    [[nodiscard]] inline uint32_t acknowledgedSnapshot() const noexcept {
+      return acknowledgedSnapshot_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * \brief Gets the slot of the view sent at a tick, overwriting the one
+     * sent kHistorySize ticks earlier. Only accessed by the room's worker.
+     */
+    [[nodiscard]] inline world_snapshot_t& view(uint32_t tick) noexcept {
+      return views_[tick % views_.size()];
+    }
+
+    /**
+     * \brief Finds a view sent to this client that is still kept.
+     * \param tick The tick the view was sent at.
+     * \param now The current tick.
+     * \return The view, or nullptr if it is too old or kNoBase.
+     */
+    [[nodiscard]] const world_snapshot_t* findView(uint32_t tick,
+                                                   uint32_t now) const noexcept;
+
+    /**
+     * \brief Whether or not the client bound a datagram address.
+     */
+    [[nodiscard]] inline bool datagramBound() const noexcept {
+      return datagram_.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] inline uint32_t datagramAddress() const noexcept {
+      return datagramAddress_;
+    }
+
+    [[nodiscard]] inline uint16_t datagramPort() const noexcept {
+      return datagramPort_;
+    }
+
+    /**
+     * \brief Routes the client's positions and events through UDP from now
+     * on, called by the network thread once the client bound its address.
+     */
+    inline void bindDatagram(uint32_t ipAddress, uint16_t port) noexcept {
+      datagramAddress_ = ipAddress;
+      datagramPort_ = port;
+      datagram_.store(true, std::memory_order_release);
+    }
+
+    /**
+     * \brief Reads a datagram from this client, called by the network thread.
+     */
+    void receiveDatagram(const uint8_t* data, size_t size) noexcept;
+
+    /**
+     * \brief Sends the pending datagram frames and acknowledgements, called by
+     * the room's worker every tick.
+     */
+    void flushDatagrams(const Socket& socket,
+                        LinkConditioner& conditioner) noexcept;
+
+    /**
+     * \brief Reports the disconnection to the room, called by the
+     * network thread once it stopped watching the socket.
+     */
+    inline void close() noexcept {
+      status_ = ClientStatus::kClosed;
+
+      // Only the room can release this client, so the event must not
+      // be dropped, wait for it to make room instead:
+      const client_event_t event{ClientEvent::kDisconnect, this,
+                                 client_event_disconnect_t{}};
+      while (!pushEvent(event)) std::this_thread::yield();
+    }
 
-    [[nodiscard]] inline const Vector2<float>& position() const noexcept {
-      return position_;
+    /**
+     * \brief Whether or not the room handled the disconnection, the client is
+     * released at the end of the tick. Only accessed by the room's worker.
+     */
+    [[nodiscard]] inline bool left() const noexcept { return left_; }
+
+    /**
+     * \brief The sequence of the last position the client reported, which its
+     * corrections refer to. Only accessed by the room's worker.
+     */
+    [[nodiscard]] inline uint32_t sequence() const noexcept {
+      return sequence_;
     }
 
+    inline void sequence(uint32_t sequence) noexcept { sequence_ = sequence; }
+
+    inline void leave() noexcept { left_ = true; }
+
     inline void disconnect() noexcept {
-      pushEvent(
-          {ClientEvent::kDisconnect, this, new client_event_disconnect_t{}});
+      // Shutting the socket down wakes up the network thread, which stops
+      // watching it and then calls close(), so the client is only released
+      // once nothing else references it:
       status_ = ClientStatus::kClosed;
+      socket_.shutdown();
     }
 
-    inline bool send(uint8_t* data, int32_t size) noexcept {
-      // Set the event count before sending:
-      buffer_->writeUint32(data, event_, 0);
+    inline bool send(uint8_t* data, size_t size) noexcept {
+      // Set the frame size and the event count before sending:
+      BufferWriter writer{data, size, Protocol::kSizeOffset};
+      writer.writeUint16(static_cast<uint16_t>(size));
+      writer.writeUint32(event_);
 
-      if (SDLNet_TCP_Send(socket_, data, size) != size) {
+      if (socket_.send(data, size) != static_cast<int32_t>(size)) {
         // Not all bits were sent, meaning an abrupt disconnection or unknown
         // socket error.
         disconnect();
         return false;
       }
 
+      stats_.sent(data[Protocol::kTypeOffset], size);
       ++event_;
       return true;
     }
 
-    inline bool readEvent(client_event_t* event) noexcept {
-      std::lock_guard<std::mutex> guard(event_mutex_);
-      if (events_.empty()) return false;
+    /**
+     * \brief Queues a message to be written by the next flush(). A position
+     * update replaces the one queued earlier for the same player, as only the
+     * latest position matters.
+     * \param payload The message without its prefix, which is generated for
+     * this connection.
+     */
+    void queue(const SharedPayload& payload) noexcept;
+
+    /**
+     * \brief Writes as many queued messages as the socket takes without
+     * blocking, with scattered sends of each prefix followed by its payload.
+     * The rest stay queued for the next call, and a client that cannot keep
+     * up loses its position updates and snapshots first and is disconnected
+     * last.
+     * \return Whether or not the connection is still open.
+     */
+    bool flush() noexcept;
+
+    [[nodiscard]] inline size_t pendingMessages() const noexcept {
+      return outgoing_.size();
+    }
 
-      *event = events_.front();
-      events_.pop();
-      return true;
+    /**
+     * \brief Takes every pending event at once, must be called from the room's
+     * worker.
+     * \param events The destination, must fit at least size events.
+     * \param size The maximum amount of events to take.
+     * \return The amount of events taken.
+     */
+    inline size_t readEvents(client_event_t* events, size_t size) noexcept {
+      return events_.drain(events, size);
+    }
+
+    [[nodiscard]] inline size_t pendingEvents() const noexcept {
+      return events_.size();
+    }
+
+    [[nodiscard]] inline size_t eventQueueHighWaterMark() const noexcept {
+      return events_.highWaterMark();
+    }
+
+    /**
+     * \brief Copies the statistics of the connection so far. Only accessed by
+     * the room's worker, which owns the outgoing queue.
+     */
+    [[nodiscard]] NetworkStats::summary_t stats() noexcept;
+
+    /**
+     * \brief Takes what changed in the statistics since the last call. Only
+     * accessed by the room's worker.
+     */
+    [[nodiscard]] inline NetworkStats::summary_t statsInterval() noexcept {
+      return stats_.interval(stats());
     }
   };
 
   enum class ServerStatus : uint8_t { kPending, kRunning, kClosed };
 
-  std::vector<std::unique_ptr<ServerClient>> clients_{};
-  std::unique_ptr<Buffer> buffer_{};
-  std::mutex player_counter_mutex_{};
-  uint8_t playerCounter_{0};
-  ServerStatus status_;
-  TCPsocket server_;
+  /**
+   * \brief The amount of seconds between two reports of a room's tick time
+   * and snapshot bandwidth, and of a worker's overruns.
+   */
+  constexpr static uint32_t kReportSeconds = 10;
+
+  /**
+   * \brief The rate at which the clients are sent snapshots, which they
+   * interpolate between, so it does not need to match the tick rate.
+   */
+  constexpr static uint32_t kSnapshotRate = 20;
+
+  /**
+   * \brief The half of the size of the area around a player whose entities
+   * its client is sent, a screen in every direction, so they are known before
+   * they come into view.
+   */
+  constexpr static float kInterestWidth = 640.f;
+  constexpr static float kInterestHeight = 480.f;
+
+  /**
+   * \brief How far past the area of interest an entity that was sent is kept.
+   */
+  constexpr static float kInterestMargin = 64.f;
+
+  /**
+   * \brief Copies a message, skipping the space reserved for its prefix, into
+   * a payload that can be queued on any amount of clients.
+   */
+  [[nodiscard]] static inline SharedPayload share(const uint8_t* data,
+                                                  size_t size) noexcept {
+    return SharedPayload::create(data + Protocol::kPrefixSize,
+                                 size - Protocol::kPrefixSize);
+  }
+
+  /**
+   * \brief A match with its own clients, world and tick, independent from the
+   * rest, which is always ticked by the same worker. The lobby hands it the
+   * clients it seats through the inbox, and gets their handles back through
+   * the released queue once they left.
+   */
+  class Room {
+   public:
+    /**
+     * \brief The amount of clients a room seats, both queues fit all of them
+     * at once, so neither can be full.
+     */
+    constexpr static size_t kCapacity = 64;
+
+   private:
+    // Only accessed by the worker that ticks the room:
+    std::vector<std::unique_ptr<ServerClient>> clients_{};
+    std::array<client_event_t, ServerClient::kEventQueueSize> events_{};
+    const Socket& datagram_;
+    LinkConditioner conditioner_{};
+    Simulation simulation_;
+    uint32_t tick_{0};
+    uint32_t snapshotInterval_;
+    uint32_t reportInterval_;
+    Snapshot::entities_t world_{};
+    InterestGrid grid_{};
+    std::vector<uint32_t> visible_{};
+    std::vector<uint8_t> snapshotEntries_{};
+    size_t snapshotBytes_{0};
+    std::chrono::nanoseconds tickTime_{0};
+    std::chrono::nanoseconds worstTickTime_{0};
+
+    SpscQueue<std::unique_ptr<ServerClient>, kCapacity> inbox_{};
+    SpscQueue<uint32_t, kCapacity> released_{};
+
+    // Only accessed by the network thread, the clients whose handles were not
+    // reclaimed yet, so a seat is not given away before its client is gone:
+    size_t occupants_{0};
+    size_t index_;
+
+    inline void flush() noexcept {
+      for (auto& client : clients_) {
+        client->flush();
+        client->flushDatagrams(datagram_, conditioner_);
+      }
 
-  inline void broadcastExcept(uint8_t* data, int32_t size,
-                              uint8_t id) noexcept {
-    for (auto& client : clients_) {
-      if (client->id() != id) client->send(data, size);
+      conditioner_.update(datagram_);
     }
+
+    void handleEvents() noexcept;
+
+    /**
+     * \brief Adopts the clients the lobby seated since last tick.
+     */
+    void adoptClients() noexcept;
+
+    /**
+     * \brief Releases the clients that left during this tick, and hands their
+     * handles back to the network thread.
+     */
+    void releaseClients() noexcept;
+
+    /**
+     * \brief Sends their simulated position to the clients the server did not
+     * let move where they said they did.
+     */
+    void correctPositions() noexcept;
+
+    /**
+     * \brief Captures the state of the world and sends each client the
+     * changes since the last snapshot it acknowledged, every
+     * snapshotInterval_ ticks.
+     */
+    void broadcastSnapshot() noexcept;
+
+    /**
+     * \brief Picks the entities a client is sent: the ones around its player,
+     * and those it was sent last tick that did not go much further away, so
+     * an entity on the edge is not inserted and removed over and over.
+     * \param client The client.
+     * \param previous The view sent to the client last tick, nullptr if none.
+     * \param view The output, replaced with the entities sorted by key.
+     */
+    void gatherView(const ServerClient& client,
+                    const world_snapshot_t* previous,
+                    Snapshot::entities_t* view) noexcept;
+
+    /**
+     * \brief Prints the tick time and snapshot bandwidth since the last
+     * report, and starts over.
+     */
+    void report() noexcept;
+
+   public:
+    /**
+     * \brief Loads a scene into a new room.
+     * \param index The number the room is reported with.
+     * \param scene The name of the scene, as in ./assets/scenes/{scene}.json.
+     * \param datagram The server's UDP socket, which must outlive the room.
+     * \param tickRate The amount of ticks per second, must not be 0.
+     */
+    Room(size_t index, const std::string& scene, const Socket& datagram,
+         uint32_t tickRate);
+
+    /**
+     * \brief Handles the events of every client, steps the world and sends
+     * the results, called by the room's worker on every tick.
+     */
+    void tick() noexcept;
+
+    /**
+     * \brief Gives a seat to a client, called by the network thread.
+     * \param client The client, the room must not be full().
+     */
+    inline void admit(std::unique_ptr<ServerClient> client) noexcept {
+      ++occupants_;
+      inbox_.push(std::move(client));
+    }
+
+    /**
+     * \brief Takes the handle of a client the room released, freeing its
+     * seat, called by the network thread.
+     * \return Whether or not there was one.
+     */
+    inline bool reclaim(uint32_t* id) noexcept {
+      if (!released_.pop(id)) return false;
+      --occupants_;
+      return true;
+    }
+
+    [[nodiscard]] inline bool full() const noexcept {
+      return occupants_ == kCapacity;
+    }
+
+    [[nodiscard]] inline size_t index() const noexcept { return index_; }
+
+    /**
+     * \brief The room's world, only accessed by the worker that ticks it.
+     */
+    [[nodiscard]] inline const Simulation& simulation() const noexcept {
+      return simulation_;
+    }
+  };
+
+  /**
+   * \brief The amount of rooms a server hosts when none is given, which seat
+   * Protocol::kMaximumPlayers between them.
+   */
+  constexpr static size_t kDefaultRooms =
+      Protocol::kMaximumPlayers / Room::kCapacity;
+
+  /**
+   * \brief The amount of connections accepted each tick, the rest wait in the
+   * listening socket's backlog for the next one.
+   */
+  constexpr static size_t kMaximumAccepts = 64;
+
+  // Each worker ticks the rooms whose index is its own modulo the amount of
+  // workers, never any other, so a room's state stays in one core's cache:
+  std::vector<std::unique_ptr<Room>> rooms_{};
+  size_t workers_{1};
+  uint32_t tickRate_;
+  ServerStatus status_;
+  Socket server_{};
+  Socket datagram_{};
+  Poller poller_{};
+
+  // Only accessed by the network thread, which hands out the handles and
+  // finds whom a datagram belongs to. A closed connection keeps its handle,
+  // pointing to nobody, until its room released it:
+  Registry<ServerClient*, Protocol::kMaximumPlayers> connections_{};
+  std::unordered_map<uint64_t, ServerClient*> addresses_{};
+
+  // Only accessed by the network thread, the log of the traffic received when
+  // OBSTACLE_RUN_RECORD names a file to write it to:
+  std::unique_ptr<Replay::Recorder> recorder_{};
+
+  [[nodiscard]] static inline uint64_t addressKey(uint32_t ipAddress,
+                                                  uint16_t port) noexcept {
+    return static_cast<uint64_t>(ipAddress) << 16u | port;
   }
 
-  inline void broadcast(uint8_t* data, int32_t size) noexcept {
-    for (auto& client : clients_) {
-      client->send(data, size);
+  /**
+   * \brief Frees the handles of the clients the rooms released, so they can
+   * be handed out again.
+   */
+  inline void reclaimHandles() noexcept {
+    uint32_t id;
+    for (auto& room : rooms_) {
+      while (room->reclaim(&id)) connections_.remove(id);
     }
   }
 
-  void handleEvents() noexcept;
+  /**
+   * \brief The lobby, which picks the room a new client joins: the first one
+   * with a free seat, so the matches fill up one at a time instead of all of
+   * them staying half empty. Consecutive rooms are ticked by different
+   * workers, so the load still spreads across them as the rooms fill.
+   * \return The room, or nullptr if every seat is taken.
+   */
+  [[nodiscard]] Room* assignRoom() noexcept;
+
+  /**
+   * \brief Ticks a worker's rooms on schedule until the server closes.
+   * \param worker The index of the worker.
+   */
+  void work(size_t worker) noexcept;
+
+  /**
+   * \brief Accepts the connections waiting in the backlog, called by the
+   * network thread on every tick, so a burst of them is spread over several
+   * ticks instead of keeping it busy.
+   */
+  void accept() noexcept;
+
+  void receiveDatagrams() noexcept;
+  ServerClient* bindDatagram(const uint8_t* datagram, size_t size,
+                             uint32_t ipAddress, uint16_t port) noexcept;
+  void listen() noexcept;
 
  public:
-  Server() noexcept;
+  /**
+   * \brief Creates a server hosting many rooms of a scene, which it simulates
+   * headless, with a worker per core ticking them.
+   * \param scene The name of the scene, as in ./assets/scenes/{scene}.json.
+   * \param rooms The amount of rooms.
+   * \param tickRate The amount of ticks per second, 0 for the default.
+   */
+  explicit Server(const std::string& scene, size_t rooms = kDefaultRooms,
+                  uint32_t tickRate = Simulation::kDefaultTickRate) noexcept;
   ~Server() noexcept;
+
+  /**
+   * \brief Starts the workers, and listens to every socket from the calling
+   * thread until the server closes.
+   */
   void run() noexcept;
 
   [[nodiscard]] inline bool running() const noexcept {
     return status_ == ServerStatus::kRunning;
   }
 
-  [[nodiscard]] inline uint8_t nextPlayerID() noexcept {
-    std::lock_guard<std::mutex> guard(player_counter_mutex_);
-    return playerCounter_++;
-  }
+  /**
+   * \brief Measures how the throughput of the rooms scales with the amount of
+   * workers, from one up to a worker per core. Each worker ticks its own full
+   * room as fast as it can, and drives its players through loopback
+   * connections, so it does all the work of a room but accepting the clients.
+   * \param scene The name of the scene, as in ./assets/scenes/{scene}.json.
+   * \param seconds The time each amount of workers is measured for.
+   */
+  static void benchmark(const std::string& scene, uint32_t seconds) noexcept;
+
+  /**
+   * \brief Replays a log recorded by a server through rooms of a scene, with
+   * no sockets and as fast as possible. The rooms are ticked as the log's
+   * ticks go by, so the same log always plays out the same, which makes a
+   * desync or a crash reproducible and bisectable.
+   * \param scene The name of the scene, as in ./assets/scenes/{scene}.json,
+   * which must be the one the log was recorded with.
+   * \param path The path of the log.
+   */
+  static void replay(const std::string& scene,
+                     const std::string& path) noexcept;
 };
@@ -0,0 +1,63 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "networking/Protocol.h"
+
+/**
+ * \brief An immutable message body that every recipient of a broadcast
+ * references, so it is serialized once no matter how many clients receive it.
+ * Copies share the same bytes, which go back to a free list for the next
+ * create() once the last copy is destroyed.
+ *
+ * \note Not thread-safe, the copies of a payload must be made and destroyed
+ * on the same thread. Each thread recycles blocks through its own free list,
+ * so every room's worker can create them at once.
+ */
+class SharedPayload final {
+  struct block_t {
+    std::array<uint8_t, Protocol::kMaximumFrameSize> data;
+    size_t size;
+    uint32_t references;
+  };
+
+  static thread_local std::vector<std::unique_ptr<block_t>> free_;
+  block_t* block_{nullptr};
+
+  explicit SharedPayload(block_t* block) noexcept;
+  void release() noexcept;
+
+ public:
+  SharedPayload() noexcept = default;
+  SharedPayload(const SharedPayload& other) noexcept;
+  SharedPayload(SharedPayload&& other) noexcept;
+  ~SharedPayload() noexcept;
+
+  SharedPayload& operator=(const SharedPayload& other) noexcept;
+  SharedPayload& operator=(SharedPayload&& other) noexcept;
+
+  /**
+   * \brief Copies the bytes into a recycled block, allocating only when the
+   * free list is empty.
+   * \param data The bytes to share.
+   * \param size The amount of bytes, must not exceed the maximum frame size.
+   */
+  [[nodiscard]] static SharedPayload create(const uint8_t* data,
+                                            size_t size) noexcept;
+
+  [[nodiscard]] inline bool valid() const noexcept {
+    return block_ != nullptr;
+  }
+
+  [[nodiscard]] inline const uint8_t* data() const noexcept {
+    return block_->data.data();
+  }
+
+  [[nodiscard]] inline size_t size() const noexcept { return block_->size; }
+};
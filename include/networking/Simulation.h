@@ -0,0 +1,226 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <box2d/box2d.h>
+#include <json/json.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "networking/HitboxHistory.h"
+#include "networking/Protocol.h"
+#include "networking/Snapshot.h"
+#include "utils/Registry.h"
+#include "utils/Vector2.h"
+
+/**
+ * \brief The server's copy of a scene. It loads the same JSON the clients do,
+ * but only builds the physics bodies, so it runs without SDL video, and steps
+ * its own world at a fixed rate. Players move towards the positions their
+ * clients report, at no more than their speed and never through a wall, and
+ * bullets fly and turn into destructible walls as BulletBox does, which makes
+ * the positions it produces the authoritative ones.
+ *
+ * \note Not thread-safe, it is owned by a room of the server.
+ */
+class Simulation final {
+ public:
+  /**
+   * \brief The amount of steps per second a simulation takes when no other
+   * rate is given.
+   */
+  constexpr static uint32_t kDefaultTickRate = 60;
+
+  /**
+   * \brief How much faster than its speed a player may move, so a client whose
+   * updates arrive bunched up by the network can still be caught up with.
+   */
+  constexpr static float kSpeedTolerance = 2.f;
+
+  /**
+   * \brief The distance between the position a client reports and the one its
+   * player is simulated at, past which the client must be corrected.
+   */
+  constexpr static float kCorrectionDistance = 8.f;
+
+  /**
+   * \brief The longest time a shot is rewound for, in seconds, so a client
+   * with a poor connection cannot hit players that have long moved away.
+   */
+  constexpr static float kMaximumRewind = 0.5f;
+
+  /**
+   * \brief The time a player waits between two shots, in seconds, as
+   * PlayerController does. Longer than kMaximumRewind, so a client that lies
+   * about the tick it saw cannot fire two shots in a row.
+   */
+  constexpr static float kShootInterval = 1.f;
+
+  /**
+   * \brief How much sooner than kShootInterval a shot may come, in seconds,
+   * as the clock a client sees the world with drifts to catch up with the
+   * snapshots.
+   */
+  constexpr static float kShootTolerance = 0.1f;
+
+  /**
+   * \brief The amount of walls the bullets may leave behind, past which the
+   * oldest one crumbles for each new one, so a long match neither grows the
+   * world nor its snapshots without end.
+   */
+  constexpr static size_t kMaximumWalls = 128;
+
+ private:
+  constexpr static int32_t kVelocityIterations = 8;
+  constexpr static int32_t kPositionIterations = 3;
+
+  struct body_template_t {
+    Vector2<float> position;
+    Vector2<float> scale;
+    b2BodyType type;
+    bool sensor;
+    float density;
+    float restitution;
+    float linearDamping;
+    uint16_t category;
+    uint16_t mask;
+  };
+
+  struct player_t {
+    b2Body* body;
+    Vector2<float> target;
+    uint32_t id;
+    // The first tick the player may shoot at, and the bullets it has left:
+    uint32_t nextShot;
+    uint32_t clip;
+    bool active;
+  };
+
+  struct bullet_t {
+    b2Body* body;
+    float remaining;
+    uint32_t id;
+  };
+
+  struct wall_t {
+    b2Body* body;
+    uint32_t id;
+  };
+
+  b2World world_{{0.f, 0.f}};
+  float timeStep_;
+  body_template_t player_{};
+  float speed_{0.f};
+  uint32_t clip_{0};
+  std::array<player_t, Protocol::kMaximumPlayers> players_{};
+  std::vector<bullet_t> bullets_{};
+  std::vector<wall_t> walls_{};
+  uint32_t nextEntity_{0};
+  uint32_t tick_{0};
+  uint32_t maximumRewind_;
+  uint32_t shootInterval_;
+  HitboxHistory history_{};
+
+  void loadGameObject(const Json::Value& json);
+  b2Body* createBody(const body_template_t& data) noexcept;
+  void createWall(const Vector2<float>& position) noexcept;
+  void collect() noexcept;
+
+  [[nodiscard]] inline player_t& player(uint32_t id) noexcept {
+    return players_[Handle::slot(id)];
+  }
+
+  [[nodiscard]] inline const player_t& player(uint32_t id) const noexcept {
+    return players_[Handle::slot(id)];
+  }
+
+ public:
+  /**
+   * \param tickRate The amount of steps per second, must not be 0.
+   */
+  explicit Simulation(uint32_t tickRate = kDefaultTickRate) noexcept;
+
+  /**
+   * \brief Loads the bodies of a scene, the GameObject with a PlayerController
+   * being the template every player is spawned from.
+   * \param name The name of the scene, as in ./assets/scenes/{name}.json.
+   */
+  void load(const std::string& name);
+
+  /**
+   * \brief Spawns the body of a player, at the position of the template.
+   * \param id The handle of the player, which must be below
+   * Protocol::kMaximumPlayers.
+   */
+  void addPlayer(uint32_t id) noexcept;
+
+  void removePlayer(uint32_t id) noexcept;
+
+  /**
+   * \brief Sets the position a client reported for its player, which the
+   * player moves towards from the next step on.
+   */
+  void movePlayer(uint32_t id, const Vector2<float>& position) noexcept;
+
+  /**
+   * \brief Spawns a bullet shot by a player. The shot is rewound to the tick
+   * the client saw the other players at: the flight the bullet would have
+   * had since is checked against where they were back then, and a bullet
+   * that hit one of them is spawned where it strikes that player now, so the
+   * hit the shooter saw is the one every client sees. A bullet that hit
+   * nobody is spawned as far along as it would have flown meanwhile. As in
+   * PlayerController, a player waits kShootInterval between two shots and
+   * spends a bullet of its clip on each, which it refills by picking up
+   * collectibles, and any other shot is dropped before it is rewound.
+   * Cooldowns are timed by the ticks the client saw, so the jitter of its
+   * connection does not drop the shots it fired in time.
+   * \param id The player that shot it.
+   * \param angle The angle the client aimed at, from the target to the player.
+   * \param tick The tick the client saw the world at, Snapshot::kNoBase to
+   * shoot in the present.
+   */
+  void shoot(uint32_t id, float angle, uint32_t tick) noexcept;
+
+  /**
+   * \brief Advances the world by a tick, records where the players ended up
+   * at it, and hands them the collectibles they touched.
+   */
+  void step() noexcept;
+
+  /**
+   * \brief The amount of steps taken, which is also the tick of the next one.
+   */
+  [[nodiscard]] inline uint32_t tick() const noexcept { return tick_; }
+
+  /**
+   * \brief Takes the state of every player, bullet and wall.
+   * \param entities The output, replaced with the entities sorted by key.
+   */
+  void capture(Snapshot::entities_t* entities) const noexcept;
+
+  /**
+   * \brief Whether or not the player of a handle was added, and not removed
+   * nor replaced by another with the same slot since.
+   */
+  [[nodiscard]] inline bool active(uint32_t id) const noexcept {
+    const auto& data = player(id);
+    return data.active && data.id == id;
+  }
+
+  [[nodiscard]] inline Vector2<float> position(uint32_t id) const noexcept {
+    return Vector2<float>(player(id).body->GetPosition());
+  }
+
+  /**
+   * \brief Whether or not the player is too far away from the position its
+   * client reported, as the client believes it could move where the server
+   * did not let it.
+   */
+  [[nodiscard]] inline bool diverged(uint32_t id) const noexcept {
+    return (player(id).target - position(id)).magnitude() >
+           kCorrectionDistance;
+  }
+};
@@ -0,0 +1,149 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "networking/Protocol.h"
+#include "utils/Vector2.h"
+
+/**
+ * \brief The state of every entity the server simulates at a given tick, and
+ * its delta encoding. A snapshot only holds the entities that changed since
+ * the base the client acknowledged, and is split in parts when it does not
+ * fit a frame:
+ *
+ * | tick {4} | base {4} | part {1} | parts {1} | entry... |
+ *
+ * Entries are sorted by key, an updated entity is written as
+ * | type {1} | id {4} | position {5} | and a removed one as
+ * | type + kRemoved {1} | id {4} |, where the position is quantized by
+ * Protocol::writePosition(). The ID of a player is its handle.
+ */
+class Snapshot final {
+ public:
+  Snapshot() = delete;
+  ~Snapshot() = delete;
+
+  enum class EntityType : uint8_t { kPlayer, kBullet, kWall };
+
+  struct entity_t {
+    uint64_t key;
+    Vector2<float> position;
+  };
+
+  /**
+   * \brief The entities of a snapshot, sorted by key.
+   */
+  using entities_t = std::vector<entity_t>;
+
+  constexpr static size_t kTickOffset = 0;
+  constexpr static size_t kBaseOffset = kTickOffset + sizeof(uint32_t);
+  constexpr static size_t kPartOffset = kBaseOffset + sizeof(uint32_t);
+  constexpr static size_t kPartsOffset = kPartOffset + sizeof(uint8_t);
+  constexpr static size_t kHeaderSize = kPartsOffset + sizeof(uint8_t);
+
+  constexpr static size_t kRemovedEntrySize =
+      sizeof(uint8_t) + sizeof(uint32_t);
+  constexpr static size_t kEntrySize =
+      kRemovedEntrySize + Protocol::kPositionSize;
+  constexpr static uint8_t kRemoved = 0x80u;
+
+  /**
+   * \brief The base of a snapshot that holds every entity.
+   */
+  constexpr static uint32_t kNoBase = 0xFFFFFFFFu;
+
+  /**
+   * \brief The amount of ticks a snapshot is kept for, a client that did not
+   * acknowledge any of them receives every entity again.
+   */
+  constexpr static size_t kHistorySize = 64;
+
+  /**
+   * \brief The largest amount of entries a part may carry.
+   */
+  constexpr static size_t kMaximumPartSize =
+      Protocol::kMaximumFrameSize - Protocol::kHeaderSize - kHeaderSize;
+
+  constexpr static size_t kMaximumParts = 32;
+
+  [[nodiscard]] constexpr static inline uint64_t key(EntityType type,
+                                                     uint32_t id) noexcept {
+    return static_cast<uint64_t>(type) << 32u | id;
+  }
+
+  [[nodiscard]] constexpr static inline EntityType type(uint64_t key) noexcept {
+    return static_cast<EntityType>(key >> 32u);
+  }
+
+  [[nodiscard]] constexpr static inline uint32_t id(uint64_t key) noexcept {
+    return static_cast<uint32_t>(key & 0xFFFFFFFFu);
+  }
+
+  /**
+   * \brief Gets the size of the entry a buffer starts with.
+   */
+  [[nodiscard]] static inline size_t entrySize(const uint8_t* entry) noexcept {
+    return (entry[0] & kRemoved) != 0 ? kRemovedEntrySize : kEntrySize;
+  }
+
+  /**
+   * \brief Writes the entries that turn a snapshot into another.
+   * \param base The snapshot the receiver has, nullptr if it has none.
+   * \param current The snapshot to encode.
+   * \param entries The output, the entries are appended to it.
+   */
+  static void encode(const entities_t* base, const entities_t& current,
+                     std::vector<uint8_t>* entries) noexcept;
+
+  /**
+   * \brief Applies the entries written by encode().
+   * \param base The snapshot the entries were encoded against, nullptr if
+   * none.
+   * \param entries The entries of every part, in order.
+   * \param size The size of the entries.
+   * \param current The output, replaced with the decoded snapshot.
+   * \return Whether or not the entries were well-formed.
+   */
+  static bool decode(const entities_t* base, const uint8_t* entries,
+                     size_t size, entities_t* current) noexcept;
+
+  /**
+   * \brief Walks the changes between two snapshots.
+   * \param from The older snapshot.
+   * \param to The newer snapshot.
+   * \param updated The callable invoked with (const entity_t&) for each entity
+   * that was added or moved.
+   * \param removed The callable invoked with (uint64_t key) for each entity
+   * that was removed.
+   */
+  template <typename Updated, typename Removed>
+  static void diff(const entities_t& from, const entities_t& to,
+                   Updated&& updated, Removed&& removed) noexcept {
+    auto a = from.begin();
+    auto b = to.begin();
+    while (a != from.end() || b != to.end()) {
+      if (b == to.end() || (a != from.end() && a->key < b->key)) {
+        removed(a->key);
+        ++a;
+      } else if (a == from.end() || b->key < a->key) {
+        updated(*b);
+        ++b;
+      } else {
+        if (!equals(*a, *b)) updated(*b);
+        ++a;
+        ++b;
+      }
+    }
+  }
+
+ private:
+  [[nodiscard]] static inline bool equals(const entity_t& a,
+                                          const entity_t& b) noexcept {
+    return a.position.x() == b.position.x() &&
+           a.position.y() == b.position.y();
+  }
+};
@@ -0,0 +1,182 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if _WIN32
+#include <winsock2.h>
+using socket_handle_t = SOCKET;
+using socket_buffer_t = WSABUF;
+#else
+#include <sys/uio.h>
+using socket_handle_t = int;
+using socket_buffer_t = iovec;
+#endif
+
+/**
+ * \brief A thin, move-only wrapper around a native non-blocking TCP or UDP
+ * socket.
+ *
+ * SDL_net only exposes blocking sockets, which forces a thread per
+ * connection, so the server talks to the operating system directly and
+ * multiplexes every socket through a Poller.
+ */
+class Socket final {
+  socket_handle_t handle_;
+
+ public:
+  /**
+   * \brief Returned by receive() and send() when the operation would block.
+   */
+  constexpr static int32_t kWouldBlock = -1;
+
+  /**
+   * \brief Returned by receive() and send() when the socket errored.
+   */
+  constexpr static int32_t kError = -2;
+
+  /**
+   * \brief The largest amount of buffers a single scattered send() takes,
+   * well below the IOV_MAX of every supported platform.
+   */
+  constexpr static size_t kMaximumBuffers = 256;
+
+  Socket() noexcept;
+  explicit Socket(socket_handle_t handle) noexcept;
+  Socket(const Socket&) = delete;
+  Socket(Socket&& other) noexcept;
+  ~Socket() noexcept;
+
+  Socket& operator=(const Socket&) = delete;
+  Socket& operator=(Socket&& other) noexcept;
+
+  /**
+   * \brief Opens a non-blocking socket listening on all interfaces.
+   * \param port The port to bind to.
+   * \return The listening socket, invalid if any step failed.
+   */
+  [[nodiscard]] static Socket listen(uint16_t port) noexcept;
+
+  /**
+   * \brief Opens a non-blocking UDP socket bound to all interfaces.
+   * \param port The port to bind to, 0 lets the system pick any free one.
+   * \return The bound socket, invalid if any step failed.
+   */
+  [[nodiscard]] static Socket datagram(uint16_t port) noexcept;
+
+  /**
+   * \brief Opens a TCP connection, blocking until it is established, and then
+   * sets it as non-blocking.
+   * \param ipAddress The IPv4 address to connect to, in host byte order.
+   * \param port The port to connect to, in host byte order.
+   * \param receiveBuffer The size of the kernel's receive buffer, the
+   * system's default when 0.
+   * \param segmentSize The largest segment the peer may send, the one of the
+   * route when 0.
+   * \return The connected socket, invalid if any step failed.
+   */
+  [[nodiscard]] static Socket connect(uint32_t ipAddress, uint16_t port,
+                                      size_t receiveBuffer = 0,
+                                      uint16_t segmentSize = 0) noexcept;
+
+  /**
+   * \brief Accepts a pending connection, setting it as non-blocking.
+   * \param ipAddress The peer's IPv4 address, in host byte order.
+   * \param port The peer's port, in host byte order.
+   * \return The accepted socket, invalid if there was none pending.
+   */
+  [[nodiscard]] Socket accept(uint32_t* ipAddress,
+                              uint16_t* port) const noexcept;
+
+  /**
+   * \brief Reads up to size bytes from the socket.
+   * \return The amount of bytes read, 0 if the peer closed the connection,
+   * kWouldBlock if there is nothing to read, or kError.
+   */
+  [[nodiscard]] int32_t receive(uint8_t* data, size_t size) const noexcept;
+
+  /**
+   * \brief Writes up to size bytes to the socket.
+   * \return The amount of bytes written, kWouldBlock if the kernel buffer is
+   * full, or kError.
+   */
+  [[nodiscard]] int32_t send(const uint8_t* data, size_t size) const noexcept;
+
+  /**
+   * \brief Writes several buffers in order with a single system call, without
+   * copying them into one contiguous block first.
+   * \param buffers The buffers, made with buffer().
+   * \param count The amount of buffers, must not exceed kMaximumBuffers.
+   * \return The total amount of bytes written, kWouldBlock if the kernel
+   * buffer is full, or kError.
+   */
+  [[nodiscard]] int32_t send(const socket_buffer_t* buffers,
+                             size_t count) const noexcept;
+
+  /**
+   * \brief Reads the next datagram from a UDP socket.
+   * \param ipAddress The sender's IPv4 address, in host byte order.
+   * \param port The sender's port, in host byte order.
+   * \return The size of the datagram, kWouldBlock if there is none, or
+   * kError.
+   */
+  [[nodiscard]] int32_t receiveFrom(uint8_t* data, size_t size,
+                                    uint32_t* ipAddress,
+                                    uint16_t* port) const noexcept;
+
+  /**
+   * \brief Sends a datagram from a UDP socket.
+   * \param ipAddress The receiver's IPv4 address, in host byte order.
+   * \param port The receiver's port, in host byte order.
+   * \return The size of the datagram, kWouldBlock if the kernel buffer is
+   * full, or kError.
+   */
+  [[nodiscard]] int32_t sendTo(const uint8_t* data, size_t size,
+                               uint32_t ipAddress,
+                               uint16_t port) const noexcept;
+
+  /**
+   * \brief The port the socket is bound to, which tells which one the system
+   * picked when it was opened with port 0.
+   * \return The port in host byte order, 0 if it is not bound.
+   */
+  [[nodiscard]] uint16_t localPort() const noexcept;
+
+  /**
+   * \brief Shuts down both directions, waking up any Poller watching it.
+   */
+  void shutdown() const noexcept;
+
+  void close() noexcept;
+
+  /**
+   * \brief The platform's error code for the last failed socket operation.
+   */
+  [[nodiscard]] static int32_t lastError() noexcept;
+
+  [[nodiscard]] inline bool valid() const noexcept {
+#if _WIN32
+    return handle_ != INVALID_SOCKET;
+#else
+    return handle_ >= 0;
+#endif
+  }
+
+  [[nodiscard]] inline socket_handle_t handle() const noexcept {
+    return handle_;
+  }
+
+  [[nodiscard]] static inline socket_buffer_t buffer(const uint8_t* data,
+                                                     size_t size) noexcept {
+    // Neither writev nor WSASend write to the buffers, they just are not
+    // declared const:
+    auto* pointer = const_cast<uint8_t*>(data);
+#if _WIN32
+    return {static_cast<ULONG>(size), reinterpret_cast<CHAR*>(pointer)};
+#else
+    return {pointer, size};
+#endif
+  }
+};
@@ -0,0 +1,69 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "utils/Vector2.h"
+
+/**
+ * \brief Decides which of the positions the local player reports every frame
+ * are worth sending. The server holds a player at the last position it was
+ * sent, so a position is only sent when it drifted further than an epsilon
+ * from it, or when the player started, stopped or turned, and never more often
+ * than the upload rate. A position is still sent every keepalive interval, as
+ * it travels unreliably and the last one may have been lost.
+ *
+ * The rate in hertz, the epsilon in world units and the keepalive interval in
+ * milliseconds are read from the OBSTACLE_RUN_UPLOAD_RATE,
+ * OBSTACLE_RUN_UPLOAD_EPSILON and OBSTACLE_RUN_UPLOAD_KEEPALIVE environment
+ * variables.
+ *
+ * \note Not thread-safe, it is owned by the game thread.
+ */
+class UploadPolicy final {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  constexpr static uint32_t kDefaultRate = 30;
+  constexpr static float kDefaultEpsilon = 0.5f;
+  constexpr static uint32_t kDefaultKeepalive = 1000;
+
+ private:
+  clock::duration interval_;
+  clock::duration keepalive_;
+  float epsilon_;
+
+  clock::time_point last_{};
+  Vector2<float> position_{};
+  Vector2<float> velocity_{};
+  bool changed_{false};
+  uint64_t sent_{0};
+  uint64_t skipped_{0};
+
+ public:
+  UploadPolicy() noexcept;
+
+  /**
+   * \brief Decides whether or not to send a position, which is assumed sent
+   * when it is.
+   * \param now The time of the frame.
+   * \param position The position the player is at.
+   * \param velocity The velocity the input gave the player.
+   */
+  [[nodiscard]] bool allow(clock::time_point now,
+                           const Vector2<float>& position,
+                           const Vector2<float>& velocity) noexcept;
+
+  /**
+   * \brief The amount of positions sent.
+   */
+  [[nodiscard]] inline uint64_t sent() const noexcept { return sent_; }
+
+  /**
+   * \brief The amount of positions that were not worth sending, each of them a
+   * packet saved.
+   */
+  [[nodiscard]] inline uint64_t skipped() const noexcept { return skipped_; }
+};
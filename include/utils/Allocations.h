@@ -0,0 +1,39 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+
+// Debug builds count by default, any other build does when it is configured
+// with OBSTACLE_RUN_COUNT_ALLOCATIONS, as a profiling build would:
+#ifndef OBSTACLE_RUN_COUNT_ALLOCATIONS
+#ifdef NDEBUG
+#define OBSTACLE_RUN_COUNT_ALLOCATIONS 0
+#else
+#define OBSTACLE_RUN_COUNT_ALLOCATIONS 1
+#endif
+#endif
+
+/**
+ * \brief Counts the heap allocations made through operator new by the calling
+ * thread, so the network threads can check that handling a message does not
+ * allocate. Only the builds that count them replace operator new, the others
+ * always report 0.
+ */
+class Allocations final {
+ public:
+  Allocations() = delete;
+  ~Allocations() = delete;
+
+  /**
+   * \brief Whether or not this build counts the allocations.
+   */
+  [[nodiscard]] constexpr static bool counted() noexcept {
+    return OBSTACLE_RUN_COUNT_ALLOCATIONS != 0;
+  }
+
+  /**
+   * \brief The amount of allocations the calling thread made so far.
+   */
+  [[nodiscard]] static size_t count() noexcept;
+};
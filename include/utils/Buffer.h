@@ -2,10 +2,14 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <string>
+#include <tuple>
 #include <type_traits>
+#include <vector>
 
 #include "Endian.h"
 
@@ -274,3 +278,436 @@ class Buffer {
     return std::string(value, size);
   }
 };
+
+/**
+ * \brief Packs values of any width up to 32 bits back to back, most significant
+ * bit first, so each of them takes no more bits than it needs and reads the
+ * same on every host.
+ */
+class BitWriter final {
+  uint8_t* buffer_;
+  size_t size_;
+  size_t offset_{0};
+  uint64_t scratch_{0};
+  uint32_t bits_{0};
+  bool overflowed_{false};
+
+  inline void put(uint8_t byte) noexcept {
+    if (offset_ == size_) {
+      overflowed_ = true;
+      return;
+    }
+
+    buffer_[offset_++] = byte;
+  }
+
+ public:
+  /**
+   * \param buffer The output.
+   * \param size The amount of bytes the output holds.
+   */
+  BitWriter(uint8_t* buffer, size_t size) noexcept
+      : buffer_(buffer), size_(size) {}
+
+  [[nodiscard]] constexpr static inline uint32_t mask(uint32_t bits) noexcept {
+    return bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1u;
+  }
+
+  /**
+   * \brief Maps a value to one of the 2^bits evenly spaced steps between two
+   * bounds, clamping it to them.
+   */
+  [[nodiscard]] static inline uint32_t quantize(float value, float minimum,
+                                                float maximum,
+                                                uint32_t bits) noexcept {
+    const auto clamped = std::min(std::max(value, minimum), maximum);
+    const auto steps = static_cast<double>(mask(bits));
+    // The value is never negative, so truncating half a step up rounds it:
+    return static_cast<uint32_t>(
+        (static_cast<double>(clamped) - minimum) /
+            (static_cast<double>(maximum) - minimum) * steps +
+        0.5);
+  }
+
+  /**
+   * \brief Maps an angle in radians to one of 2^bits steps around the circle,
+   * wrapping it first, so any turn is representable.
+   */
+  [[nodiscard]] static inline uint32_t quantizeAngle(float angle,
+                                                     uint32_t bits) noexcept {
+    constexpr double turn = 6.283185307179586;
+    auto fraction = static_cast<double>(angle) / turn;
+    fraction -= std::floor(fraction);
+    const auto steps = static_cast<double>(mask(bits)) + 1.0;
+    return static_cast<uint32_t>(fraction * steps + 0.5) & mask(bits);
+  }
+
+  /**
+   * \brief Writes the lowest bits of a value.
+   * \param value The value, the bits past the width are ignored.
+   * \param bits The width, from 1 to 32.
+   */
+  inline void write(uint32_t value, uint32_t bits) noexcept {
+    scratch_ = scratch_ << bits | (value & mask(bits));
+    bits_ += bits;
+    while (bits_ >= 8) {
+      bits_ -= 8;
+      put(static_cast<uint8_t>(scratch_ >> bits_));
+    }
+  }
+
+  inline void writeQuantized(float value, float minimum, float maximum,
+                             uint32_t bits) noexcept {
+    write(quantize(value, minimum, maximum, bits), bits);
+  }
+
+  inline void writeAngle(float angle, uint32_t bits) noexcept {
+    write(quantizeAngle(angle, bits), bits);
+  }
+
+  /**
+   * \brief Writes the bits that do not fill a byte yet, padded with zeroes,
+   * must be called once every value was written.
+   */
+  inline void flush() noexcept {
+    if (bits_ == 0) return;
+
+    put(static_cast<uint8_t>(scratch_ << (8 - bits_)));
+    bits_ = 0;
+  }
+
+  /**
+   * \brief The amount of bytes written so far, including a flushed one.
+   */
+  [[nodiscard]] inline size_t size() const noexcept { return offset_; }
+
+  /**
+   * \brief Whether or not a value did not fit the output, in which case the
+   * bytes past its end were dropped.
+   */
+  [[nodiscard]] inline bool overflowed() const noexcept { return overflowed_; }
+};
+
+/**
+ * \brief Reads the values written by a BitWriter, with the same widths and in
+ * the same order.
+ */
+class BitReader final {
+  const uint8_t* buffer_;
+  size_t size_;
+  size_t offset_{0};
+  uint64_t scratch_{0};
+  uint32_t bits_{0};
+  bool overflowed_{false};
+
+ public:
+  /**
+   * \param buffer The input.
+   * \param size The amount of bytes the input holds.
+   */
+  BitReader(const uint8_t* buffer, size_t size) noexcept
+      : buffer_(buffer), size_(size) {}
+
+  /**
+   * \brief Maps a step written by BitWriter::quantize() back to its value.
+   */
+  [[nodiscard]] static inline float dequantize(uint32_t value, float minimum,
+                                               float maximum,
+                                               uint32_t bits) noexcept {
+    const auto steps = static_cast<double>(BitWriter::mask(bits));
+    return static_cast<float>(
+        minimum + (static_cast<double>(maximum) - minimum) * value / steps);
+  }
+
+  /**
+   * \brief Maps a step written by BitWriter::quantizeAngle() back to an angle,
+   * between -pi and pi.
+   */
+  [[nodiscard]] static inline float dequantizeAngle(uint32_t value,
+                                                    uint32_t bits) noexcept {
+    constexpr double turn = 6.283185307179586;
+    const auto steps = static_cast<double>(BitWriter::mask(bits)) + 1.0;
+    auto angle = static_cast<double>(value) / steps * turn;
+    if (angle > turn / 2.0) angle -= turn;
+    return static_cast<float>(angle);
+  }
+
+  /**
+   * \brief Reads a value of a given width.
+   * \param bits The width, from 1 to 32.
+   * \return The value, or 0 if the input ended before it.
+   */
+  inline uint32_t read(uint32_t bits) noexcept {
+    while (bits_ < bits) {
+      if (offset_ == size_) {
+        overflowed_ = true;
+        return 0;
+      }
+
+      scratch_ = scratch_ << 8u | buffer_[offset_++];
+      bits_ += 8;
+    }
+
+    bits_ -= bits;
+    return static_cast<uint32_t>(scratch_ >> bits_) & BitWriter::mask(bits);
+  }
+
+  inline float readQuantized(float minimum, float maximum,
+                             uint32_t bits) noexcept {
+    return dequantize(read(bits), minimum, maximum, bits);
+  }
+
+  inline float readAngle(uint32_t bits) noexcept {
+    return dequantizeAngle(read(bits), bits);
+  }
+
+  /**
+   * \brief Whether or not a read went past the end of the input.
+   */
+  [[nodiscard]] inline bool overflowed() const noexcept { return overflowed_; }
+};
+
+/**
+ * \brief Writes values one after another from a cursor, either into a fixed
+ * span or at the end of a vector that grows to fit them. A value that does not
+ * fit a fixed span is not written and marks the writer as overflowed, as does
+ * every value after it, so a message is checked once it is complete rather
+ * than at every field.
+ */
+class BufferWriter final {
+  Buffer buffer_{};
+  std::vector<uint8_t>* vector_{nullptr};
+  uint8_t* data_;
+  size_t capacity_;
+  size_t offset_;
+  bool overflowed_{false};
+
+  uint8_t* grow(size_t size) noexcept {
+    if (!vector_) {
+      overflowed_ = true;
+      capacity_ = offset_;
+      return nullptr;
+    }
+
+    vector_->resize(offset_ + size);
+    data_ = vector_->data();
+    capacity_ = vector_->size();
+
+    auto* at = data_ + offset_;
+    offset_ += size;
+    return at;
+  }
+
+ public:
+  /**
+   * \brief The most bytes a varint of 64 bits takes, 7 bits per byte.
+   */
+  constexpr static size_t kMaximumVarintSize = 10;
+
+  /**
+   * \param data The output.
+   * \param capacity The amount of bytes the output holds.
+   * \param offset Where the cursor starts.
+   */
+  BufferWriter(uint8_t* data, size_t capacity, size_t offset = 0) noexcept
+      : data_(data), capacity_(capacity), offset_(std::min(offset, capacity)) {}
+
+  /**
+   * \brief Writes after the existing contents of a vector, resizing it to fit
+   * every value.
+   */
+  explicit BufferWriter(std::vector<uint8_t>* vector) noexcept
+      : vector_(vector),
+        data_(vector->data()),
+        capacity_(vector->size()),
+        offset_(vector->size()) {}
+
+  /**
+   * \brief Advances the cursor past a span the caller fills in.
+   * \return The span, or nullptr if it does not fit.
+   */
+  [[nodiscard]] inline uint8_t* claim(size_t size) noexcept {
+    if (size <= capacity_ - offset_) {
+      auto* at = data_ + offset_;
+      offset_ += size;
+      return at;
+    }
+
+    return grow(size);
+  }
+
+  inline void writeUint8(uint8_t value) noexcept {
+    if (auto* at = claim(sizeof(uint8_t))) at[0] = value;
+  }
+
+  inline void writeUint16(uint16_t value) noexcept {
+    if (auto* at = claim(sizeof(uint16_t))) buffer_.writeUint16(at, value, 0);
+  }
+
+  inline void writeUint32(uint32_t value) noexcept {
+    if (auto* at = claim(sizeof(uint32_t))) buffer_.writeUint32(at, value, 0);
+  }
+
+  inline void writeFloat(float value) noexcept {
+    if (auto* at = claim(sizeof(float))) buffer_.writeFloat(at, value, 0);
+  }
+
+  /**
+   * \brief Writes an unsigned LEB128 varint: 7 bits per byte, least
+   * significant first, with the high bit set on every byte but the last.
+   */
+  inline void writeVarint(uint64_t value) noexcept {
+    if (value < 0x80u) {
+      writeUint8(static_cast<uint8_t>(value));
+      return;
+    }
+
+    uint8_t bytes[kMaximumVarintSize];
+    size_t size = 0;
+    while (value >= 0x80u) {
+      bytes[size++] = static_cast<uint8_t>(value | 0x80u);
+      value >>= 7u;
+    }
+    bytes[size++] = static_cast<uint8_t>(value);
+    writeBytes(bytes, size);
+  }
+
+  inline void writeBytes(const uint8_t* data, size_t size) noexcept {
+    if (auto* at = claim(size)) memcpy(at, data, size);
+  }
+
+  /**
+   * \brief Writes a string prefixed by its length as a varint.
+   */
+  inline void writeString(const std::string& value) noexcept {
+    writeVarint(value.size());
+    writeBytes(reinterpret_cast<const uint8_t*>(value.data()), value.size());
+  }
+
+  /**
+   * \brief The position of the cursor, which is the size of the output when
+   * it started at 0.
+   */
+  [[nodiscard]] inline size_t size() const noexcept { return offset_; }
+
+  [[nodiscard]] inline bool overflowed() const noexcept { return overflowed_; }
+};
+
+/**
+ * \brief Reads values one after another from a cursor over a span. A value
+ * past its end reads as 0 and fails the reader, as does every value after it,
+ * so a message is checked once all of its fields were read.
+ */
+class BufferReader final {
+  Buffer buffer_{};
+  const uint8_t* data_;
+  size_t size_;
+  size_t offset_;
+  bool failed_;
+
+  inline void fail() noexcept {
+    failed_ = true;
+    offset_ = size_;
+  }
+
+ public:
+  /**
+   * \param data The input.
+   * \param size The amount of bytes the input holds.
+   * \param offset Where the cursor starts.
+   */
+  BufferReader(const uint8_t* data, size_t size, size_t offset = 0) noexcept
+      : data_(data),
+        size_(size),
+        offset_(std::min(offset, size)),
+        failed_(offset > size) {}
+
+  /**
+   * \brief Advances the cursor past a span the caller reads.
+   * \return The span, or nullptr if the input ends before it.
+   */
+  [[nodiscard]] inline const uint8_t* take(size_t size) noexcept {
+    if (size <= size_ - offset_) {
+      const auto* at = data_ + offset_;
+      offset_ += size;
+      return at;
+    }
+
+    fail();
+    return nullptr;
+  }
+
+  inline void skip(size_t size) noexcept { static_cast<void>(take(size)); }
+
+  [[nodiscard]] inline uint8_t readUint8() noexcept {
+    const auto* at = take(sizeof(uint8_t));
+    return at ? at[0] : 0;
+  }
+
+  [[nodiscard]] inline uint16_t readUint16() noexcept {
+    const auto* at = take(sizeof(uint16_t));
+    return at ? buffer_.readUInt16(at, 0) : 0;
+  }
+
+  [[nodiscard]] inline uint32_t readUint32() noexcept {
+    const auto* at = take(sizeof(uint32_t));
+    return at ? buffer_.readUInt32(at, 0) : 0;
+  }
+
+  [[nodiscard]] inline float readFloat() noexcept {
+    const auto* at = take(sizeof(float));
+    return at ? buffer_.readFloat(at, 0) : 0.f;
+  }
+
+  /**
+   * \brief Reads a varint written by BufferWriter::writeVarint(), failing on
+   * one that is longer than 64 bits.
+   */
+  [[nodiscard]] inline uint64_t readVarint() noexcept {
+    uint64_t value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+      if (offset_ == size_) break;
+
+      const auto byte = data_[offset_++];
+      value |= static_cast<uint64_t>(byte & 0x7Fu) << shift;
+      if ((byte & 0x80u) == 0) {
+        // The last byte holds a single bit, anything past it overflowed:
+        if (shift == 63 && byte > 1) break;
+        return value;
+      }
+    }
+
+    fail();
+    return 0;
+  }
+
+  /**
+   * \brief Reads a string written by BufferWriter::writeString().
+   * \param maximum The longest string accepted, a longer one fails the
+   * reader.
+   */
+  [[nodiscard]] inline std::string readString(
+      size_t maximum = 0xFFFFu) noexcept {
+    const auto length = readVarint();
+    if (length > maximum) {
+      fail();
+      return {};
+    }
+
+    const auto* at = take(static_cast<size_t>(length));
+    return at ? std::string(reinterpret_cast<const char*>(at),
+                            static_cast<size_t>(length))
+              : std::string{};
+  }
+
+  [[nodiscard]] inline size_t offset() const noexcept { return offset_; }
+
+  [[nodiscard]] inline size_t remaining() const noexcept {
+    return size_ - offset_;
+  }
+
+  /**
+   * \brief Whether or not every value read so far was within the input.
+   */
+  [[nodiscard]] inline bool valid() const noexcept { return !failed_; }
+};
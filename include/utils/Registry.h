@@ -0,0 +1,184 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief A generation-tagged handle into a Registry:
+ *
+ * | generation {16} | slot {16} |
+ *
+ * A slot's generation changes every time its value is removed, so a handle
+ * kept after the removal never finds the value that reuses the slot.
+ */
+class Handle final {
+ public:
+  Handle() = delete;
+  ~Handle() = delete;
+
+  /**
+   * \brief A handle no registry ever hands out, as generations start at 1.
+   */
+  constexpr static uint32_t kInvalid = 0;
+
+  [[nodiscard]] constexpr static inline uint32_t make(
+      uint16_t slot, uint16_t generation) noexcept {
+    return static_cast<uint32_t>(generation) << 16u | slot;
+  }
+
+  [[nodiscard]] constexpr static inline uint16_t slot(
+      uint32_t handle) noexcept {
+    return static_cast<uint16_t>(handle & 0xFFFFu);
+  }
+
+  [[nodiscard]] constexpr static inline uint16_t generation(
+      uint32_t handle) noexcept {
+    return static_cast<uint16_t>(handle >> 16u);
+  }
+};
+
+/**
+ * \brief A fixed amount of slots holding values by Handle. Looking a value up,
+ * inserting and removing it are O(1), and the values are kept packed so
+ * iterating over them does not visit the free slots.
+ * \tparam T The stored value type.
+ * \tparam Capacity The amount of values it can hold.
+ */
+template <typename T, size_t Capacity>
+class Registry final {
+  static_assert(Capacity != 0 && Capacity < 0x10000u,
+                "'Capacity' must fit the slot of a handle, below kFree");
+
+  constexpr static uint16_t kFree = 0xFFFFu;
+
+  struct slot_t {
+    uint16_t generation{1};
+    uint16_t index{kFree};
+  };
+
+  std::array<slot_t, Capacity> slots_{};
+  // The slot of each value, so the one moved by a removal can be updated:
+  std::array<uint16_t, Capacity> owners_{};
+  std::array<uint16_t, Capacity> free_{};
+  size_t freeCount_{Capacity};
+  std::vector<T> values_{};
+
+ public:
+  Registry() noexcept {
+    // Hand out the lowest slots first:
+    for (size_t i = 0; i < Capacity; ++i) {
+      free_[i] = static_cast<uint16_t>(Capacity - 1 - i);
+    }
+    values_.reserve(Capacity);
+  }
+
+  [[nodiscard]] constexpr static size_t capacity() noexcept { return Capacity; }
+
+  /**
+   * \brief Gets the handle the next insert() hands out.
+   * \return The handle, or Handle::kInvalid if the registry is full.
+   */
+  [[nodiscard]] inline uint32_t next() const noexcept {
+    if (freeCount_ == 0) return Handle::kInvalid;
+    const auto slot = free_[freeCount_ - 1];
+    return Handle::make(slot, slots_[slot].generation);
+  }
+
+  /**
+   * \brief Moves a value into a free slot.
+   * \return The handle of the value, or Handle::kInvalid if the registry is
+   * full.
+   */
+  inline uint32_t insert(T value) noexcept {
+    if (freeCount_ == 0) return Handle::kInvalid;
+
+    const auto slot = free_[--freeCount_];
+    slots_[slot].index = static_cast<uint16_t>(values_.size());
+    owners_[values_.size()] = slot;
+    values_.emplace_back(std::move(value));
+    return Handle::make(slot, slots_[slot].generation);
+  }
+
+  /**
+   * \brief Finds the value of a handle.
+   * \return The value, or nullptr if the handle was removed or never valid.
+   */
+  [[nodiscard]] inline T* find(uint32_t handle) noexcept {
+    const auto slot = Handle::slot(handle);
+    if (slot >= Capacity) return nullptr;
+
+    const auto& entry = slots_[slot];
+    if (entry.index == kFree ||
+        entry.generation != Handle::generation(handle)) {
+      return nullptr;
+    }
+
+    return &values_[entry.index];
+  }
+
+  /**
+   * \brief Removes the value of a handle, moving the last value into its
+   * place, which invalidates the iterators past it.
+   * \return Whether or not the handle had a value.
+   */
+  inline bool remove(uint32_t handle) noexcept {
+    if (find(handle) == nullptr) return false;
+
+    const auto slot = Handle::slot(handle);
+    auto& entry = slots_[slot];
+    const auto index = entry.index;
+    const auto last = values_.size() - 1;
+    if (index != last) {
+      values_[index] = std::move(values_[last]);
+      owners_[index] = owners_[last];
+      slots_[owners_[index]].index = index;
+    }
+    values_.pop_back();
+
+    entry.index = kFree;
+    // Skip the invalid handle's generation when it wraps around:
+    if (++entry.generation == 0) entry.generation = 1;
+    free_[freeCount_++] = slot;
+    return true;
+  }
+
+  [[nodiscard]] inline size_t size() const noexcept { return values_.size(); }
+  [[nodiscard]] inline bool empty() const noexcept { return values_.empty(); }
+
+  /**
+   * \brief Gets a value by its position in the packed storage, which changes
+   * when another value is removed.
+   */
+  [[nodiscard]] inline T& operator[](size_t index) noexcept {
+    return values_[index];
+  }
+
+  inline typename std::vector<T>::iterator begin() noexcept {
+    return values_.begin();
+  }
+  inline typename std::vector<T>::iterator end() noexcept {
+    return values_.end();
+  }
+  inline typename std::vector<T>::const_iterator begin() const noexcept {
+    return values_.begin();
+  }
+  inline typename std::vector<T>::const_iterator end() const noexcept {
+    return values_.end();
+  }
+
+  /**
+   * \brief Removes every value, keeping the generations so the old handles
+   * stay invalid.
+   */
+  inline void clear() noexcept {
+    while (!values_.empty()) {
+      const auto slot = owners_[values_.size() - 1];
+      remove(Handle::make(slot, slots_[slot].generation));
+    }
+  }
+};
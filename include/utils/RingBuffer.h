@@ -0,0 +1,78 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * \brief A fixed-capacity circular byte buffer, used to accumulate a stream's
+ * bytes until they can be consumed as complete messages.
+ * \tparam Capacity The amount of bytes it can hold, must be a power of two.
+ */
+template <size_t Capacity>
+class RingBuffer final {
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0,
+                "'Capacity' must be a power of two");
+
+  constexpr static size_t kMask = Capacity - 1;
+
+  std::array<uint8_t, Capacity> data_{};
+
+  /**
+   * \brief The read cursor, it only grows and is wrapped on access.
+   */
+  size_t head_{0};
+
+  /**
+   * \brief The write cursor, it only grows and is wrapped on access.
+   */
+  size_t tail_{0};
+
+ public:
+  [[nodiscard]] constexpr static size_t capacity() noexcept { return Capacity; }
+
+  [[nodiscard]] inline size_t size() const noexcept { return tail_ - head_; }
+
+  [[nodiscard]] inline size_t available() const noexcept {
+    return Capacity - size();
+  }
+
+  [[nodiscard]] inline bool empty() const noexcept { return head_ == tail_; }
+
+  [[nodiscard]] inline bool full() const noexcept { return size() == Capacity; }
+
+  /**
+   * \brief Gets the largest contiguous free region, so a socket can read into
+   * it directly. Call commit() afterwards with the amount of bytes written.
+   * \param size The size of the region.
+   * \return The pointer to the start of the region.
+   */
+  [[nodiscard]] inline uint8_t* writable(size_t* size) noexcept {
+    const auto offset = tail_ & kMask;
+    *size = std::min(available(), Capacity - offset);
+    return data_.data() + offset;
+  }
+
+  inline void commit(size_t size) noexcept { tail_ += size; }
+
+  /**
+   * \brief Copies bytes without consuming them, handling the wrap-around.
+   * \param output The destination, must fit size bytes.
+   * \param size The amount of bytes to copy, must not exceed this->size().
+   * \param offset The amount of bytes to skip from the read cursor.
+   */
+  inline void peek(uint8_t* output, size_t size,
+                   size_t offset = 0) const noexcept {
+    const auto start = (head_ + offset) & kMask;
+    const auto first = std::min(size, Capacity - start);
+    std::memcpy(output, data_.data() + start, first);
+    std::memcpy(output + first, data_.data(), size - first);
+  }
+
+  inline void consume(size_t size) noexcept { head_ += size; }
+
+  inline void clear() noexcept { head_ = tail_ = 0; }
+};
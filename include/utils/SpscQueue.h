@@ -0,0 +1,105 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/**
+ * \brief A bounded, lock-free queue for exactly one producer thread and one
+ * consumer thread. Values are moved in and out of a fixed ring, so pushing and
+ * popping never allocates.
+ * \tparam T The stored value type.
+ * \tparam Capacity The amount of values it can hold, must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue final {
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0,
+                "'Capacity' must be a power of two");
+
+  constexpr static size_t kMask = Capacity - 1;
+
+  // Keep the cursors on separate cache lines so the producer and the consumer
+  // do not invalidate each other's cache on every operation:
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+  alignas(64) std::atomic<size_t> highWaterMark_{0};
+  std::array<T, Capacity> values_{};
+
+ public:
+  [[nodiscard]] constexpr static size_t capacity() noexcept { return Capacity; }
+
+  /**
+   * \brief Moves a value into the queue, only the producer may call this.
+   * \return Whether or not there was room for it.
+   */
+  inline bool push(T value) noexcept {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    const auto size = tail - head_.load(std::memory_order_acquire);
+    if (size == Capacity) return false;
+
+    values_[tail & kMask] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+
+    if (size + 1 > highWaterMark_.load(std::memory_order_relaxed)) {
+      highWaterMark_.store(size + 1, std::memory_order_relaxed);
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief Moves the oldest value out of the queue, only the consumer may
+   * call this.
+   * \return Whether or not there was a value to read.
+   */
+  inline bool pop(T* value) noexcept {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+
+    *value = std::move(values_[head & kMask]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * \brief Moves every value that was queued when the call started into the
+   * output, releasing all their slots at once. Only the consumer may call
+   * this.
+   * \param output The destination, must fit at least size values.
+   * \param size The maximum amount of values to take.
+   * \return The amount of values taken.
+   */
+  inline size_t drain(T* output, size_t size) noexcept {
+    const auto head = head_.load(std::memory_order_relaxed);
+    const auto tail = tail_.load(std::memory_order_acquire);
+    const auto count = std::min(tail - head, size);
+    for (size_t i = 0; i < count; ++i) {
+      output[i] = std::move(values_[(head + i) & kMask]);
+    }
+
+    head_.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  /**
+   * \brief An approximation of the amount of queued values, exact only when
+   * called from the producer or the consumer while the other side is idle.
+   */
+  [[nodiscard]] inline size_t size() const noexcept {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]] inline bool empty() const noexcept { return size() == 0; }
+
+  /**
+   * \brief The largest amount of values that were queued at once.
+   */
+  [[nodiscard]] inline size_t highWaterMark() const noexcept {
+    return highWaterMark_.load(std::memory_order_relaxed);
+  }
+};
@@ -0,0 +1,74 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * \brief Paces a loop at a fixed rate against the monotonic clock. Each tick
+ * is due a whole interval after the previous one was, no matter how long the
+ * work between them took, so the loop does not drift, and a tick that starts
+ * late is followed by the next ones back to back until it caught up.
+ *
+ * \note Not thread-safe, each loop owns its own scheduler.
+ */
+class TickScheduler final {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  /**
+   * \brief How far behind a loop may fall before the ticks it missed are
+   * skipped, rather than run back to back to catch up.
+   */
+  constexpr static uint32_t kMaximumLag = 5;
+
+ private:
+  // The operating system wakes a sleeping thread up to its timer resolution
+  // late, so the last stretch before a tick is spent yielding instead:
+  constexpr static std::chrono::microseconds kSpinMargin{1000};
+
+  clock::duration interval_;
+  clock::time_point next_;
+  uint64_t ticks_{0};
+  uint64_t overruns_{0};
+
+  void advance(clock::time_point now) noexcept;
+
+ public:
+  /**
+   * \brief Schedules the first tick an interval from now.
+   * \param rate The amount of ticks per second, must not be 0.
+   */
+  explicit TickScheduler(uint32_t rate) noexcept;
+
+  /**
+   * \brief Sleeps until the next tick is due, counting an overrun when it
+   * already was, as the work since the previous one took too long.
+   */
+  void wait() noexcept;
+
+  /**
+   * \brief Checks whether the next tick is due without sleeping, for loops
+   * that wait on something else between ticks.
+   * \return Whether or not it was, in which case it is consumed.
+   */
+  bool poll() noexcept;
+
+  /**
+   * \brief The time left until the next tick is due, zero if it already is.
+   */
+  [[nodiscard]] clock::duration remaining() const noexcept;
+
+  [[nodiscard]] inline clock::duration interval() const noexcept {
+    return interval_;
+  }
+
+  [[nodiscard]] inline uint64_t ticks() const noexcept { return ticks_; }
+
+  /**
+   * \brief The amount of ticks wait() found already due, each of them caused
+   * by work that did not fit in an interval.
+   */
+  [[nodiscard]] inline uint64_t overruns() const noexcept { return overruns_; }
+};
@@ -1,16 +1,21 @@
 // Copyright (c) 2020 Antonio Román. All rights reserved.
 #include "components/NetworkController.h"
 
+#include <cmath>
+#include <cstdio>
+#include <iostream>
 #include <thread>
 #include <utility>
 
-#include "components/BulletBox.h"
 #include "components/PhysicsBody.h"
+#include "components/PlayerController.h"
 #include "components/SolidRenderer.h"
+#include "components/TextRenderer.h"
 #include "components/Transform.h"
 #include "networking/Client.h"
 #include "scenes/Scene.h"
 #include "utils/DebugAssert.h"
+#include "utils/Time.h"
 
 NetworkController::NetworkController(
     std::weak_ptr<GameObject> gameObject) noexcept
@@ -25,6 +30,8 @@ void NetworkController::onAwake() noexcept {
 
   players_ = scene().lock()->getGameObjectByName("Players");
   bullets_ = scene().lock()->getGameObjectByName("Bullets");
+  walls_ = scene().lock()->getGameObjectByName("Destructible-Walls");
+  overlay_ = scene().lock()->getGameObjectByName("Network-Stats");
 
   client_ = std::make_unique<Client>();
   std::thread([&]() {
@@ -36,48 +43,55 @@ void NetworkController::onAwake() noexcept {
 void NetworkController::onUpdate() noexcept {
   Component::onUpdate();
 
-  client_event_t event{};
-  while (client_->readEvent(&event)) {
+  const auto count = client_->readEvents(events_.data(), events_.size());
+  for (size_t i = 0; i < count; ++i) {
+    const auto& event = events_[i];
     debug_print("[NETWORK] Received event %i\n", event.event);
     switch (event.event) {
       case IncomingClientEvent::kPlayerIdentify: {
-        const auto* pack =
-            reinterpret_cast<client_event_identify_t*>(event.data);
-        players_.lock()->children()[0]->id() = pack->id_;
+        const auto& pack = std::get<client_event_identify_t>(event.data);
+        players_.lock()->children()[0]->id() = pack.id_;
+        tickDuration_ = 1.0 / static_cast<double>(pack.tickRate_);
         break;
       }
-      case IncomingClientEvent::kPlayerConnect: {
-        const auto* pack =
-            reinterpret_cast<client_event_connect_t*>(event.data);
-        createPlayer(pack->player_);
+      case IncomingClientEvent::kPlayerDisconnect: {
+        const auto& pack = std::get<client_event_disconnect_t>(event.data);
+        removePlayer(pack.player_);
         break;
       }
-      case IncomingClientEvent::kPlayerInsertPosition: {
-        const auto* pack =
-            reinterpret_cast<client_event_player_insert_t*>(event.data);
-        createPlayer(pack->player_, pack->position_);
+      case IncomingClientEvent::kPlayerUpdatePosition: {
+        // Only sent to correct the local player, which predicts its movement:
+        const auto& pack = std::get<client_event_player_update_t>(event.data);
+        const auto player = players_.lock()->children()[0];
+        if (pack.player_ == player->id()) {
+          player->getComponent<PlayerController>()->reconcile(pack.sequence_,
+                                                              pack.position_);
+        }
         break;
       }
-      case IncomingClientEvent::kPlayerDisconnect: {
-        const auto* pack =
-            reinterpret_cast<client_event_disconnect_t*>(event.data);
-        removePlayer(pack->player_);
+      case IncomingClientEvent::kEntityUpdate: {
+        const auto& pack = std::get<client_event_entity_update_t>(event.data);
+        updateEntity(pack.entity_, pack.tick_, pack.position_);
         break;
       }
-      case IncomingClientEvent::kPlayerUpdatePosition: {
-        const auto* pack =
-            reinterpret_cast<client_event_player_update_t*>(event.data);
-        movePlayer(pack->player_, pack->position_);
+      case IncomingClientEvent::kEntityRemove: {
+        const auto& pack = std::get<client_event_entity_remove_t>(event.data);
+        removeEntity(pack.entity_);
         break;
       }
-      case IncomingClientEvent::kBulletShoot: {
-        const auto* pack =
-            reinterpret_cast<client_event_bullet_shoot_t*>(event.data);
-        createBullet(pack->position_, pack->velocity_);
+      case IncomingClientEvent::kWorldSnapshot: {
+        const auto& pack = std::get<client_event_snapshot_t>(event.data);
+        receiveSnapshot(pack.tick_);
         break;
       }
+      case IncomingClientEvent::kPong:
+        // Answers a ping, which the client handles itself:
+        break;
     }
   }
+
+  interpolate();
+  updateStats();
 }
 
 Json::Value NetworkController::toJson() const noexcept {
@@ -86,12 +100,14 @@ Json::Value NetworkController::toJson() const noexcept {
   return json;
 }
 
-void NetworkController::createPlayer(uint8_t id) const noexcept {
-  createPlayer(id, {50.f, 50.f});
-}
-
 void NetworkController::createPlayer(
-    uint8_t id, const Vector2<float>& position) const noexcept {
+    uint32_t id, const Vector2<float>& position) const noexcept {
+  // The player may already be known from a snapshot:
+  if (findChild(players_, id)) {
+    movePlayer(id, position);
+    return;
+  }
+
   auto go = std::make_shared<GameObject>(scene(), players_);
   go->name() = "Opponent";
   go->active() = true;
@@ -127,39 +143,175 @@ void NetworkController::createPlayer(
   players_.lock()->addChild(go);
 }
 
-void NetworkController::removePlayer(uint8_t id) const noexcept {
-  for (const auto& player : players_.lock()->children()) {
-    if (player->id() == id) {
-      player->destroy();
-      break;
+void NetworkController::removePlayer(uint32_t id) noexcept {
+  remotes_.erase(Snapshot::key(Snapshot::EntityType::kPlayer, id));
+  if (const auto player = findChild(players_, id)) player->destroy();
+}
+
+void NetworkController::movePlayer(
+    uint32_t id, const Vector2<float>& position) const noexcept {
+  if (const auto player = findChild(players_, id)) {
+    player->physics().lock()->body()->SetTransform(position.toVec(), 0.f);
+    player->transform().lock()->position().set(position);
+  }
+}
+
+void NetworkController::receiveSnapshot(uint32_t tick) noexcept {
+  // The server sends a snapshot every few ticks, and skips it when nothing
+  // changed, so the shortest gap between two is its interval:
+  if (snapshot_ != Snapshot::kNoBase && tick > snapshot_) {
+    snapshotInterval_ = std::min(snapshotInterval_, tick - snapshot_);
+  }
+
+  // The entities this snapshot does not update were still where they were at
+  // the previous one, whether it was received or skipped:
+  const auto previous =
+      snapshot_ == Snapshot::kNoBase
+          ? tick
+          : tick - std::min(snapshotInterval_, tick - snapshot_);
+  const auto time = static_cast<double>(previous) * tickDuration_;
+  for (auto& remote : remotes_) remote.second.buffer.hold(time);
+
+  snapshot_ = tick;
+  clock_.receive(static_cast<double>(tick) * tickDuration_);
+}
+
+void NetworkController::updateEntity(uint64_t entity, uint32_t tick,
+                                     const Vector2<float>& position) noexcept {
+  const auto id = Snapshot::id(entity);
+  const auto type = Snapshot::type(entity);
+  if (type == Snapshot::EntityType::kWall) {
+    // Walls do not move, they are only placed once:
+    if (const auto wall = findChild(walls_, id)) {
+      wall->physics().lock()->body()->SetTransform(position.toVec(), 0.f);
+    } else {
+      createWall(id, position);
+    }
+    return;
+  }
+
+  // The local player moves on its own, the server corrects it apart. It is
+  // also matched by its object, in case its ID and the client's disagree:
+  if (type == Snapshot::EntityType::kPlayer) {
+    const auto local = localPlayer();
+    if (id == client_->id() || (local && findChild(players_, id) == local)) {
+      return;
+    }
+  }
+
+  // The rest are moved by interpolate(), the new ones appear where they are
+  // first seen:
+  auto& remote = remotes_[entity];
+  if (remote.object.expired()) {
+    if (type == Snapshot::EntityType::kPlayer) {
+      createPlayer(id, position);
+      remote.object = findChild(players_, id);
+    } else {
+      createBullet(id, position);
+      remote.object = findChild(bullets_, id);
     }
+    remote.buffer = {};
   }
+
+  remote.buffer.push(static_cast<double>(tick) * tickDuration_, position);
 }
 
-void NetworkController::movePlayer(
-    uint8_t id, const Vector2<float>& position) const noexcept {
-  for (const auto& player : players_.lock()->children()) {
-    if (player->id() == id) {
-      player->physics().lock()->body()->SetTransform(position.toVec(), 0.f);
-      player->transform().lock()->position().set(position);
+void NetworkController::removeEntity(uint64_t entity) noexcept {
+  const auto id = Snapshot::id(entity);
+  switch (Snapshot::type(entity)) {
+    case Snapshot::EntityType::kPlayer:
+      if (id != client_->id()) removePlayer(id);
+      break;
+    case Snapshot::EntityType::kBullet:
+      remotes_.erase(entity);
+      if (const auto bullet = findChild(bullets_, id)) bullet->destroy();
+      break;
+    case Snapshot::EntityType::kWall:
+      if (const auto wall = findChild(walls_, id)) wall->destroy();
       break;
+  }
+}
+
+void NetworkController::interpolate() noexcept {
+  // Remote players and bullets are drawn a delay behind the latest snapshot,
+  // between the positions around that time, so they move smoothly no matter
+  // when the snapshots arrive:
+  clock_.advance(Time::delta());
+  const auto local = localPlayer();
+  for (auto it = remotes_.begin(); it != remotes_.end();) {
+    const auto object = it->second.object.lock();
+    if (!object || object->destroyed() || object == local) {
+      it = remotes_.erase(it);
+      continue;
     }
+
+    const auto position = it->second.buffer.sample(clock_.time());
+    object->physics().lock()->body()->SetTransform(position.toVec(), 0.f);
+    ++it;
   }
 }
 
+uint32_t NetworkController::viewTick() const noexcept {
+  if (snapshot_ == Snapshot::kNoBase) return Snapshot::kNoBase;
+
+  // The clock starts a delay behind the first snapshot, which may be before
+  // the first tick:
+  const auto tick = std::round(clock_.time() / tickDuration_);
+  return tick <= 0.0 ? 0 : static_cast<uint32_t>(tick);
+}
+
+void NetworkController::updateStats() noexcept {
+  statsElapsed_ += Time::delta();
+  if (statsElapsed_ < kStatsInterval) return;
+
+  const auto stats = client_->statsInterval();
+  report_ += stats;
+  reportElapsed_ += statsElapsed_;
+
+  // The overlay is optional, a scene shows it with a "Network-Stats" object:
+  const auto overlay = overlay_.lock();
+  const auto renderer =
+      overlay ? overlay->getComponent<TextRenderer>() : nullptr;
+  if (renderer) {
+    const auto in = stats.totalIn();
+    const auto out = stats.totalOut();
+    char text[128];
+    snprintf(text, sizeof(text),
+             "RTT %.0fms (jitter %.0fms) - in %.1f KiB/s - out %.1f KiB/s - "
+             "%llu dropped",
+             stats.roundTrip, stats.jitter,
+             static_cast<double>(in.bytes) / statsElapsed_ / 1024.0,
+             static_cast<double>(out.bytes) / statsElapsed_ / 1024.0,
+             static_cast<unsigned long long>(stats.dropped));
+    renderer->text() = text;
+    renderer->refresh();
+  }
+  statsElapsed_ = 0.0;
+
+  if (++reportIntervals_ != kReportIntervals) return;
+  std::cout << "[NETWORK] "
+            << NetworkStats::describe(report_, reportElapsed_,
+                                      NetworkStats::Side::kClient)
+            << ".\n";
+  report_ = {};
+  reportElapsed_ = 0.0;
+  reportIntervals_ = 0;
+}
+
 void NetworkController::createBullet(
-    const Vector2<float>& position,
-    const Vector2<double>& velocity) const noexcept {
+    uint32_t id, const Vector2<float>& position) const noexcept {
   const auto go = std::make_shared<GameObject>(scene());
   go->name() = "Bullet";
   go->active() = true;
+  go->id() = id;
 
   const auto newTransform = std::make_shared<Transform>(go->shared_from_this());
   newTransform->patch({{0, true}, position, {8, 8}});
 
+  // The server simulates the bullet, so it is only moved by the snapshots:
   const auto newPhysics = std::make_shared<PhysicsBody>(go->shared_from_this());
   newPhysics->patch({{1, true},
-                     b2BodyType::b2_dynamicBody,
+                     b2BodyType::b2_kinematicBody,
                      false,
                      1.f,
                      1.f,
@@ -167,12 +319,54 @@ void NetworkController::createBullet(
                      static_cast<uint16_t>(1 << 4),
                      static_cast<uint16_t>(0b11111)});
 
-  const auto newBullet = std::make_shared<BulletBox>(go->shared_from_this());
-  newBullet->patch({{2, true}, 2.f, velocity});
-
   go->addComponent(newTransform);
   go->addComponent(newPhysics);
-  go->addComponent(newBullet);
   go->onAwake();
   bullets_.lock()->addChild(go);
 }
+
+void NetworkController::createWall(
+    uint32_t id, const Vector2<float>& position) const noexcept {
+  const auto go = std::make_shared<GameObject>(scene(), walls_);
+  go->name() = "Wall";
+  go->active() = true;
+  go->id() = id;
+
+  const auto newTransform = std::make_shared<Transform>(go->shared_from_this());
+  newTransform->patch({{0, true}, position, {50, 50}});
+
+  constexpr const auto category =
+      static_cast<uint16_t>(PhysicsBodyMask::Boundary);
+  constexpr const auto mask = static_cast<uint16_t>(PhysicsBodyMask::Boundary) |
+                              static_cast<uint16_t>(PhysicsBodyMask::Bullet) |
+                              static_cast<uint16_t>(PhysicsBodyMask::Player);
+  const auto newPhysics = std::make_shared<PhysicsBody>(go->shared_from_this());
+  newPhysics->patch({{1, true},
+                     b2BodyType::b2_kinematicBody,
+                     false,
+                     1000000.f,
+                     0.f,
+                     1.f,
+                     category,
+                     mask});
+
+  go->addComponent(newTransform);
+  go->addComponent(newPhysics);
+  go->onAwake();
+  walls_.lock()->addChild(go);
+}
+
+std::shared_ptr<GameObject> NetworkController::localPlayer() const noexcept {
+  const auto players = players_.lock();
+  return players && !players->children().empty() ? players->children()[0]
+                                                 : nullptr;
+}
+
+std::shared_ptr<GameObject> NetworkController::findChild(
+    const std::weak_ptr<GameObject>& parent, uint32_t id) noexcept {
+  for (const auto& child : parent.lock()->children()) {
+    if (child->id() == id && !child->destroyed()) return child;
+  }
+
+  return nullptr;
+}
@@ -14,6 +14,7 @@
 #include "networking/Client.h"
 #include "objects/GameObject.h"
 #include "scenes/Scene.h"
+#include "utils/DebugAssert.h"
 #include "utils/Time.h"
 
 PlayerController::PlayerController(
@@ -62,13 +63,13 @@ void PlayerController::onUpdate() noexcept {
   }
 
   if (translation.x() == 0.f && translation.y() == 0.f) {
-    physicsBody_->body()->SetLinearVelocity({0.f, 0.f});
+    velocity_ = Vector2<float>{0.f, 0.f};
   } else {
     const auto s = speed();
     const auto m = translation.magnitude();
-    translation = translation * s / m;
-    physicsBody_->body()->SetLinearVelocity(translation.toVec());
+    velocity_ = translation * s / m;
   }
+  physicsBody_->body()->SetLinearVelocity(velocity_.toVec());
 
   if (bulletNext_ == 0.0 && bulletClip_ && Input::keyDown(KeyboardKey::SPACE)) {
     --bulletClip_;
@@ -80,19 +81,41 @@ void PlayerController::onUpdate() noexcept {
     const auto& pp = transform->position() + sp;
     const auto& mp = Input::mousePosition();
 
-    const auto angle = atan2(pp.y() - mp.y(), pp.x() - mp.x());
-    network_.lock()->client()->send(OutgoingClientEvent::kBulletShoot, &angle);
+    const auto network = network_.lock();
+    const client_shoot_t shot{
+        static_cast<float>(atan2(pp.y() - mp.y(), pp.x() - mp.x())),
+        network->viewTick()};
+    network->client()->send(ClientMessage::kBulletShoot, &shot);
   }
 }
 
 void PlayerController::onLateUpdate() noexcept {
   Component::onLateUpdate();
 
-  const auto& vec =
-      gameObject().lock()->physics().lock()->body()->GetPosition();
-  auto position = Vector2<float>(vec);
-  network_.lock()->client()->send(OutgoingClientEvent::kUpdatePosition,
-                                  &position);
+  // The player moved on its own, and is eased into where the last correction
+  // from the server replayed it to:
+  auto* body = physicsBody_->body();
+  const auto delta = static_cast<float>(Time::delta());
+  const auto correction = prediction_.smooth(delta);
+  if (correction.x() != 0.f || correction.y() != 0.f) {
+    const auto current = Vector2<float>(body->GetPosition());
+    body->SetTransform((current + correction).toVec(), body->GetAngle());
+  }
+
+  const auto position = Vector2<float>(body->GetPosition());
+  const client_position_t update{
+      prediction_.record(velocity_, delta), position, velocity_};
+  network_.lock()->client()->send(ClientMessage::kUpdatePosition, &update);
+}
+
+void PlayerController::reconcile(uint32_t sequence,
+                                 const Vector2<float>& position) noexcept {
+  const auto current = Vector2<float>(physicsBody_->body()->GetPosition());
+  if (!prediction_.reconcile(sequence, position, current)) return;
+
+  debug_print("[PREDICTION] Corrected by (%.2f, %.2f) at %u.\n",
+              static_cast<double>(prediction_.error().x()),
+              static_cast<double>(prediction_.error().y()), sequence);
 }
 
 #if !NDEBUG
@@ -21,6 +21,9 @@ void TextRenderer::refresh() noexcept {
   gameObject().lock()->transform().lock()->scale() =
       Vector2{surface->w, surface->h};
   rectangle_ = Vector4{0, 0, surface->w, surface->h};
+
+  // The text may be refreshed many times, the previous texture is released:
+  SDL_DestroyTexture(texture_);
   texture_ = SDL_CreateTextureFromSurface(Game::renderer(), surface);
   SDL_FreeSurface(surface);
 }
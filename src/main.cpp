@@ -19,9 +19,29 @@ int main(int argc, char** argv) {
                  _CRTDBG_LEAK_CHECK_DF);  // Check Memory Leaks
 #endif
   try {
-    if (argc == 2 && strcmp(argv[1], "server") == 0) {
-      auto server = std::make_shared<Server>();
+    if (argc >= 2 && strcmp(argv[1], "server") == 0) {
+      // The server runs headless, hosting rooms of the scene given after
+      // "server", optionally followed by the amount of rooms and the ticks per
+      // second:
+      const std::string scene = argc >= 3 ? argv[2] : "menu";
+      auto server =
+          argc >= 4 ? std::make_shared<Server>(
+                          scene, std::strtoul(argv[3], nullptr, 10),
+                          argc >= 5 ? static_cast<uint32_t>(
+                                          std::strtoul(argv[4], nullptr, 10))
+                                    : Simulation::kDefaultTickRate)
+                    : std::make_shared<Server>(scene);
       server->run();
+    } else if (argc >= 2 && strcmp(argv[1], "benchmark") == 0) {
+      // Followed by the scene and the seconds to measure each step for:
+      Server::benchmark(argc >= 3 ? argv[2] : "menu",
+                        argc >= 4 ? static_cast<uint32_t>(
+                                        std::strtoul(argv[3], nullptr, 10))
+                                  : 5);
+    } else if (argc >= 3 && strcmp(argv[1], "replay") == 0) {
+      // Followed by the log a server recorded with OBSTACLE_RUN_RECORD, and
+      // the scene it hosted:
+      Server::replay(argc >= 4 ? argv[3] : "menu", argv[2]);
     } else {
       ComponentManager::create();
       ImageManager::create();
@@ -2,6 +2,10 @@
 
 #include "networking/Client.h"
 
+#include <thread>
+
+#include "networking/Poller.h"
+#include "utils/Allocations.h"
 #include "utils/DebugAssert.h"
 
 Client::Client() noexcept {
@@ -13,6 +17,9 @@ Client::Client() noexcept {
     exit(1);
   }
 
+  serverAddress_ = SDLNet_Read32(&ip.host);
+  serverPort_ = 9999;
+
   socket_ = SDLNet_TCP_Open(&ip);
   if (!socket_) {
     std::cerr << "SDLNet_TCP_Open: " << SDLNet_GetError() << '\n';
@@ -22,104 +29,366 @@ Client::Client() noexcept {
   std::cout << "\033[0;32mReady!\033[0m\n";
 }
 
-Client::~Client() noexcept { SDLNet_TCP_Close(socket_); }
+Client::~Client() noexcept {
+  const auto total = uploads_.sent() + uploads_.skipped();
+  if (total != 0) {
+    std::cout << "[CLIENT] Sent " << uploads_.sent() << " of " << total
+              << " position(s), " << uploads_.skipped() * 100 / total
+              << "% saved.\n";
+  }
+
+  SDLNet_TCP_Close(socket_);
+}
 
 void Client::run() noexcept {
-  status_ = ClientStatus::kRunning;
+  status_.store(ClientStatus::kRunning, std::memory_order_release);
   std::cout << "[CLIENT] Running.\n";
 
+  std::thread datagrams([this]() { listenDatagrams(); });
+
   while (running()) {
-    // Read the buffer from the client
-    uint8_t message[64];
-    int len = SDLNet_TCP_Recv(socket_, message, 64);
+    // Read as much as fits in the buffer, it may hold several messages:
+    size_t size;
+    auto* data = received_.writable(&size);
+    int len = SDLNet_TCP_Recv(socket_, data, static_cast<int>(size));
     if (len <= 0) {
       if (len == 0)
         std::cout << "[CLIENT] Disconnected.\n";
       else
         std::cerr << "[CLIENT] TCP Error: " << SDLNet_GetError() << '\n';
-      status_ = ClientStatus::kClosed;
+      status_.store(ClientStatus::kClosed, std::memory_order_release);
       break;
     }
 
-    // Print the received message
-    debug_print("[CLIENT] Received [%i]: %.*s\n", len, len, message);
-    deserializeMessage(message);
+    // Print the received data
+    debug_print("[CLIENT] Received [%i]: %.*s\n", len, len, data);
+    received_.commit(static_cast<size_t>(len));
+
+    const auto allocations = Allocations::count();
+    const auto valid =
+        Protocol::drain(received_, [this](const uint8_t* message,
+                                          size_t size) {
+          deserializeMessage(message, size);
+        });
+    stats_.allocated(Allocations::count() - allocations);
+
+    if (!valid) {
+      std::cerr << "[CLIENT] Received a malformed message.\n";
+      status_.store(ClientStatus::kClosed, std::memory_order_release);
+      break;
+    }
   }
 
-  status_ = ClientStatus::kPending;
+  status_.store(ClientStatus::kPending, std::memory_order_release);
+  datagrams.join();
 }
 
-void Client::deserializeMessage(uint8_t* message) noexcept {
+void Client::deserializeMessage(const uint8_t* message, size_t size) noexcept {
   // Validate event number, if it does not match, skip:
-  const auto counter = buffer_->readUInt32(message, 0);
-  if (counter != remoteEvent_) return;
+  BufferReader reader{message, size, Protocol::kCounterOffset};
+  if (reader.readUint32() != remoteEvent_) {
+    stats_.dropped();
+    return;
+  }
 
   // Increase the remote event's number:
   ++remoteEvent_;
 
-  // Read the message type:
-  const auto type =
-      static_cast<IncomingClientEvent>(buffer_->readUint8(message, 4));
+  handleMessage(message, size);
+}
+
+void Client::handleMessage(const uint8_t* message, size_t size) noexcept {
+  stats_.received(message[Protocol::kTypeOffset], size);
+
+  // The events of a message are queued together, and before those of any
+  // message the other network thread handles after it. A message of an
+  // unknown type, or whose size does not match its schema, is ignored:
+  std::lock_guard<std::mutex> guard(message_mutex_);
+  ServerMessages::dispatch(message, size,
+                           [this](auto type, const auto&... fields) {
+                             handle(type, fields...);
+                           });
+}
+
+void Client::handle(PlayerIdentifyMessage, uint32_t id, uint32_t token,
+                    uint32_t tickRate) noexcept {
+  id_.store(id, std::memory_order_release);
+  token_.store(token);
+  identified_.store(true, std::memory_order_release);
+  pushEvent({IncomingClientEvent::kPlayerIdentify,
+             client_event_identify_t{id, tickRate}});
+}
+
+void Client::handle(PlayerUpdatePositionMessage, uint32_t player,
+                    uint32_t sequence,
+                    const Vector2<float>& position) noexcept {
+  pushEvent({IncomingClientEvent::kPlayerUpdatePosition,
+             client_event_player_update_t{player, sequence, position}});
+}
+
+void Client::handle(PongMessage, uint32_t sequence) noexcept {
+  // A pong for a ping whose slot was reused is too late to be measured:
+  auto& ping = pings_[sequence % pings_.size()];
+  const auto sent = ping.exchange(0, std::memory_order_acq_rel);
+  if (sent == 0) return;
+
+  const std::chrono::duration<double, std::milli> elapsed =
+      clock::now() - clock::time_point(clock::duration(sent));
+  stats_.roundTrip(elapsed.count());
+}
+
+void Client::handle(WorldSnapshotMessage, uint32_t tick, uint32_t base,
+                    uint8_t part, uint8_t count,
+                    const body_field_t::value_t& entries) noexcept {
+  if (count == 0 || count > Snapshot::kMaximumParts || part >= count) return;
+
+  // Snapshots arrive out of order through UDP, the older ones are useless:
+  if (appliedSnapshot_ != Snapshot::kNoBase && tick <= appliedSnapshot_) return;
+  if (assembly_.tick != Snapshot::kNoBase && tick < assembly_.tick) return;
+
+  if (tick != assembly_.tick) {
+    assembly_.tick = tick;
+    assembly_.base = base;
+    assembly_.count = count;
+    assembly_.received = 0;
+  } else if (base != assembly_.base || count != assembly_.count) {
+    return;
+  }
+
+  assembly_.parts[part].assign(entries.data, entries.data + entries.size);
+  assembly_.received |= 1u << part;
+  if (assembly_.received == (1ull << count) - 1u) applySnapshot();
+}
+
+void Client::applySnapshot() noexcept {
+  const auto tick = assembly_.tick;
+  const auto base = assembly_.base;
+  assembly_.tick = Snapshot::kNoBase;
+
+  // The base is one of the snapshots this client acknowledged, so it is still
+  // kept unless it is older than any the server would use:
+  const snapshot_t* from = nullptr;
+  if (base != Snapshot::kNoBase) {
+    from = &snapshots_[base % snapshots_.size()];
+    if (from->tick != base) return;
+  }
+
+  snapshotEntries_.clear();
+  for (size_t i = 0; i < assembly_.count; ++i) {
+    const auto& part = assembly_.parts[i];
+    snapshotEntries_.insert(snapshotEntries_.end(), part.begin(), part.end());
+  }
+
+  if (!Snapshot::decode(from ? &from->entities : nullptr,
+                        snapshotEntries_.data(), snapshotEntries_.size(),
+                        &decoded_)) {
+    debug_print("[CLIENT] Received a malformed snapshot.\n");
+    return;
+  }
+
+  // Only what changed since the snapshot the game already has becomes an
+  // event, after one announcing the snapshot. If the events do not fit, the
+  // snapshot is skipped as a whole so the game never misses a change:
+  static const Snapshot::entities_t empty{};
+  const auto& applied =
+      appliedSnapshot_ == Snapshot::kNoBase
+          ? empty
+          : snapshots_[appliedSnapshot_ % snapshots_.size()].entities;
+  size_t changes = 1;
+  Snapshot::diff(
+      applied, decoded_, [&](const Snapshot::entity_t&) { ++changes; },
+      [&](uint64_t) { ++changes; });
+  if (kEventQueueSize - events_.size() < changes) {
+    debug_print("[CLIENT] Skipping snapshot %u, the event queue is full.\n",
+                tick);
+    return;
+  }
+
+  pushEvent({IncomingClientEvent::kWorldSnapshot,
+             client_event_snapshot_t{tick}});
+  Snapshot::diff(
+      applied, decoded_,
+      [&](const Snapshot::entity_t& entity) {
+        pushEvent({IncomingClientEvent::kEntityUpdate,
+                   client_event_entity_update_t{entity.key, tick,
+                                                entity.position}});
+      },
+      [&](uint64_t key) {
+        pushEvent({IncomingClientEvent::kEntityRemove,
+                   client_event_entity_remove_t{key}});
+      });
+
+  auto& snapshot = snapshots_[tick % snapshots_.size()];
+  snapshot.tick = tick;
+  snapshot.entities.swap(decoded_);
+  appliedSnapshot_ = tick;
+  receivedSnapshot_.store(tick, std::memory_order_release);
+}
+
+void Client::acknowledgeSnapshot() noexcept {
+  const auto tick = receivedSnapshot_.load(std::memory_order_acquire);
+  if (tick == acknowledgedSnapshot_) return;
+
+  acknowledgedSnapshot_ = tick;
+  send(ClientMessage::kAcknowledgeSnapshot, &tick);
+}
+
+void Client::ping() noexcept {
+  if (!identified_.load(std::memory_order_acquire)) return;
+
+  const auto now = clock::now();
+  if (now < nextPing_) return;
+
+  nextPing_ = now + kPingInterval;
+  pings_[ping_ % pings_.size()].store(now.time_since_epoch().count(),
+                                      std::memory_order_release);
+  send(ClientMessage::kPing, &ping_);
+  ++ping_;
+}
+
+NetworkStats::summary_t Client::stats() noexcept {
+  std::lock_guard<std::mutex> guard(channel_mutex_);
+  return stats_.summary(channel_.reliableSent(), channel_.resent(),
+                        events_.size(),
+                        channel_.pendingReliable());
+}
+
+void Client::send(ClientMessage type, const void* data) noexcept {
+  // The frame size and the event counter are written once the message is
+  // sent:
+  uint8_t message[kMaximumMessageSize];
   switch (type) {
-    case IncomingClientEvent::kPlayerIdentify: {
-      const auto id = buffer_->readUint8(message, 5);
-      pushEvent({type, new client_event_identify_t{id}});
-      break;
+    case ClientMessage::kUpdatePosition: {
+      const auto& update = *reinterpret_cast<const client_position_t*>(data);
+      if (!uploads_.allow(UploadPolicy::clock::now(), update.position,
+                          update.velocity)) {
+        return;
+      }
+
+      const auto size = UpdatePositionMessage::encode(message, update.sequence,
+                                                      update.position);
+      if (!sendDatagram(message, size, false)) send(message, size);
+      return;
     }
-    case IncomingClientEvent::kPlayerInsertPosition: {
-      const auto id = buffer_->readUint8(message, 5);
-      Vector2<float> position{buffer_->readFloat(message, 6),
-                              buffer_->readFloat(message, 6 + sizeof(float))};
-      pushEvent({type, new client_event_player_insert_t{id, position}});
-      break;
+    case ClientMessage::kBulletShoot: {
+      const auto& shot = *reinterpret_cast<const client_shoot_t*>(data);
+      const auto size =
+          BulletShootMessage::encode(message, shot.angle, shot.tick);
+      if (!sendDatagram(message, size, true)) send(message, size);
+      return;
     }
-    case IncomingClientEvent::kPlayerConnect: {
-      const auto id = buffer_->readUint8(message, 5);
-      pushEvent({type, new client_event_connect_t{id}});
-      break;
+    case ClientMessage::kBindDatagram: {
+      const auto size =
+          BindDatagramMessage::encode(message, id(), token_.load());
+
+      // Only meaningful through UDP, before the server starts answering:
+      std::lock_guard<std::mutex> guard(channel_mutex_);
+      if (channel_.sendReliable(message + Protocol::kPrefixSize,
+                                size - Protocol::kPrefixSize)) {
+        stats_.sent(message[Protocol::kTypeOffset], size);
+      }
+      return;
     }
-    case IncomingClientEvent::kPlayerDisconnect: {
-      const auto id = buffer_->readUint8(message, 5);
-      pushEvent({type, new client_event_disconnect_t{id}});
-      break;
+    case ClientMessage::kAcknowledgeSnapshot: {
+      const auto size = AcknowledgeSnapshotMessage::encode(
+          message, *reinterpret_cast<const uint32_t*>(data));
+
+      // A lost acknowledgement is superseded by the next one:
+      if (!sendDatagram(message, size, false, kAcknowledgeKey)) {
+        send(message, size);
+      }
+      return;
     }
-    case IncomingClientEvent::kPlayerUpdatePosition: {
-      const auto id = buffer_->readUint8(message, 5);
-      Vector2<float> position{buffer_->readFloat(message, 6),
-                              buffer_->readFloat(message, 6 + sizeof(float))};
-      pushEvent({type, new client_event_player_update_t{id, position}});
-      break;
+    case ClientMessage::kPing: {
+      const auto size = PingMessage::encode(
+          message, *reinterpret_cast<const uint32_t*>(data));
+      if (!sendDatagram(message, size, true)) send(message, size);
+      return;
     }
-    case IncomingClientEvent::kBulletShoot: {
-      Vector2<float> position{buffer_->readFloat(message, 5),
-                              buffer_->readFloat(message, 5 + sizeof(float))};
-      Vector2<double> velocity{
-          buffer_->readDouble(message, 5 + sizeof(float) * 2),
-          buffer_->readDouble(message, 5 + sizeof(float) * 2 + sizeof(double))};
-      pushEvent({type, new client_event_bullet_shoot_t{position, velocity}});
-      break;
+  }
+}
+
+bool Client::sendDatagram(const uint8_t* message, size_t size, bool reliable,
+                          uint32_t key) noexcept {
+  if (!datagramReady_.load(std::memory_order_acquire)) return false;
+
+  const auto* payload = message + Protocol::kPrefixSize;
+  const auto length = size - Protocol::kPrefixSize;
+  std::lock_guard<std::mutex> guard(channel_mutex_);
+  const auto queued = reliable ? channel_.sendReliable(payload, length)
+                               : channel_.sendUnreliable(key, payload, length);
+  if (queued) {
+    stats_.sent(message[Protocol::kTypeOffset], size);
+  } else if (reliable) {
+    // Sending it through TCP would let it overtake the frames queued before
+    // it, so a server that stopped acknowledging them is given up on:
+    std::cerr << "[CLIENT] The server stopped acknowledging datagrams.\n";
+    disconnect();
+    return true;
+  }
+  return queued;
+}
+
+void Client::listenDatagrams() noexcept {
+  Poller poller{};
+  datagram_ = Socket::datagram(0);
+  if (!datagram_.valid() || !poller.valid() ||
+      !poller.add(datagram_, &datagram_)) {
+    std::cerr << "[CLIENT] UDP Error, staying on TCP: " << Socket::lastError()
+              << '\n';
+    return;
+  }
+
+  // The datagrams are bound to this client with the token sent along with the
+  // identify message, and the server answers once it accepted them. Until
+  // then, or forever if UDP is blocked, everything goes through TCP:
+  auto bound = false;
+  uint8_t datagram[ReliableChannel::kMaximumDatagramSize];
+  poller_event_t events[1];
+  while (running()) {
+    if (!bound && identified_.load(std::memory_order_acquire)) {
+      send(ClientMessage::kBindDatagram);
+      bound = true;
     }
+
+    if (poller.wait(events, 1, kDatagramInterval) != 0) receiveDatagrams();
+
+    {
+      std::lock_guard<std::mutex> guard(channel_mutex_);
+      while (const auto size = channel_.write(datagram)) {
+        conditioner_.send(datagram_, datagram, size, serverAddress_,
+                          serverPort_);
+      }
+    }
+
+    conditioner_.update(datagram_);
   }
 }
 
-void Client::send(OutgoingClientEvent event, const void* data) noexcept {
-  switch (event) {
-    case OutgoingClientEvent::kUpdatePosition: {
-      constexpr static int32_t size = 5 + sizeof(float) * 2;
-      const auto& vector = *reinterpret_cast<const Vector2<float>*>(data);
-      uint8_t message[size];
-      buffer_->writeUint8(message, static_cast<uint8_t>(event), 4);
-      buffer_->writeFloat(message, vector.x(), 5);
-      buffer_->writeFloat(message, vector.y(), 5 + sizeof(float));
-      return send(message, size);
+void Client::receiveDatagrams() noexcept {
+  uint8_t datagram[ReliableChannel::kMaximumDatagramSize];
+  uint32_t ipAddress;
+  uint16_t port;
+  while (true) {
+    const auto size =
+        datagram_.receiveFrom(datagram, sizeof(datagram), &ipAddress, &port);
+    if (size < 0) return;
+    if (ipAddress != serverAddress_ || port != serverPort_) continue;
+
+    std::lock_guard<std::mutex> guard(channel_mutex_);
+    const auto valid = channel_.read(
+        datagram, static_cast<size_t>(size),
+        [this](const uint8_t* message, size_t length) {
+          handleMessage(message, length);
+        });
+    if (!valid) {
+      debug_print("[CLIENT] Received a malformed datagram.\n");
+      continue;
     }
-    case OutgoingClientEvent::kBulletShoot: {
-      constexpr static int32_t size = 5 + sizeof(float);
-      const auto& angle = *reinterpret_cast<const float*>(data);
-      uint8_t message[size];
-      buffer_->writeUint8(message, static_cast<uint8_t>(event), 4);
-      buffer_->writeFloat(message, angle, 5);
-      return send(message, size);
+
+    if (!datagramReady_.exchange(true, std::memory_order_acq_rel)) {
+      std::cout << "[CLIENT] The server bound the datagrams of player " << id()
+                << ".\n";
     }
   }
 }
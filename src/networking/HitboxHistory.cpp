@@ -0,0 +1,44 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/HitboxHistory.h"
+
+#include <algorithm>
+#include <limits>
+
+bool HitboxHistory::sweep(uint32_t tick, const Vector2<float>& from,
+                          const Vector2<float>& to, const Vector2<float>& size,
+                          uint32_t ignore, hit_t* hit) const noexcept {
+  const auto& data = frame(tick);
+
+  // The box hits a hitbox when its center enters the hitbox grown by the
+  // box's size, found with the slab test on both axes at once. A segment
+  // parallel to an axis is nudged off it, so the slab it starts in spans far
+  // past the segment instead of dividing zero by zero:
+  const auto width = extent_.x() + size.x();
+  const auto height = extent_.y() + size.y();
+  const auto inverse = [](float distance) {
+    return 1.f / (distance == 0.f ? 1e-12f : distance);
+  };
+  const auto inverseX = inverse(to.x() - from.x());
+  const auto inverseY = inverse(to.y() - from.y());
+
+  auto best = std::numeric_limits<float>::infinity();
+  size_t found = data.ids.size();
+  for (size_t i = 0; i < data.ids.size(); ++i) {
+    const auto x0 = (data.x[i] - width - from.x()) * inverseX;
+    const auto x1 = (data.x[i] + width - from.x()) * inverseX;
+    const auto y0 = (data.y[i] - height - from.y()) * inverseY;
+    const auto y1 = (data.y[i] + height - from.y()) * inverseY;
+    const auto enter = std::max({std::min(x0, x1), std::min(y0, y1), 0.f});
+    const auto exit = std::min({std::max(x0, x1), std::max(y0, y1), 1.f});
+    if (enter <= exit && enter < best && data.ids[i] != ignore) {
+      best = enter;
+      found = i;
+    }
+  }
+
+  if (found == data.ids.size()) return false;
+
+  *hit = {data.ids[found], {data.x[found], data.y[found]}, best};
+  return true;
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/InterestGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+int32_t InterestGrid::cell(float value) noexcept {
+  auto cell = std::floor(value / kCellSize);
+  // Also catches NaN, which fails every comparison:
+  if (!(cell > -kMaximumCell)) cell = -kMaximumCell;
+  if (cell > kMaximumCell) cell = kMaximumCell;
+  return static_cast<int32_t>(cell);
+}
+
+void InterestGrid::build(const Snapshot::entities_t& entities) noexcept {
+  entities_ = &entities;
+
+  // Count the entities of each bucket, then turn the counts into the offsets
+  // the buckets start at, and fill them in:
+  offsets_.fill(0);
+  for (const auto& entity : entities) {
+    const auto index = bucket(cell(entity.position.x()),
+                              cell(entity.position.y()));
+    ++offsets_[index + 1];
+  }
+
+  for (size_t i = 1; i < offsets_.size(); ++i) offsets_[i] += offsets_[i - 1];
+
+  indices_.resize(entities.size());
+  std::array<uint32_t, kBucketCount> next{};
+  std::copy(offsets_.begin(), offsets_.end() - 1, next.begin());
+  for (size_t i = 0; i < entities.size(); ++i) {
+    const auto& position = entities[i].position;
+    const auto index = bucket(cell(position.x()), cell(position.y()));
+    indices_[next[index]++] = static_cast<uint32_t>(i);
+  }
+}
+
+void InterestGrid::query(const Vector2<float>& center,
+                         const Vector2<float>& extent,
+                         std::vector<uint32_t>* indices) const noexcept {
+  indices->clear();
+  if (entities_ == nullptr) return;
+
+  const auto& entities = *entities_;
+  const auto minX = cell(center.x() - extent.x());
+  const auto maxX = cell(center.x() + extent.x());
+  const auto minY = cell(center.y() - extent.y());
+  const auto maxY = cell(center.y() + extent.y());
+  const auto cells = (static_cast<uint64_t>(maxX - minX) + 1) *
+                     (static_cast<uint64_t>(maxY - minY) + 1);
+
+  // A rectangle covering more cells than there are buckets visits some of
+  // them several times, checking every entity once is cheaper:
+  if (cells >= kBucketCount) {
+    for (size_t i = 0; i < entities.size(); ++i) {
+      if (contains(center, extent, entities[i].position)) {
+        indices->push_back(static_cast<uint32_t>(i));
+      }
+    }
+    return;
+  }
+
+  for (auto y = minY; y <= maxY; ++y) {
+    for (auto x = minX; x <= maxX; ++x) {
+      const auto index = bucket(x, y);
+      for (auto i = offsets_[index]; i != offsets_[index + 1]; ++i) {
+        const auto entity = indices_[i];
+        if (contains(center, extent, entities[entity].position)) {
+          indices->push_back(entity);
+        }
+      }
+    }
+  }
+
+  // Cells that share a bucket yield its entities more than once:
+  std::sort(indices->begin(), indices->end());
+  indices->erase(std::unique(indices->begin(), indices->end()),
+                 indices->end());
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/Interpolation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+void InterpolationBuffer::push(double time,
+                               const Vector2<float>& position) noexcept {
+  if (size_ != 0 && time <= at(size_ - 1).time) return;
+
+  samples_[next_] = {time, position};
+  next_ = (next_ + 1) % kCapacity;
+  size_ = std::min(size_ + 1, kCapacity);
+}
+
+Vector2<float> InterpolationBuffer::sample(double time) const noexcept {
+  const auto& latest = at(size_ - 1);
+  if (time >= latest.time) {
+    if (size_ == 1) return latest.position;
+
+    // Keep the entity moving as it did between the last two samples, as the
+    // next one is most likely late rather than lost:
+    const auto& previous = at(size_ - 2);
+    const auto ahead = std::min(time - latest.time, kMaximumExtrapolation);
+    const auto factor =
+        static_cast<float>(ahead / (latest.time - previous.time));
+    return latest.position + (latest.position - previous.position) * factor;
+  }
+
+  // The time is usually close to the latest sample, look for it from there:
+  auto index = size_ - 1;
+  while (index != 0 && at(index - 1).time > time) --index;
+  if (index == 0) return at(0).position;
+
+  const auto& from = at(index - 1);
+  const auto& to = at(index);
+  const auto factor =
+      static_cast<float>((time - from.time) / (to.time - from.time));
+  return from.position + (to.position - from.position) * factor;
+}
+
+InterpolationClock::InterpolationClock() noexcept : delay_(kDefaultDelay) {
+  if (const auto* value = std::getenv("OBSTACLE_RUN_INTERPOLATION_DELAY")) {
+    delay_ = static_cast<double>(std::strtoul(value, nullptr, 10)) / 1000.0;
+    std::cout << "[NETWORK] Drawing remote entities "
+              << static_cast<uint32_t>(delay_ * 1000.0) << "ms behind.\n";
+  }
+}
+
+void InterpolationClock::advance(double delta) noexcept {
+  if (!started_) return;
+
+  const auto target = latest_ - delay_;
+  const auto drift = target - (time_ + delta);
+  if (std::abs(drift) > kMaximumDrift) {
+    time_ = target;
+    return;
+  }
+
+  // Never backwards, an entity must not retrace its path:
+  time_ += std::max(0.0, delta + drift * std::min(1.0, delta * kCatchUpRate));
+}
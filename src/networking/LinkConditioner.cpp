@@ -0,0 +1,48 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/LinkConditioner.h"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+uint32_t readVariable(const char* name) noexcept {
+  const auto* value = std::getenv(name);
+  return value ? static_cast<uint32_t>(std::strtoul(value, nullptr, 10)) : 0;
+}
+}  // namespace
+
+LinkConditioner::LinkConditioner() noexcept
+    : latency_(readVariable("OBSTACLE_RUN_LATENCY")),
+      loss_(readVariable("OBSTACLE_RUN_PACKET_LOSS")) {
+  if (enabled()) {
+    std::cout << "[NETWORK] Simulating " << loss_ << "% packet loss and "
+              << latency_.count() << "ms of latency.\n";
+  }
+}
+
+void LinkConditioner::send(const Socket& socket, const uint8_t* data,
+                           size_t size, uint32_t ipAddress,
+                           uint16_t port) noexcept {
+  if (loss_ != 0 && random_() % 100 < loss_) return;
+
+  if (latency_.count() == 0) {
+    // A full kernel buffer means the datagram is lost, as on a real link:
+    static_cast<void>(socket.sendTo(data, size, ipAddress, port));
+    return;
+  }
+
+  delayed_.push_back({std::chrono::steady_clock::now() + latency_,
+                      std::vector<uint8_t>(data, data + size), ipAddress,
+                      port});
+}
+
+void LinkConditioner::update(const Socket& socket) noexcept {
+  const auto now = std::chrono::steady_clock::now();
+  while (!delayed_.empty() && delayed_.front().at <= now) {
+    const auto& datagram = delayed_.front();
+    static_cast<void>(socket.sendTo(datagram.data.data(), datagram.data.size(),
+                                    datagram.ipAddress, datagram.port));
+    delayed_.pop_front();
+  }
+}
@@ -0,0 +1,187 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/NetworkStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "networking/Messages.h"
+#include "utils/Allocations.h"
+
+static_assert(static_cast<size_t>(ServerMessage::kPong) <
+                  NetworkStats::kTypes,
+              "Every server message type must be counted");
+static_assert(static_cast<size_t>(ClientMessage::kPing) <
+                  NetworkStats::kTypes,
+              "Every client message type must be counted");
+
+namespace {
+NetworkStats::counters_t total(
+    const std::array<NetworkStats::counters_t, NetworkStats::kTypes>&
+        counters) noexcept {
+  NetworkStats::counters_t result{};
+  for (const auto& entry : counters) {
+    result.messages += entry.messages;
+    result.bytes += entry.bytes;
+  }
+  return result;
+}
+
+const char* typeName(NetworkStats::Side side, bool sent,
+                     size_t type) noexcept {
+  // The client sends what the server receives, and the other way around:
+  const auto client = (side == NetworkStats::Side::kClient) == sent;
+  return client ? name(static_cast<ClientMessage>(type))
+                : name(static_cast<ServerMessage>(type));
+}
+
+void describeDirection(
+    std::string& line,
+    const std::array<NetworkStats::counters_t, NetworkStats::kTypes>& counters,
+    double seconds, NetworkStats::Side side, bool sent) noexcept {
+  const auto sum = total(counters);
+  char buffer[96];
+  snprintf(buffer, sizeof(buffer), "%s %.0f msg/s (%.1f KiB/s",
+           sent ? "out" : "in",
+           static_cast<double>(sum.messages) / seconds,
+           static_cast<double>(sum.bytes) / seconds / 1024.0);
+  line += buffer;
+
+  auto separator = ": ";
+  for (size_t type = 0; type < counters.size(); ++type) {
+    if (counters[type].messages == 0) continue;
+    snprintf(buffer, sizeof(buffer), "%s%s %.0f/%.1f", separator,
+             typeName(side, sent, type),
+             static_cast<double>(counters[type].messages) / seconds,
+             static_cast<double>(counters[type].bytes) / seconds / 1024.0);
+    line += buffer;
+    separator = ", ";
+  }
+  line += ')';
+}
+}  // namespace
+
+NetworkStats::counters_t NetworkStats::summary_t::totalIn() const noexcept {
+  return total(in);
+}
+
+NetworkStats::counters_t NetworkStats::summary_t::totalOut() const noexcept {
+  return total(out);
+}
+
+NetworkStats::summary_t& NetworkStats::summary_t::operator+=(
+    const summary_t& other) noexcept {
+  for (size_t type = 0; type < kTypes; ++type) {
+    in[type].messages += other.in[type].messages;
+    in[type].bytes += other.in[type].bytes;
+    out[type].messages += other.out[type].messages;
+    out[type].bytes += other.out[type].bytes;
+  }
+
+  dropped += other.dropped;
+  reliableSent += other.reliableSent;
+  resent += other.resent;
+  allocations += other.allocations;
+
+  const auto samples = roundTrips + other.roundTrips;
+  if (samples != 0) {
+    const auto weight = static_cast<double>(other.roundTrips) /
+                        static_cast<double>(samples);
+    roundTrip += (other.roundTrip - roundTrip) * weight;
+    jitter += (other.jitter - jitter) * weight;
+  }
+  roundTrips = samples;
+
+  inboundQueue = std::max(inboundQueue, other.inboundQueue);
+  outboundQueue = std::max(outboundQueue, other.outboundQueue);
+  return *this;
+}
+
+void NetworkStats::roundTrip(double milliseconds) noexcept {
+  std::lock_guard<std::mutex> guard(roundTrip_mutex_);
+  if (roundTrips_++ == 0) {
+    roundTrip_ = milliseconds;
+    jitter_ = milliseconds / 2.0;
+    return;
+  }
+
+  jitter_ += (std::abs(milliseconds - roundTrip_) - jitter_) * kJitterGain;
+  roundTrip_ += (milliseconds - roundTrip_) * kRoundTripGain;
+}
+
+NetworkStats::summary_t NetworkStats::summary(
+    uint64_t reliableSent, uint64_t resent, size_t inboundQueue,
+    size_t outboundQueue) const noexcept {
+  summary_t result{};
+  for (size_t type = 0; type < kTypes; ++type) {
+    result.in[type] = {in_[type].messages.load(std::memory_order_relaxed),
+                       in_[type].bytes.load(std::memory_order_relaxed)};
+    result.out[type] = {out_[type].messages.load(std::memory_order_relaxed),
+                        out_[type].bytes.load(std::memory_order_relaxed)};
+  }
+
+  result.dropped = dropped_.load(std::memory_order_relaxed);
+  result.reliableSent = reliableSent;
+  result.resent = resent;
+  result.allocations = allocations_.load(std::memory_order_relaxed);
+  result.inboundQueue = inboundQueue;
+  result.outboundQueue = outboundQueue;
+
+  std::lock_guard<std::mutex> guard(roundTrip_mutex_);
+  result.roundTrips = roundTrips_;
+  result.roundTrip = roundTrip_;
+  result.jitter = jitter_;
+  return result;
+}
+
+NetworkStats::summary_t NetworkStats::interval(const summary_t& now) noexcept {
+  auto result = now;
+  for (size_t type = 0; type < kTypes; ++type) {
+    result.in[type].messages -= reported_.in[type].messages;
+    result.in[type].bytes -= reported_.in[type].bytes;
+    result.out[type].messages -= reported_.out[type].messages;
+    result.out[type].bytes -= reported_.out[type].bytes;
+  }
+
+  result.dropped -= reported_.dropped;
+  result.reliableSent -= reported_.reliableSent;
+  result.resent -= reported_.resent;
+  result.allocations -= reported_.allocations;
+  result.roundTrips -= reported_.roundTrips;
+  reported_ = now;
+  return result;
+}
+
+std::string NetworkStats::describe(const summary_t& summary, double seconds,
+                                   Side side) noexcept {
+  std::string line;
+  describeDirection(line, summary.in, seconds, side, false);
+  line += ", ";
+  describeDirection(line, summary.out, seconds, side, true);
+
+  // Only the client pings, the server has no round trip to tell:
+  char buffer[160];
+  if (summary.roundTrips != 0) {
+    snprintf(buffer, sizeof(buffer), ", round trip %.1fms (jitter %.1fms)",
+             summary.roundTrip, summary.jitter);
+    line += buffer;
+  }
+
+  snprintf(buffer, sizeof(buffer),
+           ", %.1f%% resent, %llu dropped, queues %zu in and %zu out",
+           summary.reliableSent == 0
+               ? 0.0
+               : static_cast<double>(summary.resent) * 100.0 /
+                     static_cast<double>(summary.reliableSent),
+           static_cast<unsigned long long>(summary.dropped),
+           summary.inboundQueue, summary.outboundQueue);
+  line += buffer;
+
+  if (Allocations::counted()) {
+    snprintf(buffer, sizeof(buffer), ", %llu allocation(s) receiving",
+             static_cast<unsigned long long>(summary.allocations));
+    line += buffer;
+  }
+  return line;
+}
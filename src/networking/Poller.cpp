@@ -0,0 +1,98 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/Poller.h"
+
+#if OBSTACLE_RUN_EPOLL
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#if OBSTACLE_RUN_EPOLL
+Poller::Poller() noexcept : epoll_(epoll_create1(EPOLL_CLOEXEC)) {}
+
+Poller::~Poller() noexcept {
+  if (valid()) close(epoll_);
+}
+
+bool Poller::valid() const noexcept { return epoll_ >= 0; }
+
+bool Poller::add(const Socket& socket, void* data) noexcept {
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLRDHUP;
+  event.data.ptr = data;
+  return epoll_ctl(epoll_, EPOLL_CTL_ADD, socket.handle(), &event) == 0;
+}
+
+void Poller::remove(const Socket& socket) noexcept {
+  epoll_ctl(epoll_, EPOLL_CTL_DEL, socket.handle(), nullptr);
+}
+
+size_t Poller::wait(poller_event_t* events, size_t size,
+                    int32_t timeout) noexcept {
+  constexpr static size_t kBatchSize = 256;
+  epoll_event ready[kBatchSize];
+
+  const auto count = epoll_wait(epoll_, ready,
+                                static_cast<int>(std::min(size, kBatchSize)),
+                                static_cast<int>(timeout));
+  if (count <= 0) return 0;
+
+  for (int i = 0; i < count; ++i) {
+    const auto flags = ready[i].events;
+    events[i] = {ready[i].data.ptr, (flags & EPOLLIN) != 0,
+                 (flags & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0};
+  }
+
+  return static_cast<size_t>(count);
+}
+#else
+Poller::Poller() noexcept = default;
+
+Poller::~Poller() noexcept = default;
+
+bool Poller::valid() const noexcept { return true; }
+
+bool Poller::add(const Socket& socket, void* data) noexcept {
+  descriptors_.push_back({socket.handle(), POLLIN, 0});
+  data_.push_back(data);
+  return true;
+}
+
+void Poller::remove(const Socket& socket) noexcept {
+  for (size_t i = 0; i < descriptors_.size(); ++i) {
+    if (descriptors_[i].fd != socket.handle()) continue;
+
+    // Swap-and-pop, the order of the descriptors is irrelevant:
+    descriptors_[i] = descriptors_.back();
+    descriptors_.pop_back();
+    data_[i] = data_.back();
+    data_.pop_back();
+    return;
+  }
+}
+
+size_t Poller::wait(poller_event_t* events, size_t size,
+                    int32_t timeout) noexcept {
+#if _WIN32
+  const auto count = WSAPoll(descriptors_.data(),
+                             static_cast<ULONG>(descriptors_.size()), timeout);
+#else
+  const auto count = poll(descriptors_.data(),
+                          static_cast<nfds_t>(descriptors_.size()), timeout);
+#endif
+  if (count <= 0) return 0;
+
+  size_t written = 0;
+  for (size_t i = 0; i < descriptors_.size() && written < size; ++i) {
+    const auto flags = descriptors_[i].revents;
+    if (flags == 0) continue;
+
+    events[written++] = {data_[i], (flags & POLLIN) != 0,
+                         (flags & (POLLHUP | POLLERR | POLLNVAL)) != 0};
+  }
+
+  return written;
+}
+#endif
@@ -0,0 +1,45 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/Prediction.h"
+
+#include <algorithm>
+
+uint32_t Prediction::record(const Vector2<float>& velocity,
+                            float duration) noexcept {
+  at(next_) = {velocity, duration};
+  return next_++;
+}
+
+bool Prediction::reconcile(uint32_t sequence, const Vector2<float>& position,
+                           const Vector2<float>& current) noexcept {
+  // The sequences wrap around, so they are compared by their distance to the
+  // next one:
+  const auto age = next_ - sequence;
+  if (age == 0 || age > kCapacity) return false;
+  if (corrections_ != 0 && age > next_ - confirmed_) return false;
+
+  confirmed_ = sequence;
+  ++corrections_;
+
+  // The commands that followed the corrected one are replayed from where the
+  // server put the player:
+  auto predicted = position;
+  for (auto i = sequence + 1; i != next_; ++i) {
+    const auto& command = at(i);
+    predicted = predicted + command.velocity * command.duration;
+  }
+
+  // Replaces the error left from an earlier correction rather than adding to
+  // it, as the replay already accounts for it:
+  error_ = predicted - current;
+  return true;
+}
+
+Vector2<float> Prediction::smooth(float delta) noexcept {
+  const auto share = error_.magnitude() > kSnapDistance
+                         ? 1.f
+                         : std::min(1.f, delta * kSmoothingRate);
+  const auto step = error_ * share;
+  error_ = error_ - step;
+  return step;
+}
@@ -0,0 +1,139 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/ReliableChannel.h"
+
+bool ReliableChannel::sendReliable(const uint8_t* payload,
+                                   size_t size) noexcept {
+  if (size > kMaximumPayloadSize) return false;
+
+  // Frames queued behind the full window keep their place, this one follows
+  // them:
+  if (!queued_.empty() || nextOutgoing_ - oldestOutgoing_ == kWindowSize) {
+    if (queued_.size() == kMaximumQueued) return false;
+
+    queued_.emplace_back();
+    writeFrame(queued_.back(),
+               nextOutgoing_ + static_cast<uint32_t>(queued_.size() - 1),
+               payload, size);
+    return true;
+  }
+
+  auto& outgoing = outgoing_[nextOutgoing_ % kWindowSize];
+  writeFrame(outgoing.frame, nextOutgoing_, payload, size);
+  outgoing.sent = false;
+  outgoing.pending = true;
+  ++nextOutgoing_;
+  return true;
+}
+
+bool ReliableChannel::sendUnreliable(uint32_t key, const uint8_t* payload,
+                                     size_t size) noexcept {
+  if (size > kMaximumUnreliablePayloadSize) return false;
+
+  for (size_t i = 0; i < unreliableCount_; ++i) {
+    if (unreliable_[i].key != key) continue;
+    writeFrame(unreliable_[i].frame, kUnreliable, payload, size);
+    return true;
+  }
+
+  if (unreliableCount_ == kUnreliableSize) return false;
+
+  auto& unreliable = unreliable_[unreliableCount_++];
+  unreliable.key = key;
+  writeFrame(unreliable.frame, kUnreliable, payload, size);
+  return true;
+}
+
+size_t ReliableChannel::write(uint8_t* datagram) noexcept {
+  const auto now = std::chrono::steady_clock::now();
+  auto size = kHeaderSize;
+
+  // Reliable frames go first, so they are not starved by unreliable ones:
+  for (auto id = oldestOutgoing_; id != nextOutgoing_; ++id) {
+    auto& outgoing = outgoing_[id % kWindowSize];
+    if (!outgoing.pending) continue;
+    if (outgoing.sent && now - outgoing.sentAt < kResendDelay) continue;
+    if (size + outgoing.frame.size > kMaximumDatagramSize) break;
+
+    std::memcpy(datagram + size, outgoing.frame.data.data(),
+                outgoing.frame.size);
+    size += outgoing.frame.size;
+    if (outgoing.sent) ++resent_;
+    ++reliableSent_;
+    outgoing.sentAt = now;
+    outgoing.sequence = sequence_;
+    outgoing.sent = true;
+  }
+
+  // The unreliable frames that do not fit wait for the next datagram:
+  size_t kept = 0;
+  for (size_t i = 0; i < unreliableCount_; ++i) {
+    const auto& frame = unreliable_[i].frame;
+    if (size + frame.size > kMaximumDatagramSize) {
+      unreliable_[kept++] = unreliable_[i];
+      continue;
+    }
+
+    std::memcpy(datagram + size, frame.data.data(), frame.size);
+    size += frame.size;
+  }
+  unreliableCount_ = kept;
+
+  if (size == kHeaderSize && !acknowledge_) return 0;
+
+  buffer_.writeUint16(datagram, sequence_++, kSequenceOffset);
+  buffer_.writeUint16(datagram, remoteSequence_, kAckOffset);
+  buffer_.writeUint32(datagram, receivedBits_, kAckBitsOffset);
+  acknowledge_ = false;
+  return size;
+}
+
+bool ReliableChannel::track(uint16_t sequence) noexcept {
+  acknowledge_ = true;
+
+  if (!received_ || newer(sequence, remoteSequence_)) {
+    const auto shift = static_cast<uint16_t>(sequence - remoteSequence_);
+    if (!received_ || shift > 32) {
+      receivedBits_ = 0;
+    } else if (shift == 32) {
+      receivedBits_ = 1u << 31u;
+    } else {
+      receivedBits_ = (receivedBits_ << shift) | (1u << (shift - 1u));
+    }
+
+    remoteSequence_ = sequence;
+    received_ = true;
+    return true;
+  }
+
+  const auto age = static_cast<uint16_t>(remoteSequence_ - sequence);
+  if (age != 0 && age <= 32) receivedBits_ |= 1u << (age - 1u);
+  return false;
+}
+
+void ReliableChannel::acknowledged(uint16_t ack, uint32_t ackBits) noexcept {
+  for (auto id = oldestOutgoing_; id != nextOutgoing_; ++id) {
+    auto& outgoing = outgoing_[id % kWindowSize];
+    if (!outgoing.pending || !outgoing.sent) continue;
+
+    const auto age = static_cast<uint16_t>(ack - outgoing.sequence);
+    if (age == 0 || (age <= 32 && (ackBits & (1u << (age - 1u))) != 0)) {
+      outgoing.pending = false;
+    }
+  }
+
+  while (oldestOutgoing_ != nextOutgoing_ &&
+         !outgoing_[oldestOutgoing_ % kWindowSize].pending) {
+    ++oldestOutgoing_;
+  }
+
+  // The frames waiting behind the window take the slots it released:
+  while (!queued_.empty() && nextOutgoing_ - oldestOutgoing_ != kWindowSize) {
+    auto& outgoing = outgoing_[nextOutgoing_ % kWindowSize];
+    outgoing.frame = queued_.front();
+    outgoing.sent = false;
+    outgoing.pending = true;
+    queued_.pop_front();
+    ++nextOutgoing_;
+  }
+}
@@ -0,0 +1,154 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/Replay.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "networking/Protocol.h"
+#include "utils/Buffer.h"
+
+namespace {
+constexpr uint8_t kMagic[4] = {'O', 'R', 'R', 'L'};
+}  // namespace
+
+Replay::Recorder::Recorder(const std::string& path, uint32_t tickRate,
+                           uint32_t rooms) noexcept
+    : file_(std::fopen(path.c_str(), "wb")), tickRate_(tickRate) {
+  if (!file_) {
+    std::cerr << "[REPLAY] Could not create '" << path << "'.\n";
+    return;
+  }
+
+  buffer_.reserve(kBufferSize);
+  BufferWriter writer{&buffer_};
+  writer.writeBytes(kMagic, sizeof(kMagic));
+  writer.writeUint8(kVersion);
+  writer.writeUint32(tickRate);
+  writer.writeUint32(rooms);
+  std::cout << "[REPLAY] Recording to '" << path << "'.\n";
+}
+
+Replay::Recorder::~Recorder() noexcept {
+  if (!file_) return;
+
+  write();
+  std::fclose(file_);
+  std::cout << "[REPLAY] Recorded " << entries_ << " entries, " << written_
+            << " bytes.\n";
+}
+
+void Replay::Recorder::write() noexcept {
+  if (buffer_.empty()) return;
+
+  // A short write leaves a truncated entry, which the reader reports:
+  written_ += std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+  std::fflush(file_);
+  buffer_.clear();
+}
+
+void Replay::Recorder::tick(uint64_t tick) noexcept {
+  // Written once per second, and whenever the buffer grew past its size, so a
+  // server that is killed loses at most a second of the log:
+  if (tick % tickRate_ == 0 || buffer_.size() >= kBufferSize) write();
+  tick_ = tick;
+}
+
+void Replay::Recorder::begin(Kind kind, uint32_t client) noexcept {
+  // Stamped relative to the previous entry, which is rarely more than a tick
+  // away, so the tick usually takes a single byte:
+  BufferWriter writer{&buffer_};
+  writer.writeUint8(static_cast<uint8_t>(kind));
+  writer.writeVarint(tick_ - stamped_);
+  writer.writeVarint(client);
+  stamped_ = tick_;
+  ++entries_;
+}
+
+void Replay::Recorder::connect(uint32_t client, uint32_t room) noexcept {
+  if (!file_) return;
+  begin(Kind::kConnect, client);
+  BufferWriter{&buffer_}.writeVarint(room);
+}
+
+void Replay::Recorder::message(uint32_t client, const uint8_t* message,
+                               size_t size) noexcept {
+  if (!file_ || size < Protocol::kHeaderSize) return;
+  begin(Kind::kMessage, client);
+  BufferWriter writer{&buffer_};
+  writer.writeVarint(size - Protocol::kPrefixSize);
+  writer.writeBytes(message + Protocol::kPrefixSize,
+                    size - Protocol::kPrefixSize);
+}
+
+void Replay::Recorder::disconnect(uint32_t client) noexcept {
+  if (!file_) return;
+  begin(Kind::kDisconnect, client);
+}
+
+Replay::Reader::Reader(const std::string& path) noexcept {
+  auto* file = std::fopen(path.c_str(), "rb");
+  if (!file) return;
+
+  uint8_t chunk[1u << 16u];
+  size_t read;
+  while ((read = std::fread(chunk, 1, sizeof(chunk), file)) != 0) {
+    data_.insert(data_.end(), chunk, chunk + read);
+  }
+  std::fclose(file);
+
+  if (data_.size() < kHeaderSize ||
+      std::memcmp(data_.data(), kMagic, sizeof(kMagic)) != 0 ||
+      data_[sizeof(kMagic)] != kVersion) {
+    return;
+  }
+
+  BufferReader reader{data_.data(), kHeaderSize, sizeof(kMagic) + 1};
+  tickRate_ = reader.readUint32();
+  rooms_ = reader.readUint32();
+  valid_ = tickRate_ != 0;
+}
+
+bool Replay::Reader::next(entry_t* entry) noexcept {
+  if (!valid_ || offset_ == data_.size()) return false;
+
+  // Any entry cut short or out of range ends the replay as malformed:
+  valid_ = false;
+  BufferReader reader{data_.data(), data_.size(), offset_};
+  const auto kind = reader.readUint8();
+  if (kind > static_cast<uint8_t>(Kind::kDisconnect)) return false;
+
+  const auto ticks = reader.readVarint();
+  const auto client = reader.readVarint();
+  if (!reader.valid() || client > UINT32_MAX) return false;
+
+  tick_ += ticks;
+  *entry = {static_cast<Kind>(kind), tick_, static_cast<uint32_t>(client), 0,
+            nullptr, 0};
+
+  switch (entry->kind) {
+    case Kind::kConnect: {
+      const auto room = reader.readVarint();
+      if (!reader.valid() || room >= rooms_) return false;
+      entry->room = static_cast<uint32_t>(room);
+      break;
+    }
+    case Kind::kMessage: {
+      const auto size = reader.readVarint();
+      if (size == 0 ||
+          size > Protocol::kMaximumFrameSize - Protocol::kPrefixSize) {
+        return false;
+      }
+      entry->size = static_cast<size_t>(size);
+      entry->data = reader.take(entry->size);
+      if (!reader.valid()) return false;
+      break;
+    }
+    case Kind::kDisconnect:
+      break;
+  }
+
+  offset_ = reader.offset();
+  valid_ = true;
+  return true;
+}
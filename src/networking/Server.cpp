@@ -2,112 +2,464 @@
 
 #include "networking/Server.h"
 
+#include <SDL_net.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <random>
 #include <thread>
 #include <utility>
 
+#include "utils/Allocations.h"
 #include "utils/DebugAssert.h"
+#include "utils/TickScheduler.h"
+#include "utils/Time.h"
 
-Server::ServerClient::ServerClient(std::weak_ptr<Server> server,
-                                   TCPsocket socket) noexcept
-    : server_(std::move(server)), socket_(socket) {
-  // Get the client's IP and port number
-  const auto remoteIP = SDLNet_TCP_GetPeerAddress(socket_);
-  if (!remoteIP) {
-    printf("SDLNet_TCP_GetPeerAddress: %s\n", SDLNet_GetError());
-    return;
-  }
+Server::ServerClient::ServerClient(uint32_t id, Socket socket,
+                                   uint32_t ipAddress, uint16_t port,
+                                   uint32_t tickRate) noexcept
+    : socket_(std::move(socket)), id_(id) {
+  outgoing_.reserve(kOutgoingMessages);
+  pendingPositions_.fill(kNoPendingPosition);
 
   // Print out the clients IP and port number
-  uint32_t ipAddress;
-  ipAddress = SDL_SwapBE32(remoteIP->host);
   printf("[CLIENT] Received a connection from %d.%d.%d.%d port %hu\n",
          ipAddress >> 24u, (ipAddress >> 16u) & 0xFFu,
-         (ipAddress >> 8u) & 0xFFu, ipAddress & 0xFFu, remoteIP->port);
+         (ipAddress >> 8u) & 0xFFu, ipAddress & 0xFFu, port);
 
-  if (sendIdentify()) {
+  if (sendIdentify(tickRate)) {
     printf("[CLIENT] Accepted a connection from %d.%d.%d.%d port %hu\n",
            ipAddress >> 24u, (ipAddress >> 16u) & 0xFFu,
-           (ipAddress >> 8u) & 0xFFu, ipAddress & 0xFFu, remoteIP->port);
+           (ipAddress >> 8u) & 0xFFu, ipAddress & 0xFFu, port);
 
     status_ = ClientStatus::kRunning;
     pushEvent(
-        {ClientEvent::kConnect, this, new client_event_connect_t{ipAddress}});
+        {ClientEvent::kConnect, this, client_event_connect_t{ipAddress}});
   }
 }
 
+Server::ServerClient::ServerClient(uint32_t id) noexcept
+    : id_(id), replayed_(true) {
+  outgoing_.reserve(kOutgoingMessages);
+  pendingPositions_.fill(kNoPendingPosition);
+
+  // The client was identified when the log was recorded:
+  status_ = ClientStatus::kRunning;
+  pushEvent({ClientEvent::kConnect, this, client_event_connect_t{0}});
+}
+
 Server::ServerClient::~ServerClient() noexcept {
-  SDLNet_TCP_Close(socket_);
   status_ = ClientStatus::kClosed;
 }
 
-void Server::ServerClient::run() noexcept {
-  std::cout << "[CLIENT] Running.\n";
-
-  while (running()) {
-    debug_print("[CLIENT] Waiting message from: %i\n", id());
+bool Server::ServerClient::receive() noexcept {
+  debug_print("[CLIENT] Reading messages from: %u\n", id());
 
-    // Read the buffer from the client
-    uint8_t message[64];
-    int len = SDLNet_TCP_Recv(socket_, message, 64);
+  // Read everything the socket has, a single read may hold several messages
+  // and the last one may be incomplete until the next read:
+  while (true) {
+    size_t size;
+    auto* data = received_.writable(&size);
+    const auto len = socket_.receive(data, size);
+    if (len == Socket::kWouldBlock) break;
     if (len <= 0) {
       if (len == 0)
         std::cout << "[CLIENT] Disconnected.\n";
       else
-        std::cerr << "[CLIENT] TCP Error: " << SDLNet_GetError() << '\n';
-
-      disconnect();
-      break;
+        std::cerr << "[CLIENT] TCP Error: " << Socket::lastError() << '\n';
+      return false;
     }
 
-    // Messages must have at least 5 bytes (event_id {4}, player_id {1}):
-    if (len <= 5) continue;
-
-    // Print the received message
-    debug_print("[CLIENT] Received [%i]: %.*s\n", len, len, message);
-    parseMessage(message);
+    // Print the received data
+    debug_print("[CLIENT] Received [%i]: %.*s\n", len, len, data);
+    received_.commit(static_cast<size_t>(len));
+
+    const auto allocations = Allocations::count();
+    const auto valid = Protocol::drain(
+        received_,
+        [this](const uint8_t* message, size_t size) {
+          parseMessage(message, size);
+        });
+    stats_.allocated(Allocations::count() - allocations);
+
+    if (!valid) {
+      std::cerr << "[CLIENT] Received a malformed message.\n";
+      return false;
+    }
   }
+
+  return true;
 }
 
-void Server::ServerClient::parseMessage(uint8_t* message) noexcept {
+void Server::ServerClient::parseMessage(const uint8_t* message,
+                                        size_t size) noexcept {
   // Validate event number, if it does not match, skip:
-  const auto counter = buffer_->readUInt32(message, 0);
-  if (counter != remoteEvent_) return;
+  BufferReader reader{message, size, Protocol::kCounterOffset};
+  if (reader.readUint32() != remoteEvent_) {
+    stats_.dropped();
+    return;
+  }
 
   // Increase the remote event's number:
   ++remoteEvent_;
 
-  // Read the message type:
-  const auto type =
-      static_cast<IncomingMessageType>(buffer_->readUint8(message, 4));
+  handleMessage(message, size);
+}
+
+void Server::ServerClient::handleMessage(const uint8_t* message,
+                                         size_t size) noexcept {
+  stats_.received(message[Protocol::kTypeOffset], size);
+  if (recorder_) recorder_->message(id_, message, size);
+
+  // A message of an unknown type, or whose size does not match its schema, is
+  // ignored:
+  ClientMessages::dispatch(message, size,
+                           [this](auto type, const auto&... fields) {
+                             handle(type, fields...);
+                           });
+}
+
+void Server::ServerClient::replay(const uint8_t* data, size_t size) noexcept {
+  // The log leaves the prefix out, only the size is read past this point:
+  uint8_t message[Protocol::kMaximumFrameSize];
+  const auto length = Protocol::kPrefixSize + size;
+  if (length > sizeof(message)) return;
+
+  BufferWriter writer{message, sizeof(message), Protocol::kSizeOffset};
+  writer.writeUint16(static_cast<uint16_t>(length));
+  writer.writeUint32(remoteEvent_++);
+  std::memcpy(message + Protocol::kPrefixSize, data, size);
+  handleMessage(message, length);
+}
+
+void Server::ServerClient::handle(UpdatePositionMessage, uint32_t sequence,
+                                  const Vector2<float>& position) noexcept {
+  pushEvent({ClientEvent::kUpdatePosition, this,
+             client_event_player_update_t{sequence, position}});
+}
+
+void Server::ServerClient::handle(BulletShootMessage, float angle,
+                                  uint32_t tick) noexcept {
+  pushEvent({ClientEvent::kBulletShoot, this,
+             client_event_bullet_shoot_t{angle, tick}});
+}
+
+void Server::ServerClient::handle(BindDatagramMessage, uint32_t,
+                                  uint32_t) noexcept {
+  // Handled by Server::bindDatagram before the channel reads it.
+}
+
+void Server::ServerClient::handle(AcknowledgeSnapshotMessage,
+                                  uint32_t tick) noexcept {
+  // Acknowledgements may arrive out of order through UDP, keep the newest:
+  const auto current = acknowledgedSnapshot();
+  if (current == Snapshot::kNoBase || tick > current) {
+    acknowledgedSnapshot_.store(tick, std::memory_order_release);
+  }
+}
+
+void Server::ServerClient::handle(PingMessage, uint32_t sequence) noexcept {
+  pushEvent({ClientEvent::kPing, this, client_event_ping_t{sequence}});
+}
+
+bool Server::ServerClient::sendIdentify(uint32_t tickRate) noexcept {
+  token_ = std::random_device{}();
+  uint8_t message[PlayerIdentifyMessage::kSize];
+  return send(message,
+              PlayerIdentifyMessage::encode(message, id_, token_, tickRate));
+}
+
+void Server::ServerClient::receiveDatagram(const uint8_t* data,
+                                           size_t size) noexcept {
+  std::lock_guard<std::mutex> guard(channel_mutex_);
+  const auto valid = channel_.read(
+      data, size,
+      [this](const uint8_t* message, size_t length) {
+        handleMessage(message, length);
+      });
+  if (!valid) debug_print("[CLIENT] Received a malformed datagram.\n");
+}
+
+// Once the identification is sent, pongs are the only messages that must
+// arrive, and they always fit a reliable frame:
+static_assert(PongMessage::kSize - Protocol::kPrefixSize <=
+                  ReliableChannel::kMaximumPayloadSize,
+              "Every reliable message must fit a reliable frame");
+
+bool Server::ServerClient::queueDatagram(
+    const SharedPayload& payload) noexcept {
+  // The payload starts at the message type:
+  BufferReader reader{payload.data(), payload.size()};
+  const auto type = static_cast<ServerMessage>(reader.readUint8());
+
+  // Positions and snapshots are superseded by the next one, so they can be
+  // lost, but any other message must arrive in order, so it never goes through
+  // TCP once the client is bound:
+  std::lock_guard<std::mutex> guard(channel_mutex_);
   switch (type) {
-    case IncomingMessageType::kUpdatePosition: {
-      Vector2<float> position{buffer_->readFloat(message, 5),
-                              buffer_->readFloat(message, 5 + sizeof(float))};
-      pushEvent({ClientEvent::kUpdatePosition, this,
-                 new client_event_player_update_t{position}});
-      position_ = position;
+    case ServerMessage::kPlayerUpdatePosition:
+      return channel_.sendUnreliable(Handle::slot(reader.readUint32()),
+                                     payload.data(), payload.size());
+    case ServerMessage::kWorldSnapshot:
+      // Keyed by part, past the keys of the positions:
+      reader.skip(Snapshot::kPartOffset);
+      return channel_.sendUnreliable(kSnapshotKey + reader.readUint8(),
+                                     payload.data(), payload.size());
+    default:
       break;
+  }
+
+  // It waits behind the reliable window when that is full, unless the client
+  // left so many frames unacknowledged that it is no longer reachable:
+  if (!channel_.sendReliable(payload.data(), payload.size())) {
+    std::cerr << "[CLIENT] Disconnecting client " << id_
+              << ", it stopped acknowledging datagrams.\n";
+    disconnect();
+  }
+  return true;
+}
+
+void Server::ServerClient::flushDatagrams(
+    const Socket& socket, LinkConditioner& conditioner) noexcept {
+  if (!datagram_.load(std::memory_order_acquire)) return;
+
+  uint8_t datagram[ReliableChannel::kMaximumDatagramSize];
+  std::lock_guard<std::mutex> guard(channel_mutex_);
+  while (const auto size = channel_.write(datagram)) {
+    conditioner.send(socket, datagram, size, datagramAddress_, datagramPort_);
+  }
+}
+
+const Server::world_snapshot_t* Server::ServerClient::findView(
+    uint32_t tick, uint32_t now) const noexcept {
+  if (tick == Snapshot::kNoBase || now - tick >= views_.size()) return nullptr;
+
+  const auto& view = views_[tick % views_.size()];
+  return view.tick == tick ? &view : nullptr;
+}
+
+NetworkStats::summary_t Server::ServerClient::stats() noexcept {
+  std::lock_guard<std::mutex> guard(channel_mutex_);
+  return stats_.summary(channel_.reliableSent(), channel_.resent(),
+                        events_.size(),
+                        outgoing_.size() + channel_.pendingReliable());
+}
+
+void Server::ServerClient::queue(const SharedPayload& payload) noexcept {
+  if (datagram_.load(std::memory_order_acquire) && queueDatagram(payload)) {
+    // The payload starts at the message type:
+    stats_.sent(payload.data()[0], Protocol::kPrefixSize + payload.size());
+    return;
+  }
+
+  // The payload starts at the message type:
+  BufferReader reader{payload.data(), payload.size()};
+  if (static_cast<ServerMessage>(reader.readUint8()) ==
+      ServerMessage::kPlayerUpdatePosition) {
+    auto& pending = pendingPositions_[Handle::slot(reader.readUint32())];
+
+    // Swap the payload of the queued message, unless it is already partially
+    // written to the socket:
+    if (pending != kNoPendingPosition && (pending != 0 || written_ == 0)) {
+      outgoing_[pending].payload = payload;
+      return;
+    }
+
+    pending = outgoing_.size();
+  }
+
+  outgoing_.push_back({{}, payload});
+}
+
+size_t Server::ServerClient::write() noexcept {
+  // A replayed client has nobody to send to, everything counts as written:
+  if (replayed_) {
+    for (const auto& message : outgoing_) {
+      stats_.sent(message.payload.data()[0],
+                  message.prefix.size() + message.payload.size());
+    }
+    event_ += static_cast<uint32_t>(outgoing_.size());
+    return outgoing_.size();
+  }
+
+  socket_buffer_t buffers[Socket::kMaximumBuffers];
+  size_t sent = 0;
+  while (sent != outgoing_.size()) {
+    size_t count = 0;
+    size_t size = 0;
+    auto counter = event_;
+    for (auto i = sent;
+         i < outgoing_.size() && count + 2 <= Socket::kMaximumBuffers; ++i) {
+      auto& message = outgoing_[i];
+      const auto skip = i == sent ? written_ : 0;
+
+      // The counter is only final once the message starts being written, the
+      // messages that were not are renumbered by the next call:
+      if (skip == 0) {
+        BufferWriter writer{message.prefix.data(), message.prefix.size(),
+                            Protocol::kSizeOffset};
+        writer.writeUint16(static_cast<uint16_t>(message.prefix.size() +
+                                                 message.payload.size()));
+        writer.writeUint32(counter++);
+      }
+
+      const auto prefix = message.prefix.size();
+      if (skip < prefix) {
+        buffers[count++] =
+            Socket::buffer(message.prefix.data() + skip, prefix - skip);
+      }
+
+      const auto payload = skip > prefix ? skip - prefix : 0;
+      buffers[count++] = Socket::buffer(message.payload.data() + payload,
+                                        message.payload.size() - payload);
+      size += prefix + message.payload.size() - skip;
     }
-    case IncomingMessageType::kBulletShoot: {
-      const auto angle = buffer_->readFloat(message, 5);
-      pushEvent({ClientEvent::kBulletShoot, this,
-                 new client_event_bullet_shoot_t{angle}});
+
+    const auto result = socket_.send(buffers, count);
+    if (result == Socket::kWouldBlock) break;
+    if (result < 0) {
+      std::cerr << "[CLIENT] TCP Error: " << Socket::lastError() << '\n';
+      disconnect();
       break;
     }
+
+    auto remaining = static_cast<size_t>(result);
+    while (remaining != 0) {
+      const auto& message = outgoing_[sent];
+      if (written_ == 0) ++event_;
+
+      const auto left =
+          message.prefix.size() + message.payload.size() - written_;
+      if (remaining < left) {
+        written_ += remaining;
+        break;
+      }
+
+      remaining -= left;
+      written_ = 0;
+      stats_.sent(message.payload.data()[0],
+                  message.prefix.size() + message.payload.size());
+      ++sent;
+    }
+
+    // The kernel buffer is full, try again in the next tick:
+    if (static_cast<size_t>(result) != size) break;
+  }
+
+  return sent;
+}
+
+void Server::ServerClient::dropUpdates() noexcept {
+  // Keep the first message if it is partially written, as the rest of it must
+  // still follow:
+  const auto start = outgoing_.begin() + (written_ == 0 ? 0 : 1);
+  const auto end = std::remove_if(
+      start, outgoing_.end(), [](const outgoing_message_t& message) {
+        const auto type =
+            static_cast<ServerMessage>(message.payload.data()[0]);
+        return type == ServerMessage::kPlayerUpdatePosition ||
+               type == ServerMessage::kWorldSnapshot;
+      });
+
+  debug_print("[CLIENT] Client %u is too slow, dropped %zu updates.\n", id_,
+              static_cast<size_t>(outgoing_.end() - end));
+  outgoing_.erase(end, outgoing_.end());
+  pendingPositions_.fill(kNoPendingPosition);
+}
+
+bool Server::ServerClient::flush() noexcept {
+  if (!running()) return false;
+  if (outgoing_.empty()) return true;
+
+  // Release the messages that were fully written, which also drops their
+  // payload references so they can be recycled:
+  const auto sent = write();
+  outgoing_.erase(outgoing_.begin(),
+                  outgoing_.begin() + static_cast<std::ptrdiff_t>(sent));
+  for (auto& pending : pendingPositions_) {
+    if (pending == kNoPendingPosition) continue;
+    pending = pending < sent ? kNoPendingPosition : pending - sent;
+  }
+
+  if (!running()) return false;
+  if (outgoing_.size() > kMaximumOutgoingMessages) dropUpdates();
+  if (outgoing_.size() <= kMaximumOutgoingMessages) {
+    overloadedTicks_ = 0;
+    return true;
+  }
+
+  if (++overloadedTicks_ < kMaximumOverloadedTicks &&
+      outgoing_.size() <= kEvictionOutgoingMessages) {
+    return true;
   }
+
+  std::cerr << "[CLIENT] Disconnecting client " << id_
+            << ", it cannot keep up with " << outgoing_.size()
+            << " pending messages.\n";
+  disconnect();
+  return false;
+}
+
+Server::Room::Room(size_t index, const std::string& scene,
+                   const Socket& datagram, uint32_t tickRate)
+    : datagram_(datagram),
+      simulation_(tickRate),
+      snapshotInterval_(std::max(tickRate / kSnapshotRate, 1u)),
+      reportInterval_(tickRate * kReportSeconds),
+      index_(index) {
+  clients_.reserve(kCapacity);
+  simulation_.load(scene);
 }
 
-bool Server::ServerClient::sendIdentify() noexcept {
-  id_ = server_.lock()->nextPlayerID();
-  uint8_t message[6];
-  buffer_->writeUint8(
-      message, static_cast<uint8_t>(OutgoingMessageType::kPlayerIdentify), 4);
-  buffer_->writeUint8(message, id_, 5);
-  return send(message, 6);
+void Server::Room::tick() noexcept {
+  const auto start = Time::now();
+
+  adoptClients();
+  handleEvents();
+  simulation_.step();
+  correctPositions();
+  if (tick_ % snapshotInterval_ == 0) broadcastSnapshot();
+
+  // Everything produced during this pass goes out in one write per client:
+  flush();
+  releaseClients();
+
+  const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Time::now() - start);
+  tickTime_ += elapsed;
+  worstTickTime_ = std::max(worstTickTime_, elapsed);
+  if (++tick_ % reportInterval_ == 0) report();
 }
 
-Server::Server() noexcept {
+void Server::Room::report() noexcept {
+  if (!clients_.empty()) {
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    const auto bytes = snapshotBytes_ / reportInterval_;
+    printf(
+        "[ROOM %zu] %zu client(s), ticks take %.3fms on average and %.3fms at "
+        "worst, snapshots %zu bytes per tick and %zu per client.\n",
+        index_, clients_.size(),
+        milliseconds(tickTime_).count() / reportInterval_,
+        milliseconds(worstTickTime_).count(), bytes, bytes / clients_.size());
+
+    NetworkStats::summary_t traffic{};
+    for (const auto& client : clients_) traffic += client->statsInterval();
+    printf("[ROOM %zu] Network: %s.\n", index_,
+           NetworkStats::describe(traffic, kReportSeconds,
+                                  NetworkStats::Side::kServer)
+               .c_str());
+  }
+
+  tickTime_ = std::chrono::nanoseconds::zero();
+  worstTickTime_ = std::chrono::nanoseconds::zero();
+  snapshotBytes_ = 0;
+}
+
+Server::Server(const std::string& scene, size_t rooms,
+               uint32_t tickRate) noexcept
+    : tickRate_(tickRate == 0 ? Simulation::kDefaultTickRate : tickRate) {
   status_ = ServerStatus::kPending;
 
   if (SDL_Init(0) == -1) {
@@ -115,149 +467,420 @@ Server::Server() noexcept {
     exit(1);
   }
 
+  // SDLNet_Init also initializes Winsock on Windows, which the native sockets
+  // rely on:
   if (SDLNet_Init() == -1) {
     printf("SDLNet_Init: %s\n", SDLNet_GetError());
     exit(2);
   }
 
+  // Every room simulates the scene itself, the clients only report where
+  // they would like to move to and which way they shoot:
+  try {
+    for (size_t i = 0; i < std::max<size_t>(rooms, 1); ++i) {
+      rooms_.emplace_back(
+          std::make_unique<Room>(i, scene, datagram_, tickRate_));
+    }
+  } catch (const std::exception& exception) {
+    std::cerr << exception.what() << '\n';
+    exit(3);
+  }
+
+  // A room is never ticked by two workers, so there is no use for more
+  // workers than rooms:
+  workers_ = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u),
+                              rooms_.size());
+
   std::cout << "Starting server... ";
 
-  IPaddress ip;
-  if (SDLNet_ResolveHost(&ip, nullptr, 9999) == -1) {
-    std::cerr << "SDLNet_ResolveHost: " << SDLNet_GetError() << '\n';
+  server_ = Socket::listen(9999);
+  if (!server_.valid()) {
+    std::cerr << "Socket::listen: " << Socket::lastError() << '\n';
     exit(1);
   }
 
-  server_ = SDLNet_TCP_Open(&ip);
-  if (!server_) {
-    std::cerr << "SDLNet_TCP_Open: " << SDLNet_GetError() << '\n';
+  // Positions and events travel through UDP once a client binds its address,
+  // the server works through TCP alone if it cannot listen for datagrams:
+  datagram_ = Socket::datagram(9999);
+  if (!datagram_.valid()) {
+    std::cerr << "Socket::datagram: " << Socket::lastError() << '\n';
+  }
+
+  // The listening socket is not watched, connections are accepted on the tick
+  // schedule instead:
+  if (!poller_.valid() ||
+      (datagram_.valid() && !poller_.add(datagram_, &datagram_))) {
+    std::cerr << "Poller::add: " << Socket::lastError() << '\n';
     exit(2);
   }
 
   std::cout << "\033[0;32mReady!\033[0m\n";
+  printf("[SERVER] Hosting %zu room(s) of %zu on %zu worker(s) at %u Hz.\n",
+         rooms_.size(), Room::kCapacity, workers_, tickRate_);
+
+  if (const auto* path = std::getenv("OBSTACLE_RUN_RECORD")) {
+    recorder_ = std::make_unique<Replay::Recorder>(
+        path, tickRate_, static_cast<uint32_t>(rooms_.size()));
+    if (!recorder_->valid()) recorder_.reset();
+  }
 }
 
 Server::~Server() noexcept {
-  SDLNet_TCP_Close(server_);
+  rooms_.clear();
+  server_.close();
+  datagram_.close();
   status_ = ServerStatus::kClosed;
 
   SDL_Quit();
   SDLNet_Quit();
 }
 
-void Server::handleEvents() noexcept {
-  if (clients_.empty()) return;
-
-  client_event_t event{};
-  size_t i = clients_.size();
-  while (i != 0) {
-    auto& client = clients_[--i];
-    while (client->readEvent(&event)) {
+void Server::Room::handleEvents() noexcept {
+  for (auto& client : clients_) {
+    const auto count = client->readEvents(events_.data(), events_.size());
+    for (size_t j = 0; j < count; ++j) {
+      const auto& event = events_[j];
       if (event.event == ClientEvent::kDisconnect) {
-        constexpr const auto size = 6;
-        uint8_t message[size];
-        buffer_->writeUint8(
-            message,
-            static_cast<uint8_t>(OutgoingMessageType::kPlayerDisconnect), 4);
-        buffer_->writeUint8(message, client->id(), 5);
-        broadcastExcept(message, 6, client->id());
-
-        clients_.erase(clients_.begin() + i);
+        debug_print(
+            "[SERVER] Client %u left, event queue high-water mark: %zu\n",
+            client->id(), client->eventQueueHighWaterMark());
+
+        simulation_.removePlayer(client->id());
+        client->leave();
         break;
       }
 
       if (event.event == ClientEvent::kConnect) {
-        {
-          constexpr const auto size = 6;
-          uint8_t message[size];
-          buffer_->writeUint8(
-              message,
-              static_cast<uint8_t>(OutgoingMessageType::kPlayerConnect), 4);
-          buffer_->writeUint8(message, client->id(), 5);
-          broadcastExcept(message, size, client->id());
-        }
-
-        for (const auto& c : clients_) {
-          // Do not send the same ID twice
-          if (c->id() == client->id()) continue;
-
-          constexpr const auto size = 6 + sizeof(float) * 2;
-          uint8_t message[size];
-          buffer_->writeUint8(
-              message,
-              static_cast<uint8_t>(OutgoingMessageType::kPlayerInsertPosition),
-              4);
-          buffer_->writeUint8(message, c->id(), 5);
-          buffer_->writeFloat(message, c->position().x(), 6);
-          buffer_->writeFloat(message, c->position().y(), 6 + sizeof(float));
-          client->send(message, size);
-        }
+        // The other players learn about it, and it about them, through the
+        // snapshots once they are in each other's area of interest:
+        simulation_.addPlayer(client->id());
       } else if (event.event == ClientEvent::kUpdatePosition) {
-        constexpr const auto size = 6 + sizeof(float) * 2;
-        const auto* data =
-            reinterpret_cast<client_event_player_update_t*>(event.data);
-        uint8_t message[size];
-        buffer_->writeUint8(
-            message,
-            static_cast<uint8_t>(OutgoingMessageType::kPlayerUpdatePosition),
-            4);
-        buffer_->writeUint8(message, client->id(), 5);
-        buffer_->writeFloat(message, data->position_.x(), 6);
-        buffer_->writeFloat(message, data->position_.y(), 6 + sizeof(float));
-        broadcastExcept(message, size, client->id());
+        const auto& data = std::get<client_event_player_update_t>(event.data);
+        simulation_.movePlayer(client->id(), data.position_);
+        client->sequence(data.sequence_);
       } else if (event.event == ClientEvent::kBulletShoot) {
-        constexpr const auto size = 5 + sizeof(float) * 2 + sizeof(double) * 2;
-        const auto& data =
-            *reinterpret_cast<client_event_bullet_shoot_t*>(event.data);
-
-        const auto& sp = Vector2{50.f, 50.f} / 2.f;
-        const auto& pp = event.client->position();
-
-        const auto start =
-            Vector2<float>(pp.x() - (sp.x() * cos(data.angle_) * 2.f),
-                           pp.y() - (sp.y() * sin(data.angle_) * 2.f));
-        const auto velocity = Vector2<double>{-cos(data.angle_) * 5000000000.0,
-                                              -sin(data.angle_) * 5000000000.0};
-
-        uint8_t message[size];
-        buffer_->writeUint8(
-            message, static_cast<uint8_t>(OutgoingMessageType::kBulletShoot),
-            4);
-        buffer_->writeFloat(message, start.x(), 5);
-        buffer_->writeFloat(message, start.y(), 5 + sizeof(float));
-        buffer_->writeDouble(message, velocity.x(), 5 + sizeof(float) * 2);
-        buffer_->writeDouble(message, velocity.y(),
-                             5 + sizeof(float) * 2 + sizeof(double));
-        broadcast(message, size);
+        const auto& data = std::get<client_event_bullet_shoot_t>(event.data);
+        simulation_.shoot(client->id(), data.angle_, data.tick_);
+      } else if (event.event == ClientEvent::kPing) {
+        // Answered from the tick rather than the network thread, so the round
+        // trip includes the time the event waited for it:
+        const auto& data = std::get<client_event_ping_t>(event.data);
+        uint8_t message[PongMessage::kSize];
+        client->queue(
+            share(message, PongMessage::encode(message, data.sequence_)));
       }
     }
   }
 }
 
-void Server::run() noexcept {
-  const constexpr static uint32_t gameFrameRate = 60U;
-  const constexpr static auto frameTime =
-      static_cast<uint32_t>(1000 / gameFrameRate);
+void Server::Room::adoptClients() noexcept {
+  std::unique_ptr<ServerClient> client;
+  while (inbox_.pop(&client)) clients_.emplace_back(std::move(client));
+}
 
-  std::cout << "[SERVER] Running.\n";
-  status_ = ServerStatus::kRunning;
+void Server::Room::releaseClients() noexcept {
+  // Nothing references a client that left past the end of the tick, so it can
+  // be swapped with the last one and destroyed:
+  size_t i = 0;
+  while (i != clients_.size()) {
+    if (!clients_[i]->left()) {
+      ++i;
+      continue;
+    }
 
-  while (running()) {
-    handleEvents();
+    const auto id = clients_[i]->id();
+    clients_[i] = std::move(clients_.back());
+    clients_.pop_back();
+    released_.push(id);
+  }
+}
+
+void Server::Room::correctPositions() noexcept {
+  uint8_t message[PlayerUpdatePositionMessage::kSize];
+  for (const auto& client : clients_) {
+    const auto id = client->id();
+    if (!simulation_.active(id) || !simulation_.diverged(id)) continue;
+
+    // The client replays the movement it predicted since the last position
+    // the server applied:
+    const auto size = PlayerUpdatePositionMessage::encode(
+        message, id, client->sequence(), simulation_.position(id));
+    client->queue(share(message, size));
+  }
+}
+
+void Server::Room::gatherView(const ServerClient& client,
+                              const world_snapshot_t* previous,
+                              Snapshot::entities_t* view) noexcept {
+  const auto center = simulation_.position(client.id());
+  const Vector2<float> extent{kInterestWidth, kInterestHeight};
+  grid_.query(center,
+              {kInterestWidth + kInterestMargin,
+               kInterestHeight + kInterestMargin},
+              &visible_);
+
+  // Both the candidates and the previous view are sorted by key, so they are
+  // walked together:
+  view->clear();
+  Snapshot::entities_t::const_iterator sent{};
+  Snapshot::entities_t::const_iterator end{};
+  if (previous) {
+    sent = previous->entities.begin();
+    end = previous->entities.end();
+  }
+
+  for (const auto index : visible_) {
+    const auto& entity = world_[index];
+    while (sent != end && sent->key < entity.key) ++sent;
+    if ((sent != end && sent->key == entity.key) ||
+        InterestGrid::contains(center, extent, entity.position)) {
+      view->push_back(entity);
+    }
+  }
+}
+
+void Server::Room::broadcastSnapshot() noexcept {
+  simulation_.capture(&world_);
+  grid_.build(world_);
+
+  uint8_t message[Protocol::kMaximumFrameSize];
+  for (auto& client : clients_) {
+    if (!simulation_.active(client->id())) continue;
+
+    // Each client is sent the entities around its player, an entity entering
+    // its area of interest is an insertion and one leaving it a removal:
+    const auto acknowledged = client->acknowledgedSnapshot();
+    const auto* base = client->findView(acknowledged, tick_);
+    auto& current = client->view(tick_);
+    gatherView(*client, client->findView(tick_ - snapshotInterval_, tick_),
+               &current.entities);
+    current.tick = tick_;
+
+    snapshotEntries_.clear();
+    Snapshot::encode(base ? &base->entities : nullptr, current.entities,
+                     &snapshotEntries_);
+
+    // Nothing changed since the acknowledged snapshot, skip it unless the
+    // client needs a newer base before this one is forgotten:
+    if (base && snapshotEntries_.empty() &&
+        tick_ - acknowledged < Snapshot::kHistorySize / 2) {
+      continue;
+    }
 
-    // Try to accept a connection
-    auto* client = SDLNet_TCP_Accept(server_);
+    // Split the entries in parts that fit a frame, never cutting an entry:
+    std::array<size_t, Snapshot::kMaximumParts + 1> parts{};
+    size_t count = 0;
+    size_t end = 0;
+    while (count < Snapshot::kMaximumParts &&
+           (count == 0 || end != snapshotEntries_.size())) {
+      const auto start = end;
+      while (end != snapshotEntries_.size()) {
+        const auto length = Snapshot::entrySize(snapshotEntries_.data() + end);
+        if (end + length - start > Snapshot::kMaximumPartSize) break;
+        end += length;
+      }
+      parts[++count] = end;
+    }
 
-    // No connection accepted
-    if (!client) {
-      SDL_Delay(frameTime);
+    if (end != snapshotEntries_.size()) {
+      debug_print("[SERVER] The snapshot for %u does not fit %zu parts.\n",
+                  client->id(), Snapshot::kMaximumParts);
       continue;
     }
 
-    std::thread([&, client]() {
-      auto sc = new ServerClient(shared_from_this(), client);
-      clients_.emplace_back(sc);
-      sc->run();
-    }).detach();
+    for (size_t part = 0; part < count; ++part) {
+      const auto size = WorldSnapshotMessage::encode(
+          message, tick_, base ? acknowledged : Snapshot::kNoBase,
+          static_cast<uint8_t>(part), static_cast<uint8_t>(count),
+          {snapshotEntries_.data() + parts[part],
+           parts[part + 1] - parts[part]});
+      client->queue(share(message, size));
+      snapshotBytes_ += size;
+    }
   }
+
+}
+
+void Server::accept() noexcept {
+  // Connections still waiting are accepted on the next tick, after the
+  // sockets that are ready meanwhile, so a connection storm cannot starve
+  // the disconnections that free the handles it needs:
+  reclaimHandles();
+  uint32_t ipAddress;
+  uint16_t port;
+  for (size_t i = 0; i < kMaximumAccepts; ++i) {
+    auto socket = server_.accept(&ipAddress, &port);
+    if (!socket.valid()) return;
+
+    const auto id = connections_.next();
+    if (id == Handle::kInvalid) {
+      std::cerr << "[SERVER] Rejected a connection, the server is full.\n";
+      continue;
+    }
+
+    auto* room = assignRoom();
+    if (!room) {
+      std::cerr << "[SERVER] Rejected a connection, every room is full.\n";
+      continue;
+    }
+
+    auto client =
+        std::make_unique<ServerClient>(id, std::move(socket), ipAddress, port,
+                                       tickRate_);
+    if (!client->running()) continue;
+
+    if (!poller_.add(client->socket(), client.get())) {
+      std::cerr << "Poller::add: " << Socket::lastError() << '\n';
+      continue;
+    }
+
+    debug_print("[SERVER] Client %u joined room %zu.\n", id, room->index());
+    connections_.insert(client.get());
+    if (recorder_) {
+      recorder_->connect(id, static_cast<uint32_t>(room->index()));
+      client->record(recorder_.get());
+    }
+    room->admit(std::move(client));
+  }
+}
+
+Server::Room* Server::assignRoom() noexcept {
+  for (auto& room : rooms_) {
+    if (!room->full()) return room.get();
+  }
+
+  return nullptr;
+}
+
+void Server::receiveDatagrams() noexcept {
+  uint8_t datagram[ReliableChannel::kMaximumDatagramSize];
+  uint32_t ipAddress;
+  uint16_t port;
+  while (true) {
+    const auto size =
+        datagram_.receiveFrom(datagram, sizeof(datagram), &ipAddress, &port);
+    if (size < 0) return;
+
+    const auto it = addresses_.find(addressKey(ipAddress, port));
+    auto* client = it == addresses_.end()
+                       ? bindDatagram(datagram, static_cast<size_t>(size),
+                                      ipAddress, port)
+                       : it->second;
+    if (client) client->receiveDatagram(datagram, static_cast<size_t>(size));
+  }
+}
+
+Server::ServerClient* Server::bindDatagram(const uint8_t* datagram,
+                                           size_t size, uint32_t ipAddress,
+                                           uint16_t port) noexcept {
+  // The first frame from an unknown address must be the bind request, which
+  // repeats the ID and token the client received through TCP:
+  BufferReader reader{datagram, size,
+                      ReliableChannel::kHeaderSize + Protocol::kSizeOffset};
+  const size_t length = reader.readUint16();
+  if (!reader.valid() || length > size - ReliableChannel::kHeaderSize) {
+    return nullptr;
+  }
+
+  BindDatagramMessage::values_t values;
+  if (!BindDatagramMessage::decode(datagram + ReliableChannel::kHeaderSize,
+                                   length, &values)) {
+    return nullptr;
+  }
+
+  const auto [id, token] = values;
+
+  // A stale handle finds nobody, as its slot has a new generation:
+  const auto* connection = connections_.find(id);
+  auto* client = connection ? *connection : nullptr;
+  if (!client || client->token() != token) return nullptr;
+
+  debug_print("[SERVER] Client %u bound its datagram address.\n", client->id());
+  if (client->datagramBound()) {
+    addresses_.erase(
+        addressKey(client->datagramAddress(), client->datagramPort()));
+  }
+
+  client->bindDatagram(ipAddress, port);
+  addresses_[addressKey(ipAddress, port)] = client;
+  return client;
+}
+
+void Server::listen() noexcept {
+  const constexpr static size_t maximumEvents = 256U;
+
+  std::cout << "[SERVER] Listening.\n";
+
+  // The sockets are read as soon as they are ready, but only waited on until
+  // the next tick is due:
+  TickScheduler scheduler{tickRate_};
+  poller_event_t events[maximumEvents];
+  while (running()) {
+    const auto timeout = std::chrono::ceil<std::chrono::milliseconds>(
+        scheduler.remaining());
+    const auto count = poller_.wait(events, maximumEvents,
+                                    static_cast<int32_t>(timeout.count()));
+    for (size_t i = 0; i < count; ++i) {
+      const auto& event = events[i];
+      if (event.data == &datagram_) {
+        receiveDatagrams();
+        continue;
+      }
+
+      auto* client = static_cast<ServerClient*>(event.data);
+      const auto open = event.readable ? client->receive() : !event.closed;
+      if (open) continue;
+
+      // The client is released by its room once it handles the
+      // disconnection, so it must not be referenced from here after close():
+      poller_.remove(client->socket());
+      *connections_.find(client->id()) = nullptr;
+      if (client->datagramBound()) {
+        addresses_.erase(
+            addressKey(client->datagramAddress(), client->datagramPort()));
+      }
+
+      if (recorder_) recorder_->disconnect(client->id());
+      client->close();
+    }
+
+    if (scheduler.poll()) {
+      if (recorder_) recorder_->tick(scheduler.ticks());
+      accept();
+    }
+  }
+}
+
+void Server::work(size_t worker) noexcept {
+  const auto reportInterval = tickRate_ * kReportSeconds;
+  TickScheduler scheduler{tickRate_};
+  uint64_t overruns = 0;
+  while (running()) {
+    scheduler.wait();
+    for (auto i = worker; i < rooms_.size(); i += workers_) rooms_[i]->tick();
+
+    if (scheduler.ticks() % reportInterval == 0 &&
+        scheduler.overruns() != overruns) {
+      printf("[WORKER %zu] %llu of the last %u ticks started late.\n", worker,
+             static_cast<unsigned long long>(scheduler.overruns() - overruns),
+             reportInterval);
+      overruns = scheduler.overruns();
+    }
+  }
+}
+
+void Server::run() noexcept {
+  std::cout << "[SERVER] Running.\n";
+  status_ = ServerStatus::kRunning;
+
+  // The workers handle the events of their rooms on every tick, while this
+  // thread multiplexes every socket:
+  std::vector<std::thread> workers;
+  workers.reserve(workers_);
+  for (size_t i = 0; i < workers_; ++i) {
+    workers.emplace_back([this, i]() { work(i); });
+  }
+
+  listen();
+  for (auto& worker : workers) worker.join();
 }
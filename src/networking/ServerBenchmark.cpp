@@ -0,0 +1,198 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include <SDL_net.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "networking/Server.h"
+#include "utils/Time.h"
+
+void Server::benchmark(const std::string& scene, uint32_t seconds) noexcept {
+  constexpr uint32_t loopback = 0x7F000001u;
+
+  // How far from its player a bot reports it moved to, and how often it
+  // shoots, staggered so the bullets of a room are spread over the ticks:
+  constexpr float wanderDistance = 64.f;
+  constexpr uint32_t shootInterval = Simulation::kDefaultTickRate;
+
+  // How far behind the room the bots see the world when they shoot, the
+  // interpolation delay of a client, so every shot is rewound:
+  constexpr uint32_t viewDelay = Simulation::kDefaultTickRate / 10;
+
+  struct bot_t {
+    Socket socket;
+    ServerClient* client;
+    uint32_t counter;
+  };
+
+  struct shard_t {
+    std::unique_ptr<Room> room;
+    std::vector<bot_t> bots{};
+    std::atomic<uint64_t> ticks{0};
+  };
+
+  // SDLNet_Init also initializes Winsock on Windows:
+  if (SDLNet_Init() == -1) {
+    printf("SDLNet_Init: %s\n", SDLNet_GetError());
+    exit(2);
+  }
+
+  // The bots only talk through TCP, so the rooms never send a datagram:
+  const Socket datagram{};
+  const auto listener = Socket::listen(0);
+  if (!listener.valid()) {
+    std::cerr << "Socket::listen: " << Socket::lastError() << '\n';
+    exit(1);
+  }
+
+  const auto cores = std::max(std::thread::hardware_concurrency(), 1u);
+  std::vector<size_t> counts;
+  for (size_t workers = 1; workers < cores; workers *= 2) {
+    counts.push_back(workers);
+  }
+  counts.push_back(cores);
+
+  printf(
+      "[BENCHMARK] Ticking rooms of %zu players as fast as possible, for %u "
+      "second(s) per amount of workers, on %u core(s).\n",
+      Room::kCapacity, seconds, cores);
+
+  double baseline = 0.0;
+  for (const auto workers : counts) {
+    std::vector<std::unique_ptr<shard_t>> shards;
+    try {
+      for (size_t i = 0; i < workers; ++i) {
+        auto shard = std::make_unique<shard_t>();
+        shard->room = std::make_unique<Room>(i, scene, datagram,
+                                             Simulation::kDefaultTickRate);
+        shards.push_back(std::move(shard));
+      }
+    } catch (const std::exception& exception) {
+      std::cerr << exception.what() << '\n';
+      exit(3);
+    }
+
+    for (auto& shard : shards) {
+      for (size_t i = 0; i < Room::kCapacity; ++i) {
+        auto socket = Socket::connect(loopback, listener.localPort());
+        if (!socket.valid()) {
+          std::cerr << "Socket::connect: " << Socket::lastError() << '\n';
+          return;
+        }
+
+        // The connection is established, so it is already waiting to be
+        // accepted:
+        uint32_t ipAddress;
+        uint16_t port;
+        auto accepted = listener.accept(&ipAddress, &port);
+        while (!accepted.valid()) {
+          std::this_thread::yield();
+          accepted = listener.accept(&ipAddress, &port);
+        }
+
+        auto client = std::make_unique<ServerClient>(
+            Handle::make(static_cast<uint16_t>(i), 1), std::move(accepted),
+            ipAddress, port, Simulation::kDefaultTickRate);
+        shard->bots.push_back({std::move(socket), client.get(), 0});
+        shard->room->admit(std::move(client));
+      }
+    }
+
+    // Each worker plays the network thread and the bots of its own room as
+    // well, so it does not wait on anything another worker does:
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    threads.reserve(shards.size());
+    for (auto& shard : shards) {
+      threads.emplace_back([&stop, &shard = *shard]() {
+        std::mt19937 random{std::random_device{}()};
+        std::uniform_real_distribution<float> step{-wanderDistance,
+                                                   wanderDistance};
+        std::uniform_real_distribution<float> aim{-3.14159265f, 3.14159265f};
+        Buffer writer{};
+        uint8_t message[UpdatePositionMessage::kSize];
+        uint8_t sink[Protocol::kReceiveBufferSize];
+        uint64_t tick = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+          const auto& simulation = shard.room->simulation();
+          for (size_t i = 0; i < shard.bots.size(); ++i) {
+            auto& bot = shard.bots[i];
+
+            // A client the room disconnected is never released here, as no
+            // network thread reports it closed, so it stays valid:
+            if (!bot.client->running()) continue;
+
+            const auto id = bot.client->id();
+            if (simulation.active(id)) {
+              const auto size =
+                  (tick + i) % shootInterval == 0
+                      ? BulletShootMessage::encode(
+                            message, aim(random),
+                            static_cast<uint32_t>(tick) - viewDelay)
+                      : UpdatePositionMessage::encode(
+                            message, bot.counter,
+                            simulation.position(id) +
+                                Vector2<float>{step(random), step(random)});
+              writer.writeUint16(message, static_cast<uint16_t>(size),
+                                 Protocol::kSizeOffset);
+              writer.writeUint32(message, bot.counter,
+                                 Protocol::kCounterOffset);
+              if (bot.socket.send(message, size) ==
+                  static_cast<int32_t>(size)) {
+                ++bot.counter;
+              }
+            }
+
+            static_cast<void>(bot.client->receive());
+          }
+
+          shard.room->tick();
+          shard.ticks.fetch_add(1, std::memory_order_relaxed);
+          ++tick;
+
+          for (auto& bot : shard.bots) {
+            while (bot.socket.receive(sink, sizeof(sink)) > 0) continue;
+          }
+        }
+      });
+    }
+
+    const auto ticks = [&shards]() {
+      uint64_t total = 0;
+      for (const auto& shard : shards) {
+        total += shard->ticks.load(std::memory_order_relaxed);
+      }
+      return total;
+    };
+
+    // Let the players spawn and spread out before measuring:
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    const auto start = Time::now();
+    const auto before = ticks();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    const auto after = ticks();
+    const std::chrono::duration<double> elapsed = Time::now() - start;
+
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& thread : threads) thread.join();
+
+    const auto throughput =
+        static_cast<double>(after - before) / elapsed.count();
+    if (workers == 1) baseline = throughput;
+    printf(
+        "[BENCHMARK] %zu worker(s): %.0f ticks per second, %.0f per room, "
+        "%.2fx the throughput of one worker, %.0f%% efficiency.\n",
+        workers, throughput, throughput / static_cast<double>(workers),
+        throughput / baseline,
+        throughput / baseline / static_cast<double>(workers) * 100.0);
+  }
+
+  SDLNet_Quit();
+}
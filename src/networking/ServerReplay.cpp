@@ -0,0 +1,125 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "networking/Server.h"
+#include "utils/Time.h"
+
+void Server::replay(const std::string& scene,
+                    const std::string& path) noexcept {
+  Replay::Reader reader{path};
+  if (!reader.valid()) {
+    std::cerr << "[REPLAY] Could not read a log from '" << path << "'.\n";
+    return;
+  }
+
+  // The rooms never send a datagram, as the replayed clients never bind one:
+  const Socket datagram{};
+  std::vector<std::unique_ptr<Room>> rooms;
+  try {
+    for (uint32_t i = 0; i < reader.rooms(); ++i) {
+      rooms.emplace_back(
+          std::make_unique<Room>(i, scene, datagram, reader.tickRate()));
+    }
+  } catch (const std::exception& exception) {
+    std::cerr << exception.what() << '\n';
+    return;
+  }
+
+  printf("[REPLAY] Replaying %zu bytes through %u room(s) at %u Hz.\n",
+         reader.size(), reader.rooms(), reader.tickRate());
+
+  // The clients are owned by their rooms, which release them once they
+  // handled their disconnection:
+  std::unordered_map<uint32_t, ServerClient*> clients;
+  std::vector<ServerClient*> closing;
+  std::vector<ServerClient*> deferred;
+  uint64_t messages = 0;
+  uint64_t tick = 0;
+
+  const auto start = Time::now();
+  Replay::entry_t entry{};
+  auto pending = reader.next(&entry);
+  while (pending || !clients.empty()) {
+    // A client whose events fill its queue would wait forever for its room to
+    // make room for the disconnection, so it leaves on the next tick instead:
+    deferred.clear();
+    for (auto* client : closing) {
+      if (client->pendingEvents() == ServerClient::kEventQueueSize) {
+        deferred.push_back(client);
+      } else {
+        client->close();
+      }
+    }
+    closing.swap(deferred);
+
+    for (; pending && entry.tick <= tick; pending = reader.next(&entry)) {
+      switch (entry.kind) {
+        case Replay::Kind::kConnect: {
+          auto client = std::make_unique<ServerClient>(entry.client);
+          clients[entry.client] = client.get();
+          rooms[entry.room]->admit(std::move(client));
+          break;
+        }
+        case Replay::Kind::kMessage: {
+          const auto it = clients.find(entry.client);
+          if (it == clients.end()) break;
+          it->second->replay(entry.data, entry.size);
+          ++messages;
+          break;
+        }
+        case Replay::Kind::kDisconnect: {
+          const auto it = clients.find(entry.client);
+          if (it == clients.end()) break;
+          closing.push_back(it->second);
+          clients.erase(it);
+          break;
+        }
+      }
+    }
+
+    // Once the log ends, the clients still connected leave as the server
+    // closed:
+    if (!pending) {
+      for (const auto& [id, client] : clients) closing.push_back(client);
+      clients.clear();
+    }
+
+    uint32_t id;
+    for (auto& room : rooms) {
+      room->tick();
+      while (room->reclaim(&id)) continue;
+    }
+    ++tick;
+  }
+
+  // Let the rooms handle the last disconnections:
+  while (!closing.empty()) {
+    for (auto* client : closing) client->close();
+    closing.clear();
+
+    uint32_t id;
+    for (auto& room : rooms) {
+      room->tick();
+      while (room->reclaim(&id)) continue;
+    }
+    ++tick;
+  }
+
+  const std::chrono::duration<double> elapsed = Time::now() - start;
+  if (!reader.valid()) {
+    std::cerr << "[REPLAY] The log is malformed past the last entry played.\n";
+  }
+
+  printf(
+      "[REPLAY] Replayed %llu tick(s) and %llu message(s) in %.3fs, %.0f "
+      "ticks per second, %.1fx real time.\n",
+      static_cast<unsigned long long>(tick),
+      static_cast<unsigned long long>(messages), elapsed.count(),
+      static_cast<double>(tick) / elapsed.count(),
+      static_cast<double>(tick) / reader.tickRate() / elapsed.count());
+}
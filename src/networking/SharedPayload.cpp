@@ -0,0 +1,62 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/SharedPayload.h"
+
+#include <cstring>
+#include <utility>
+
+thread_local std::vector<std::unique_ptr<SharedPayload::block_t>>
+    SharedPayload::free_{};
+
+SharedPayload::SharedPayload(block_t* block) noexcept : block_(block) {}
+
+SharedPayload::SharedPayload(const SharedPayload& other) noexcept
+    : block_(other.block_) {
+  if (block_) ++block_->references;
+}
+
+SharedPayload::SharedPayload(SharedPayload&& other) noexcept
+    : block_(std::exchange(other.block_, nullptr)) {}
+
+SharedPayload::~SharedPayload() noexcept { release(); }
+
+SharedPayload& SharedPayload::operator=(const SharedPayload& other) noexcept {
+  if (block_ != other.block_) {
+    release();
+    block_ = other.block_;
+    if (block_) ++block_->references;
+  }
+
+  return *this;
+}
+
+SharedPayload& SharedPayload::operator=(SharedPayload&& other) noexcept {
+  if (this != &other) {
+    release();
+    block_ = std::exchange(other.block_, nullptr);
+  }
+
+  return *this;
+}
+
+SharedPayload SharedPayload::create(const uint8_t* data,
+                                    size_t size) noexcept {
+  std::unique_ptr<block_t> block;
+  if (free_.empty()) {
+    block = std::make_unique<block_t>();
+  } else {
+    block = std::move(free_.back());
+    free_.pop_back();
+  }
+
+  std::memcpy(block->data.data(), data, size);
+  block->size = size;
+  block->references = 1;
+  return SharedPayload{block.release()};
+}
+
+void SharedPayload::release() noexcept {
+  if (!block_) return;
+  if (--block_->references == 0) free_.emplace_back(block_);
+  block_ = nullptr;
+}
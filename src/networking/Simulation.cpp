@@ -0,0 +1,393 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/Simulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "components/PhysicsBody.h"
+#include "exceptions/FileSystemException.h"
+#include "utils/DebugAssert.h"
+
+namespace {
+// A bullet is shot with a force that saturates the translation Box2D allows
+// per step, so until it bounces it flies exactly this far every tick:
+constexpr float kBulletStep = b2_maxTranslation;
+constexpr float kBulletSize = 8.f;
+constexpr float kBulletLifetime = 2.f;
+
+/**
+ * \brief Finds the first wall along a ray, which stops a rewound shot.
+ */
+class WallRayCast final : public b2RayCastCallback {
+ public:
+  float fraction{1.f};
+
+  float ReportFixture(b2Fixture* fixture, const b2Vec2&, const b2Vec2&,
+                      float value) override {
+    constexpr const auto boundary =
+        static_cast<uint16_t>(PhysicsBodyMask::Boundary);
+    if (fixture->IsSensor() ||
+        (fixture->GetFilterData().categoryBits & boundary) == 0) {
+      return -1.f;
+    }
+
+    fraction = value;
+    return value;
+  }
+};
+}  // namespace
+
+Simulation::Simulation(uint32_t tickRate) noexcept
+    : timeStep_(1.f / static_cast<float>(tickRate)),
+      maximumRewind_(std::min(
+          static_cast<uint32_t>(kMaximumRewind * static_cast<float>(tickRate)),
+          static_cast<uint32_t>(HitboxHistory::kCapacity - 1))),
+      shootInterval_(static_cast<uint32_t>(
+          std::ceil((kShootInterval - kShootTolerance) *
+                    static_cast<float>(tickRate)))) {}
+
+void Simulation::load(const std::string& name) {
+  std::string path = "./assets/scenes/" + name + ".json";
+  Json::Value root;
+  Json::CharReaderBuilder builder;
+  std::ifstream stream(path, std::ifstream::binary);
+  std::string errors;
+  if (!Json::parseFromStream(builder, stream, &root, &errors)) {
+    throw FileSystemException("Could not parse JSON body from '" + path +
+                              "'. Reason: " + errors);
+  }
+
+  debug_print("[SIMULATION] Loading Scene: '%s'.\n", root["name"].asCString());
+  for (const auto& object : root["game_objects"]) loadGameObject(object);
+
+  if (speed_ == 0.f) {
+    throw FileSystemException("The scene '" + path +
+                              "' does not have a PlayerController.");
+  }
+
+  history_.extent(player_.scale / 2.f);
+
+  debug_print("[SIMULATION] Loaded Scene '%s' with %i body(ies).\n",
+              name.c_str(), world_.GetBodyCount());
+}
+
+void Simulation::loadGameObject(const Json::Value& json) {
+  if (!json["active"].asBool()) return;
+
+  const Json::Value* transform = nullptr;
+  const Json::Value* physics = nullptr;
+  const Json::Value* controller = nullptr;
+  for (const auto& component : json["components"]) {
+    const auto& name = component["name"].asString();
+    if (name == "Transform") transform = &component;
+    if (name == "PhysicsBody") physics = &component;
+    if (name == "PlayerController") controller = &component;
+  }
+
+  if (transform && physics) {
+    const body_template_t data{
+        Vector2<float>((*transform)["position"]),
+        Vector2<float>((*transform)["scale"]),
+        PhysicsBody::getBodyTypeFromName((*physics)["type"].asString()),
+        (*physics)["sensor"].asBool(),
+        (*physics)["density"].asFloat(),
+        (*physics)["restitution"].asFloat(),
+        (*physics)["linear_damping"].asFloat(),
+        PhysicsBody::getMaskFromJson((*physics)["category"]),
+        PhysicsBody::getMaskFromJson((*physics)["mask"])};
+
+    if (controller) {
+      // Every client sees the other players as enemies that collide with its
+      // own, so players must collide with each other here as well:
+      player_ = data;
+      player_.mask |= player_.category;
+      speed_ = (*controller)["speed"].asFloat();
+      clip_ = (*controller)["bullet_clip"].asUInt();
+    } else {
+      createBody(data);
+    }
+  }
+
+  for (const auto& child : json["children"]) loadGameObject(child);
+}
+
+b2Body* Simulation::createBody(const body_template_t& data) noexcept {
+  b2BodyDef bodyDef;
+  bodyDef.type = data.type;
+  bodyDef.position = data.position.toVec();
+  bodyDef.angle = 0.f;
+  bodyDef.fixedRotation = true;
+  bodyDef.linearDamping = data.linearDamping;
+  bodyDef.awake = true;
+
+  auto* body = world_.CreateBody(&bodyDef);
+
+  b2PolygonShape boxShape;
+  boxShape.SetAsBox(data.scale.x() / 2.f, data.scale.y() / 2.f);
+
+  b2FixtureDef fixtureDef;
+  fixtureDef.shape = &boxShape;
+  fixtureDef.density = data.density;
+  fixtureDef.isSensor = data.sensor;
+  fixtureDef.filter.categoryBits = data.category;
+  fixtureDef.filter.maskBits = data.mask;
+  fixtureDef.restitution = data.restitution;
+  body->CreateFixture(&fixtureDef);
+  return body;
+}
+
+void Simulation::createWall(const Vector2<float>& position) noexcept {
+  // Mirrors the wall BulletBox leaves behind:
+  constexpr const auto category =
+      static_cast<uint16_t>(PhysicsBodyMask::Boundary);
+  constexpr const auto mask = static_cast<uint16_t>(PhysicsBodyMask::Boundary) |
+                              static_cast<uint16_t>(PhysicsBodyMask::Bullet) |
+                              static_cast<uint16_t>(PhysicsBodyMask::Player);
+  auto* body = createBody({position,
+                           {50.f, 50.f},
+                           b2BodyType::b2_dynamicBody,
+                           false,
+                           1000000.f,
+                           0.f,
+                           1.f,
+                           category,
+                           mask});
+
+  // The snapshots tell the clients the oldest wall is gone, which they remove
+  // as any other entity:
+  if (walls_.size() == kMaximumWalls) {
+    world_.DestroyBody(walls_.front().body);
+    walls_.erase(walls_.begin());
+  }
+  walls_.push_back({body, nextEntity_++});
+}
+
+void Simulation::collect() noexcept {
+  // A collectible gives a bullet to the player that touches it first, and is
+  // gone for the others, as ContactListener does:
+  constexpr const auto collectible =
+      static_cast<uint16_t>(PhysicsBodyMask::Collectible);
+  std::vector<b2Body*> collected;
+  for (auto& player : players_) {
+    if (!player.active) continue;
+
+    for (auto* edge = player.body->GetContactList(); edge; edge = edge->next) {
+      if (!edge->contact->IsTouching()) continue;
+
+      auto* fixture = edge->contact->GetFixtureA()->GetBody() == player.body
+                          ? edge->contact->GetFixtureB()
+                          : edge->contact->GetFixtureA();
+      if ((fixture->GetFilterData().categoryBits & collectible) == 0 ||
+          std::find(collected.begin(), collected.end(), edge->other) !=
+              collected.end()) {
+        continue;
+      }
+
+      collected.push_back(edge->other);
+      ++player.clip;
+    }
+  }
+
+  for (auto* body : collected) world_.DestroyBody(body);
+}
+
+void Simulation::addPlayer(uint32_t id) noexcept {
+  // Whichever player had the slot before is gone:
+  auto& data = player(id);
+  if (data.active) removePlayer(data.id);
+
+  data.body = createBody(player_);
+  data.target = player_.position;
+  data.id = id;
+  data.nextShot = 0;
+  data.clip = clip_;
+  data.active = true;
+}
+
+void Simulation::removePlayer(uint32_t id) noexcept {
+  if (!active(id)) return;
+
+  auto& data = player(id);
+  world_.DestroyBody(data.body);
+  data.body = nullptr;
+  data.active = false;
+}
+
+void Simulation::movePlayer(uint32_t id,
+                            const Vector2<float>& position) noexcept {
+  if (active(id)) player(id).target = position;
+}
+
+void Simulation::shoot(uint32_t id, float angle, uint32_t tick) noexcept {
+  if (!active(id)) return;
+
+  // The tick the shot was fired at, no earlier than a rewind allows, so an
+  // old one cannot make up for the shots a client skipped:
+  const auto rewind =
+      tick == Snapshot::kNoBase || tick >= tick_
+          ? 0u
+          : std::min(tick_ - tick, maximumRewind_);
+  const auto fired = tick_ - rewind;
+  auto& shooter = player(id);
+  if (fired < shooter.nextShot || shooter.clip == 0) {
+    debug_print("[SIMULATION] Player %u cannot shoot at %u (next %u, %u "
+                "bullet(s)).\n",
+                id, fired, shooter.nextShot, shooter.clip);
+    return;
+  }
+  shooter.nextShot = fired + shootInterval_;
+  --shooter.clip;
+
+  // The shot leaves from where the client saw its own player, unless the
+  // server did not let the player get there:
+  const auto& sp = player_.scale / 2.f;
+  const auto pp = diverged(id) ? position(id) : player(id).target;
+  const Vector2<float> direction{-std::cos(angle), -std::sin(angle)};
+
+  // Spawned out of the player's body so it does not hit the shooter:
+  auto start = Vector2<float>(pp.x() + (sp.x() * direction.x() * 2.f),
+                              pp.y() + (sp.y() * direction.y() * 2.f));
+
+  // The client saw the others a few ticks in the past, so the bullet flew
+  // through that past in its eyes, one step per tick, up to the first wall:
+  auto remaining = kBulletLifetime;
+  if (rewind != 0) {
+    const auto flight = kBulletStep * static_cast<float>(rewind);
+    WallRayCast walls{};
+    world_.RayCast(&walls, start.toVec(), (start + direction * flight).toVec());
+    const auto reach = flight * walls.fraction;
+
+    const Vector2<float> size{kBulletSize / 2.f, kBulletSize / 2.f};
+    HitboxHistory::hit_t hit{};
+    Vector2<float> offset{};
+    auto struck = false;
+    for (uint32_t i = 0; i < rewind && !struck; ++i) {
+      const auto past = tick_ - rewind + i;
+      const auto from = kBulletStep * static_cast<float>(i);
+      if (from >= reach) break;
+      if (!history_.contains(past)) continue;
+
+      const auto to = std::min(from + kBulletStep, reach);
+      struck = history_.sweep(past, start + direction * from,
+                              start + direction * to, size, id, &hit);
+      if (struck) {
+        // Where the bullet touched the hitbox, relative to its center:
+        offset = start + direction * (from + (to - from) * hit.fraction) -
+                 hit.center;
+      }
+    }
+
+    if (struck && active(hit.id)) {
+      // The victim has moved since, the bullet strikes it at the same spot of
+      // its hitbox on the next step:
+      debug_print("[SIMULATION] Player %u hit %u, rewound %u tick(s).\n", id,
+                  hit.id, rewind);
+      start = position(hit.id) + offset;
+    } else {
+      // Short of a wall, so the bullet does not spawn inside it:
+      const auto travelled =
+          walls.fraction < 1.f ? std::max(reach - kBulletSize, 0.f) : reach;
+      start = start + direction * travelled;
+    }
+    remaining -= timeStep_ * static_cast<float>(rewind);
+  }
+
+  const auto velocity =
+      Vector2<double>{static_cast<double>(direction.x()) * 5000000000.0,
+                      static_cast<double>(direction.y()) * 5000000000.0};
+
+  constexpr const auto category =
+      static_cast<uint16_t>(PhysicsBodyMask::Bullet);
+  constexpr const auto mask =
+      static_cast<uint16_t>(PhysicsBodyMask::Boundary) |
+      static_cast<uint16_t>(PhysicsBodyMask::Player) |
+      static_cast<uint16_t>(PhysicsBodyMask::Enemy) |
+      static_cast<uint16_t>(PhysicsBodyMask::Collectible) |
+      static_cast<uint16_t>(PhysicsBodyMask::Bullet);
+  auto* body = createBody({start,
+                           {kBulletSize, kBulletSize},
+                           b2BodyType::b2_dynamicBody,
+                           false,
+                           1.f,
+                           1.f,
+                           0.4f,
+                           category,
+                           mask});
+  body->ApplyForceToCenter(velocity.toVec(), true);
+  bullets_.push_back({body, remaining, nextEntity_++});
+}
+
+void Simulation::step() noexcept {
+  // Steer every player towards the position its client reported, as fast as
+  // the player can move within a single step:
+  const auto maximumDistance = speed_ * kSpeedTolerance * timeStep_;
+  for (auto& player : players_) {
+    if (!player.active) continue;
+
+    const auto current = Vector2<float>(player.body->GetPosition());
+    const auto difference = player.target - current;
+    const auto distance = difference.magnitude();
+    const auto velocity =
+        distance > maximumDistance
+            ? difference * (maximumDistance / distance / timeStep_)
+            : difference / timeStep_;
+
+    player.body->SetLinearVelocity(velocity.toVec());
+  }
+
+  world_.Step(timeStep_, kVelocityIterations, kPositionIterations);
+
+  // Kept for the shots rewound to this tick later on:
+  history_.begin(tick_);
+  for (const auto& player : players_) {
+    if (!player.active) continue;
+    history_.add(tick_, player.id,
+                 Vector2<float>(player.body->GetPosition()));
+  }
+  ++tick_;
+  collect();
+
+  size_t i = 0;
+  while (i < bullets_.size()) {
+    auto& bullet = bullets_[i];
+    bullet.remaining -= timeStep_;
+    if (bullet.remaining > 0.f) {
+      ++i;
+      continue;
+    }
+
+    // The wall is placed where the bullet's transform was, its top-left
+    // corner, as the client does:
+    createWall(Vector2<float>(bullet.body->GetPosition()) - Vector2{4.f, 4.f});
+    world_.DestroyBody(bullet.body);
+    bullets_.erase(bullets_.begin() + static_cast<std::ptrdiff_t>(i));
+  }
+}
+
+void Simulation::capture(Snapshot::entities_t* entities) const noexcept {
+  entities->clear();
+  for (const auto& player : players_) {
+    if (!player.active) continue;
+    const auto key = Snapshot::key(Snapshot::EntityType::kPlayer, player.id);
+    entities->push_back({key, Vector2<float>(player.body->GetPosition())});
+  }
+
+  for (const auto& bullet : bullets_) {
+    entities->push_back(
+        {Snapshot::key(Snapshot::EntityType::kBullet, bullet.id),
+         Vector2<float>(bullet.body->GetPosition())});
+  }
+
+  for (const auto& wall : walls_) {
+    entities->push_back({Snapshot::key(Snapshot::EntityType::kWall, wall.id),
+                         Vector2<float>(wall.body->GetPosition())});
+  }
+
+  // The IDs wrap around, so their creation order is not their key order:
+  std::sort(entities->begin(), entities->end(),
+            [](const Snapshot::entity_t& a, const Snapshot::entity_t& b) {
+              return a.key < b.key;
+            });
+}
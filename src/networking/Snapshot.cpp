@@ -0,0 +1,68 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/Snapshot.h"
+
+#include "utils/Buffer.h"
+
+void Snapshot::encode(const entities_t* base, const entities_t& current,
+                      std::vector<uint8_t>* entries) noexcept {
+  static const entities_t empty{};
+  Buffer buffer{};
+  diff(
+      base ? *base : empty, current,
+      [&](const entity_t& entity) {
+        const auto offset = entries->size();
+        entries->resize(offset + kEntrySize);
+        auto* entry = entries->data() + offset;
+        buffer.writeUint8(entry, static_cast<uint8_t>(type(entity.key)), 0);
+        buffer.writeUint32(entry, id(entity.key), sizeof(uint8_t));
+        Protocol::writePosition(entry, entity.position, kRemovedEntrySize);
+      },
+      [&](uint64_t key) {
+        const auto offset = entries->size();
+        entries->resize(offset + kRemovedEntrySize);
+        auto* entry = entries->data() + offset;
+        buffer.writeUint8(entry, static_cast<uint8_t>(type(key)) | kRemoved, 0);
+        buffer.writeUint32(entry, id(key), sizeof(uint8_t));
+      });
+}
+
+bool Snapshot::decode(const entities_t* base, const uint8_t* entries,
+                      size_t size, entities_t* current) noexcept {
+  static const entities_t empty{};
+  const auto& from = base ? *base : empty;
+  Buffer buffer{};
+
+  current->clear();
+  current->reserve(from.size());
+
+  auto it = from.begin();
+  size_t offset = 0;
+  bool first = true;
+  uint64_t previous = 0;
+  while (offset != size) {
+    const auto* entry = entries + offset;
+    const auto length = entrySize(entry);
+    if (length > size - offset) return false;
+    offset += length;
+
+    const auto flags = buffer.readUint8(entry, 0);
+    const auto key =
+        Snapshot::key(static_cast<EntityType>(flags & ~kRemoved),
+                      buffer.readUInt32(entry, sizeof(uint8_t)));
+
+    // The entries are sorted, which lets them be merged in a single pass:
+    if (!first && key <= previous) return false;
+    first = false;
+    previous = key;
+
+    while (it != from.end() && it->key < key) current->push_back(*it++);
+    if (it != from.end() && it->key == key) ++it;
+    if ((flags & kRemoved) != 0) continue;
+
+    current->push_back({key, Protocol::readPosition(entry, kRemovedEntrySize)});
+  }
+
+  while (it != from.end()) current->push_back(*it++);
+  return true;
+}
@@ -0,0 +1,267 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/Socket.h"
+
+#if _WIN32
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+#include <utility>
+
+namespace {
+#if _WIN32
+constexpr socket_handle_t kInvalidHandle = INVALID_SOCKET;
+
+inline bool setNonBlocking(socket_handle_t handle) noexcept {
+  u_long mode = 1;
+  return ioctlsocket(handle, FIONBIO, &mode) == 0;
+}
+
+inline bool wouldBlock() noexcept {
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+inline void closeHandle(socket_handle_t handle) noexcept {
+  closesocket(handle);
+}
+#else
+constexpr socket_handle_t kInvalidHandle = -1;
+
+inline bool setNonBlocking(socket_handle_t handle) noexcept {
+  const auto flags = fcntl(handle, F_GETFL, 0);
+  return flags != -1 && fcntl(handle, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+inline bool wouldBlock() noexcept {
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+inline void closeHandle(socket_handle_t handle) noexcept { ::close(handle); }
+#endif
+
+inline void setNoDelay(socket_handle_t handle) noexcept {
+  int enable = 1;
+  setsockopt(handle, IPPROTO_TCP, TCP_NODELAY,
+             reinterpret_cast<const char*>(&enable), sizeof(enable));
+}
+}  // namespace
+
+Socket::Socket() noexcept : handle_(kInvalidHandle) {}
+
+Socket::Socket(socket_handle_t handle) noexcept : handle_(handle) {}
+
+Socket::Socket(Socket&& other) noexcept
+    : handle_(std::exchange(other.handle_, kInvalidHandle)) {}
+
+Socket::~Socket() noexcept { close(); }
+
+Socket& Socket::operator=(Socket&& other) noexcept {
+  if (this != &other) {
+    close();
+    handle_ = std::exchange(other.handle_, kInvalidHandle);
+  }
+
+  return *this;
+}
+
+Socket Socket::listen(uint16_t port) noexcept {
+  Socket socket{::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)};
+  if (!socket.valid()) return socket;
+
+  int enable = 1;
+  setsockopt(socket.handle_, SOL_SOCKET, SO_REUSEADDR,
+             reinterpret_cast<const char*>(&enable), sizeof(enable));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(socket.handle_, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      ::listen(socket.handle_, SOMAXCONN) != 0 ||
+      !setNonBlocking(socket.handle_)) {
+    socket.close();
+  }
+
+  return socket;
+}
+
+Socket Socket::datagram(uint16_t port) noexcept {
+  Socket socket{::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)};
+  if (!socket.valid()) return socket;
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(socket.handle_, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      !setNonBlocking(socket.handle_)) {
+    socket.close();
+  }
+
+  return socket;
+}
+
+Socket Socket::connect(uint32_t ipAddress, uint16_t port,
+                       size_t receiveBuffer, uint16_t segmentSize) noexcept {
+  Socket socket{::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)};
+  if (!socket.valid()) return socket;
+
+  // Both are set before connecting, as they are offered to the peer in the
+  // handshake, and both are hints the system may ignore or round:
+  if (receiveBuffer != 0) {
+    const auto size = static_cast<int>(receiveBuffer);
+    setsockopt(socket.handle_, SOL_SOCKET, SO_RCVBUF,
+               reinterpret_cast<const char*>(&size), sizeof(size));
+  }
+  if (segmentSize != 0) {
+    const int size = segmentSize;
+    setsockopt(socket.handle_, IPPROTO_TCP, TCP_MAXSEG,
+               reinterpret_cast<const char*>(&size), sizeof(size));
+  }
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(ipAddress);
+  address.sin_port = htons(port);
+  if (::connect(socket.handle_, reinterpret_cast<sockaddr*>(&address),
+                sizeof(address)) != 0 ||
+      !setNonBlocking(socket.handle_)) {
+    socket.close();
+    return socket;
+  }
+
+  setNoDelay(socket.handle_);
+  return socket;
+}
+
+Socket Socket::accept(uint32_t* ipAddress, uint16_t* port) const noexcept {
+  sockaddr_in address{};
+  socklen_t length = sizeof(address);
+  Socket socket{
+      ::accept(handle_, reinterpret_cast<sockaddr*>(&address), &length)};
+  if (!socket.valid()) return socket;
+
+  if (!setNonBlocking(socket.handle_)) {
+    socket.close();
+    return socket;
+  }
+
+  // Messages are small and latency-sensitive, do not let Nagle batch them:
+  setNoDelay(socket.handle_);
+
+  *ipAddress = ntohl(address.sin_addr.s_addr);
+  *port = ntohs(address.sin_port);
+  return socket;
+}
+
+int32_t Socket::receive(uint8_t* data, size_t size) const noexcept {
+  const auto read = recv(handle_, reinterpret_cast<char*>(data),
+                         static_cast<int>(size), 0);
+  if (read >= 0) return static_cast<int32_t>(read);
+  return wouldBlock() ? kWouldBlock : kError;
+}
+
+int32_t Socket::send(const uint8_t* data, size_t size) const noexcept {
+#if _WIN32
+  constexpr int flags = 0;
+#else
+  // Do not raise SIGPIPE when the peer has gone away, report it as an error:
+  constexpr int flags = MSG_NOSIGNAL;
+#endif
+  const auto written = ::send(handle_, reinterpret_cast<const char*>(data),
+                              static_cast<int>(size), flags);
+  if (written >= 0) return static_cast<int32_t>(written);
+  return wouldBlock() ? kWouldBlock : kError;
+}
+
+int32_t Socket::send(const socket_buffer_t* buffers,
+                     size_t count) const noexcept {
+#if _WIN32
+  DWORD written = 0;
+  if (WSASend(handle_, const_cast<WSABUF*>(buffers),
+              static_cast<DWORD>(count), &written, 0, nullptr,
+              nullptr) == 0) {
+    return static_cast<int32_t>(written);
+  }
+#else
+  // sendmsg rather than writev, as the latter cannot suppress SIGPIPE:
+  msghdr message{};
+  message.msg_iov = const_cast<iovec*>(buffers);
+  message.msg_iovlen = count;
+  const auto written = sendmsg(handle_, &message, MSG_NOSIGNAL);
+  if (written >= 0) return static_cast<int32_t>(written);
+#endif
+  return wouldBlock() ? kWouldBlock : kError;
+}
+
+int32_t Socket::receiveFrom(uint8_t* data, size_t size, uint32_t* ipAddress,
+                            uint16_t* port) const noexcept {
+  sockaddr_in address{};
+  socklen_t length = sizeof(address);
+  const auto read =
+      recvfrom(handle_, reinterpret_cast<char*>(data), static_cast<int>(size),
+               0, reinterpret_cast<sockaddr*>(&address), &length);
+  if (read < 0) return wouldBlock() ? kWouldBlock : kError;
+
+  *ipAddress = ntohl(address.sin_addr.s_addr);
+  *port = ntohs(address.sin_port);
+  return static_cast<int32_t>(read);
+}
+
+int32_t Socket::sendTo(const uint8_t* data, size_t size, uint32_t ipAddress,
+                       uint16_t port) const noexcept {
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(ipAddress);
+  address.sin_port = htons(port);
+  const auto written =
+      sendto(handle_, reinterpret_cast<const char*>(data),
+             static_cast<int>(size), 0,
+             reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+  if (written >= 0) return static_cast<int32_t>(written);
+  return wouldBlock() ? kWouldBlock : kError;
+}
+
+uint16_t Socket::localPort() const noexcept {
+  sockaddr_in address{};
+  socklen_t length = sizeof(address);
+  if (getsockname(handle_, reinterpret_cast<sockaddr*>(&address), &length) !=
+      0) {
+    return 0;
+  }
+
+  return ntohs(address.sin_port);
+}
+
+void Socket::shutdown() const noexcept {
+#if _WIN32
+  ::shutdown(handle_, SD_BOTH);
+#else
+  ::shutdown(handle_, SHUT_RDWR);
+#endif
+}
+
+void Socket::close() noexcept {
+  if (!valid()) return;
+  closeHandle(handle_);
+  handle_ = kInvalidHandle;
+}
+
+int32_t Socket::lastError() noexcept {
+#if _WIN32
+  return WSAGetLastError();
+#else
+  return errno;
+#endif
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "networking/UploadPolicy.h"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+uint32_t readVariable(const char* name, uint32_t fallback) noexcept {
+  const auto* value = std::getenv(name);
+  return value ? static_cast<uint32_t>(std::strtoul(value, nullptr, 10))
+               : fallback;
+}
+}  // namespace
+
+UploadPolicy::UploadPolicy() noexcept
+    : keepalive_(std::chrono::milliseconds(readVariable(
+          "OBSTACLE_RUN_UPLOAD_KEEPALIVE", kDefaultKeepalive))),
+      epsilon_(kDefaultEpsilon) {
+  // A rate of zero sends a position every frame, as before there was a policy:
+  const auto rate = readVariable("OBSTACLE_RUN_UPLOAD_RATE", kDefaultRate);
+  interval_ = rate == 0 ? clock::duration::zero()
+                        : std::chrono::duration_cast<clock::duration>(
+                              std::chrono::duration<double>(1.0 / rate));
+
+  if (const auto* value = std::getenv("OBSTACLE_RUN_UPLOAD_EPSILON")) {
+    epsilon_ = std::strtof(value, nullptr);
+  }
+
+  std::cout << "[NETWORK] Uploading positions at up to " << rate
+            << " Hz, past " << epsilon_ << " unit(s) of error, and every "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(keepalive_)
+                   .count()
+            << "ms at least.\n";
+}
+
+bool UploadPolicy::allow(clock::time_point now, const Vector2<float>& position,
+                         const Vector2<float>& velocity) noexcept {
+  // Kept until the next position is sent, so a stop between two uploads still
+  // sends the position the player stopped at:
+  if (velocity.x() != velocity_.x() || velocity.y() != velocity_.y()) {
+    changed_ = true;
+    velocity_ = velocity;
+  }
+
+  if (sent_ != 0) {
+    // The frames are not evenly spaced, without some slack a rate that divides
+    // the frame rate would often wait for one more frame:
+    const auto elapsed = now - last_;
+    const auto drifted = (position - position_).magnitude() > epsilon_;
+    if (elapsed < interval_ - interval_ / 8 ||
+        (!drifted && !changed_ && elapsed < keepalive_)) {
+      ++skipped_;
+      return false;
+    }
+  }
+
+  last_ = now;
+  position_ = position;
+  changed_ = false;
+  ++sent_;
+  return true;
+}
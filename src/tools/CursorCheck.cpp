@@ -0,0 +1,180 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+// Checks the bounds of BufferWriter and BufferReader, which every message goes
+// through: varints round trip at every length, a varint longer than 64 bits
+// or cut short fails the reader, a value past the end of a span is neither
+// written nor read, and a string whose length lies about the bytes that follow
+// is rejected. Meant to run under the sanitizers, it exits with a failure when
+// any check does not hold:
+//
+// CursorCheck
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "utils/Buffer.h"
+
+namespace {
+uint32_t failures = 0;
+
+void check(bool condition, const char* description) noexcept {
+  if (condition) return;
+  printf("[CURSOR] Failed: %s.\n", description);
+  ++failures;
+}
+
+void varintRoundTrips() noexcept {
+  // The largest value of every length, and the first of the next one:
+  std::vector<uint64_t> values{0};
+  for (uint32_t bits = 7; bits < 64; bits += 7) {
+    values.push_back((uint64_t{1} << bits) - 1);
+    values.push_back(uint64_t{1} << bits);
+  }
+  values.push_back(std::numeric_limits<uint64_t>::max());
+
+  for (const auto value : values) {
+    size_t size = 1;
+    for (auto rest = value >> 7u; rest != 0; rest >>= 7u) ++size;
+
+    std::vector<uint8_t> data;
+    BufferWriter writer{&data};
+    writer.writeVarint(value);
+    check(writer.size() == size && data.size() == size,
+          "a varint takes a byte per 7 bits");
+
+    BufferReader reader{data.data(), data.size()};
+    check(reader.readVarint() == value, "a varint reads back as written");
+    check(reader.valid() && reader.remaining() == 0,
+          "a varint is read whole");
+  }
+
+  check(BufferWriter::kMaximumVarintSize == 10,
+        "a varint of 64 bits takes 10 bytes");
+}
+
+void overlongVarints() noexcept {
+  // Ten bytes hold 70 bits, of which the last byte may only set the first:
+  uint8_t largest[10];
+  memset(largest, 0xFF, sizeof(largest));
+  largest[9] = 0x01;
+  BufferReader fits{largest, sizeof(largest)};
+  check(fits.readVarint() == std::numeric_limits<uint64_t>::max() &&
+            fits.valid(),
+        "a varint of exactly 64 bits is accepted");
+
+  largest[9] = 0x02;
+  BufferReader overflows{largest, sizeof(largest)};
+  check(overflows.readVarint() == 0 && !overflows.valid(),
+        "a varint of 65 bits fails the reader");
+
+  uint8_t eleven[11];
+  memset(eleven, 0x80, sizeof(eleven));
+  eleven[10] = 0x00;
+  BufferReader tooLong{eleven, sizeof(eleven)};
+  check(tooLong.readVarint() == 0 && !tooLong.valid(),
+        "a varint of eleven bytes fails the reader");
+
+  const uint8_t truncated[] = {0x80, 0x80};
+  BufferReader cut{truncated, sizeof(truncated)};
+  check(cut.readVarint() == 0 && !cut.valid(),
+        "a varint cut short fails the reader");
+  check(cut.readUint8() == 0 && !cut.valid() && cut.remaining() == 0,
+        "a failed reader stays failed");
+}
+
+void spanOverflows() noexcept {
+  // The guard bytes past the span must never be written:
+  uint8_t data[8];
+  memset(data, 0xAB, sizeof(data));
+  BufferWriter writer{data, 6};
+  writer.writeUint32(0x01020304u);
+  check(!writer.overflowed() && writer.size() == 4,
+        "a value that fits is written");
+  writer.writeUint32(0x05060708u);
+  check(writer.overflowed() && writer.size() == 4,
+        "a value that does not fit overflows the writer");
+  writer.writeUint8(0x09);
+  check(writer.overflowed() && writer.size() == 4,
+        "an overflowed writer stays overflowed");
+  check(data[4] == 0xAB && data[5] == 0xAB && data[6] == 0xAB &&
+            data[7] == 0xAB,
+        "an overflowed writer writes nothing");
+
+  BufferWriter late{data, 6, 10};
+  late.writeUint8(0x01);
+  check(late.overflowed() && data[6] == 0xAB,
+        "a writer that starts past the span writes nothing");
+
+  BufferReader reader{data, 6};
+  check(reader.readUint32() == 0x01020304u, "a value within the span is read");
+  check(reader.readUint32() == 0 && !reader.valid(),
+        "a value past the span reads as 0 and fails the reader");
+  check(reader.offset() == 6 && reader.remaining() == 0,
+        "a failed reader ends at the span's end");
+
+  BufferReader huge{data, 6};
+  check(huge.take(std::numeric_limits<size_t>::max()) == nullptr &&
+            !huge.valid(),
+        "a span larger than the address space does not wrap around");
+
+  BufferReader past{data, 6, 7};
+  check(!past.valid() && past.readUint8() == 0,
+        "a reader that starts past the span is failed");
+}
+
+void lyingStrings() noexcept {
+  std::vector<uint8_t> data;
+  BufferWriter writer{&data};
+  writer.writeString("");
+  writer.writeString("obstacle");
+  BufferReader honest{data.data(), data.size()};
+  check(honest.readString().empty() && honest.readString() == "obstacle" &&
+            honest.valid() && honest.remaining() == 0,
+        "a string reads back as written");
+
+  // A length that promises more bytes than the span holds:
+  data.clear();
+  writer = BufferWriter{&data};
+  writer.writeVarint(1000);
+  writer.writeBytes(reinterpret_cast<const uint8_t*>("run"), 3);
+  BufferReader shorter{data.data(), data.size()};
+  check(shorter.readString().empty() && !shorter.valid(),
+        "a string longer than the span fails the reader");
+
+  // One that would not fit the address space, which must not be allocated:
+  data.clear();
+  writer = BufferWriter{&data};
+  writer.writeVarint(std::numeric_limits<uint64_t>::max());
+  BufferReader endless{data.data(), data.size()};
+  check(endless.readString(std::numeric_limits<size_t>::max()).empty() &&
+            !endless.valid(),
+        "a string of 2^64 bytes fails the reader");
+
+  // And one the span holds but the caller does not accept:
+  data.clear();
+  writer = BufferWriter{&data};
+  writer.writeString("obstacle run");
+  BufferReader longer{data.data(), data.size()};
+  check(longer.readString(8).empty() && !longer.valid(),
+        "a string longer than the maximum fails the reader");
+}
+}  // namespace
+
+int main() {
+  varintRoundTrips();
+  overlongVarints();
+  spanOverflows();
+  lyingStrings();
+
+  if (failures != 0) {
+    printf("[CURSOR] %u check(s) failed.\n", failures);
+    return EXIT_FAILURE;
+  }
+
+  printf("[CURSOR] Every check passed.\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,930 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+// A headless load generator, which opens many connections to a server from a
+// single process. Each connection is a bot that speaks the same protocol as
+// Client: it reports a wandering position every tick, shoots at a given rate,
+// acknowledges the snapshots it receives and pings the server, so the round
+// trip of a message through the server's tick can be measured. The bots may
+// connect a few per second rather than all at once, and given the process of
+// the server, its processor usage is reported along with the traffic, so a
+// ramp shows how the cost of a tick grows with the connections. With churn,
+// every bot leaves that many ticks after the server identified it and
+// connects again, which stresses how the server adopts and releases clients.
+// The first slow readers shrink their receive buffer and segments, read a few
+// bytes per tick and ping every tick, so the server has to drop their updates
+// and then disconnect them while the other bots show whether its tick kept up.
+// With datagrams, every bot binds a UDP socket with the ID and token it was
+// identified with, as Client does, and talks through it once the server
+// answers there, failing the run if any identified bot was never bound:
+//
+// LoadGenerator [--address=127.0.0.1] [--port=9999] [--bots=64]
+//               [--shoot-rate=1] [--seconds=30] [--threads=1] [--ramp=0]
+//               [--server-pid=0] [--churn=0] [--slow-readers=0]
+//               [--datagrams=0]
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if __linux__
+#include <unistd.h>
+#endif
+
+#include "networking/Messages.h"
+#include "networking/Poller.h"
+#include "networking/Protocol.h"
+#include "networking/ReliableChannel.h"
+#include "networking/Snapshot.h"
+#include "networking/Socket.h"
+#include "utils/Buffer.h"
+#include "utils/Registry.h"
+#include "utils/TickScheduler.h"
+
+namespace {
+/**
+ * \brief The rate at which a bot reports its position, as Client does every
+ * frame.
+ */
+constexpr uint32_t kUploadRate = 60;
+
+/**
+ * \brief The amount of ticks between two pings of a bot.
+ */
+constexpr uint32_t kPingInterval = kUploadRate / 10;
+
+/**
+ * \brief The amount of pings a bot waits for at once, a ping that is not
+ * answered before this many more are sent is counted as lost.
+ */
+constexpr size_t kPingHistory = 64;
+
+/**
+ * \brief The keys of the unreliable messages a bot sends through UDP, as
+ * Client's, so a newer position replaces an older one still queued.
+ */
+constexpr uint32_t kPositionKey = 0;
+constexpr uint32_t kAcknowledgeKey = 1;
+
+/**
+ * \brief How fast a bot wanders, in units per second, under the speed of the
+ * players of the default scene so the server does not correct it.
+ */
+constexpr float kWanderSpeed = 90.f;
+
+/**
+ * \brief The amount of bytes a bot may have waiting for the socket, past it
+ * the new messages are dropped whole.
+ */
+constexpr size_t kMaximumPending = 64 * 1024;
+
+/**
+ * \brief The size of the receive buffer of a slow reader, as small as the
+ * system allows, so the messages pile up on the server rather than in the
+ * kernel.
+ */
+constexpr size_t kSlowReceiveBuffer = 4 * 1024;
+
+/**
+ * \brief The largest segment the server may send to a slow reader, the one of
+ * an Ethernet route. The server's kernel sizes its send buffer by its
+ * segments, which would hold megabytes of a loopback connection's 64 KiB
+ * ones, long before the server noticed the reader is slow.
+ */
+constexpr uint16_t kSlowSegmentSize = 1460;
+
+/**
+ * \brief The amount of bytes a slow reader reads per tick once identified,
+ * fewer than the pongs it asks for.
+ */
+constexpr size_t kSlowReadBytes = 4;
+
+struct options_t {
+  uint32_t address{0x7F000001u};
+  uint16_t port{9999};
+  size_t bots{64};
+  double shootRate{1.0};
+  uint32_t seconds{30};
+  size_t threads{1};
+  // The bots connected per second, all of them at once when 0:
+  double ramp{0.0};
+  int32_t serverPid{0};
+  // The ticks a bot stays once identified, it never leaves when 0:
+  uint32_t churn{0};
+  size_t slowReaders{0};
+  bool datagrams{false};
+};
+
+struct stats_t {
+  uint64_t messagesOut{0};
+  uint64_t bytesOut{0};
+  uint64_t messagesIn{0};
+  uint64_t bytesIn{0};
+  uint64_t messagesBlocked{0};
+  uint64_t snapshotsMissed{0};
+  uint64_t pingsLost{0};
+  uint64_t disconnections{0};
+  uint64_t identified{0};
+  uint64_t bound{0};
+  uint64_t rejoins{0};
+  uint64_t slowSnapshots{0};
+  uint64_t evictions{0};
+  std::vector<float> latencies{};
+
+  /**
+   * \brief Adds the counters of another, leaving it empty.
+   */
+  void take(stats_t& other) noexcept {
+    messagesOut += other.messagesOut;
+    bytesOut += other.bytesOut;
+    messagesIn += other.messagesIn;
+    bytesIn += other.bytesIn;
+    messagesBlocked += other.messagesBlocked;
+    snapshotsMissed += other.snapshotsMissed;
+    pingsLost += other.pingsLost;
+    disconnections += other.disconnections;
+    identified += other.identified;
+    bound += other.bound;
+    rejoins += other.rejoins;
+    slowSnapshots += other.slowSnapshots;
+    evictions += other.evictions;
+    latencies.insert(latencies.end(), other.latencies.begin(),
+                     other.latencies.end());
+    other = {};
+  }
+};
+
+class Bot final {
+  using clock = TickScheduler::clock;
+
+  struct ping_t {
+    clock::time_point sent{};
+    uint32_t sequence{0};
+    bool pending{false};
+  };
+
+  Buffer buffer_{};
+  Socket socket_{};
+  Socket datagram_{};
+  ReliableChannel channel_{};
+  Protocol::receive_buffer_t received_{};
+  std::vector<uint8_t> pending_{};
+  std::array<ping_t, kPingHistory> pings_{};
+  double shootCredit_;
+  float x_{0.f};
+  float y_{0.f};
+  float heading_{0.f};
+  uint32_t phase_;
+  uint32_t address_{0};
+  uint16_t port_{0};
+  uint32_t age_{0};
+  uint32_t id_{Handle::kInvalid};
+  uint32_t token_{0};
+  uint32_t event_{0};
+  uint32_t ping_{0};
+  uint32_t sequence_{0};
+  uint32_t assemblyTick_{Snapshot::kNoBase};
+  uint32_t assemblyParts_{0};
+  uint32_t lastSnapshot_{Snapshot::kNoBase};
+  uint32_t snapshotInterval_{std::numeric_limits<uint32_t>::max()};
+  bool positioned_{false};
+  bool slow_;
+  bool datagrams_;
+  bool bindSent_{false};
+  bool bound_{false};
+  bool unreachable_{false};
+
+  void send(uint8_t* frame, size_t size, stats_t& stats) noexcept {
+    // A frame that does not fit is dropped whole, as part of one would break
+    // the stream:
+    if (pending_.size() + size > kMaximumPending) {
+      ++stats.messagesBlocked;
+      return;
+    }
+
+    buffer_.writeUint16(frame, static_cast<uint16_t>(size),
+                        Protocol::kSizeOffset);
+    buffer_.writeUint32(frame, event_++, Protocol::kCounterOffset);
+    pending_.insert(pending_.end(), frame, frame + size);
+    ++stats.messagesOut;
+    stats.bytesOut += size;
+  }
+
+  /**
+   * \brief Sends a message through UDP once the server answered there, as
+   * Client::sendDatagram() does.
+   * \return Whether or not it was, false if it must go through TCP.
+   */
+  bool sendDatagram(const uint8_t* frame, size_t size, bool reliable,
+                    uint32_t key, stats_t& stats) noexcept {
+    if (!bound_) return false;
+
+    const auto* payload = frame + Protocol::kPrefixSize;
+    const auto length = size - Protocol::kPrefixSize;
+    if (reliable ? !channel_.sendReliable(payload, length)
+                 : !channel_.sendUnreliable(key, payload, length)) {
+      // A reliable message through TCP would overtake the queued ones:
+      if (reliable) unreachable_ = true;
+      ++stats.messagesBlocked;
+      return true;
+    }
+
+    ++stats.messagesOut;
+    stats.bytesOut += size;
+    return true;
+  }
+
+  bool flush() noexcept {
+    if (datagram_.valid()) {
+      uint8_t datagram[ReliableChannel::kMaximumDatagramSize];
+      while (const auto size = channel_.write(datagram)) {
+        static_cast<void>(datagram_.sendTo(datagram, size, address_, port_));
+      }
+    }
+
+    if (pending_.empty()) return true;
+
+    const auto written = socket_.send(pending_.data(), pending_.size());
+    if (written == Socket::kWouldBlock) return true;
+    if (written < 0) return false;
+
+    pending_.erase(pending_.begin(), pending_.begin() + written);
+    return true;
+  }
+
+  void follow(const Vector2<float>& position) noexcept {
+    x_ = position.x();
+    y_ = position.y();
+    positioned_ = true;
+  }
+
+  void handle(const uint8_t* frame, size_t size, stats_t& stats) noexcept {
+    ++stats.messagesIn;
+    ServerMessages::dispatch(frame, size,
+                             [this, &stats](auto type, const auto&... fields) {
+                               receive(type, stats, fields...);
+                             });
+  }
+
+  void receive(PlayerIdentifyMessage, stats_t& stats, uint32_t id,
+               uint32_t token, uint32_t) noexcept {
+    id_ = id;
+    token_ = token;
+    ++stats.identified;
+  }
+
+  void receive(PlayerUpdatePositionMessage, stats_t&, uint32_t player,
+               uint32_t, const Vector2<float>& position) noexcept {
+    // The server did not let the bot move where it said, follow it:
+    if (player == id_) follow(position);
+  }
+
+  void receive(PongMessage, stats_t& stats, uint32_t sequence) noexcept {
+    auto& ping = pings_[sequence % pings_.size()];
+    if (!ping.pending || ping.sequence != sequence) return;
+
+    ping.pending = false;
+    stats.latencies.push_back(
+        std::chrono::duration<float, std::milli>(clock::now() - ping.sent)
+            .count());
+  }
+
+  void receive(WorldSnapshotMessage, stats_t& stats, uint32_t tick, uint32_t,
+               uint8_t part, uint8_t parts,
+               const body_field_t::value_t& entries) noexcept {
+    if (part >= parts || parts > Snapshot::kMaximumParts) return;
+
+    // The bot spawns wherever the server puts it, which it learns from the
+    // first snapshot its own player is in:
+    if (!positioned_) {
+      size_t offset = 0;
+      while (offset + Snapshot::kRemovedEntrySize <= entries.size) {
+        const auto* entry = entries.data + offset;
+        const auto length = Snapshot::entrySize(entry);
+        if (length == Snapshot::kEntrySize && offset + length <= entries.size &&
+            entry[0] == static_cast<uint8_t>(Snapshot::EntityType::kPlayer) &&
+            buffer_.readUInt32(entry, sizeof(uint8_t)) == id_) {
+          follow(Protocol::readPosition(entry, Snapshot::kRemovedEntrySize));
+        }
+
+        offset += length;
+      }
+    }
+
+    if (tick != assemblyTick_) {
+      assemblyTick_ = tick;
+      assemblyParts_ = 0;
+    }
+
+    assemblyParts_ |= 1u << part;
+    const auto complete =
+        parts == 32 ? 0xFFFFFFFFu : (1u << static_cast<uint32_t>(parts)) - 1u;
+    if (assemblyParts_ != complete) return;
+
+    // The server sends a snapshot every few ticks, unless nothing changed
+    // since the acknowledged one, which does not happen to a bot that keeps
+    // moving, so the shortest gap between two is the interval:
+    if (lastSnapshot_ != Snapshot::kNoBase && tick > lastSnapshot_) {
+      const auto gap = tick - lastSnapshot_;
+      snapshotInterval_ = std::min(snapshotInterval_, gap);
+      if (!slow_) stats.snapshotsMissed += gap / snapshotInterval_ - 1;
+    }
+    lastSnapshot_ = tick;
+    if (slow_) ++stats.slowSnapshots;
+
+    uint8_t message[AcknowledgeSnapshotMessage::kSize];
+    const auto size = AcknowledgeSnapshotMessage::encode(message, tick);
+    if (!sendDatagram(message, size, false, kAcknowledgeKey, stats)) {
+      send(message, size, stats);
+    }
+  }
+
+ public:
+  Bot(uint32_t phase, double shootCredit, bool slow, bool datagrams) noexcept
+      : shootCredit_(shootCredit),
+        phase_(phase),
+        slow_(slow),
+        datagrams_(datagrams) {}
+
+  [[nodiscard]] inline const Socket& socket() const noexcept {
+    return socket_;
+  }
+
+  /**
+   * \brief The ticks since the server identified the bot.
+   */
+  [[nodiscard]] inline uint32_t age() const noexcept { return age_; }
+
+  /**
+   * \brief Whether or not the bot is a slow reader, which is not polled but
+   * reads a few bytes every tick.
+   */
+  [[nodiscard]] inline bool slow() const noexcept { return slow_; }
+
+  /**
+   * \brief Whether or not the server identified the bot.
+   */
+  [[nodiscard]] inline bool identified() const noexcept {
+    return id_ != Handle::kInvalid;
+  }
+
+  /**
+   * \brief Closes the connection and forgets everything learnt from it, so
+   * the bot can connect again as a new player.
+   */
+  void reset() noexcept { *this = Bot{phase_, 0.0, slow_, datagrams_}; }
+
+  bool connect(uint32_t address, uint16_t port) noexcept {
+    address_ = address;
+    port_ = port;
+    socket_ = slow_ ? Socket::connect(address, port, kSlowReceiveBuffer,
+                                      kSlowSegmentSize)
+                    : Socket::connect(address, port);
+    if (datagrams_) datagram_ = Socket::datagram(0);
+    return socket_.valid() && (!datagrams_ || datagram_.valid());
+  }
+
+  /**
+   * \brief Reads and handles every datagram the server sent, the first one
+   * telling that it bound the bot's address.
+   */
+  void receiveDatagrams(stats_t& stats) noexcept {
+    if (!datagram_.valid()) return;
+
+    uint8_t datagram[ReliableChannel::kMaximumDatagramSize];
+    uint32_t address;
+    uint16_t port;
+    while (true) {
+      const auto size =
+          datagram_.receiveFrom(datagram, sizeof(datagram), &address, &port);
+      if (size < 0) return;
+      if (address != address_ || port != port_) continue;
+
+      stats.bytesIn += static_cast<uint64_t>(size);
+      const auto valid = channel_.read(
+          datagram, static_cast<size_t>(size),
+          [this, &stats](const uint8_t* frame, size_t frameSize) {
+            handle(frame, frameSize, stats);
+          });
+      if (valid && !bound_) {
+        bound_ = true;
+        ++stats.bound;
+      }
+    }
+  }
+
+  /**
+   * \brief Reads and handles what the socket has.
+   * \param budget The most bytes to read.
+   * \return Whether or not the connection is still open.
+   */
+  bool receive(stats_t& stats,
+               size_t budget = std::numeric_limits<size_t>::max()) noexcept {
+    while (budget != 0) {
+      size_t size;
+      auto* data = received_.writable(&size);
+      const auto length = socket_.receive(data, std::min(size, budget));
+      if (length == Socket::kWouldBlock) return true;
+      if (length <= 0) return false;
+
+      budget -= static_cast<size_t>(length);
+      received_.commit(static_cast<size_t>(length));
+      stats.bytesIn += static_cast<uint64_t>(length);
+      const auto valid = Protocol::drain(
+          received_, [this, &stats](const uint8_t* frame, size_t frameSize) {
+            handle(frame, frameSize, stats);
+          });
+      if (!valid) return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief Sends the messages of a tick, and whatever is still waiting.
+   * \return Whether or not the connection is still open.
+   */
+  bool tick(uint64_t tick, double shootRate, std::mt19937& random,
+            stats_t& stats) noexcept {
+    if (id_ == Handle::kInvalid) return true;
+    ++age_;
+
+    // Every message a bot sends fits the largest of them, which encode()
+    // checks at compile time:
+    uint8_t message[UpdatePositionMessage::kSize];
+    if (datagram_.valid() && !bindSent_) {
+      // Only meaningful through UDP, the channel resends it until the server
+      // acknowledges it:
+      const auto size = BindDatagramMessage::encode(message, id_, token_);
+      bindSent_ = channel_.sendReliable(message + Protocol::kPrefixSize,
+                                        size - Protocol::kPrefixSize);
+    }
+
+    if (positioned_) {
+      std::uniform_real_distribution<float> turn{-0.3f, 0.3f};
+      heading_ += turn(random);
+      x_ += std::cos(heading_) * kWanderSpeed / kUploadRate;
+      y_ += std::sin(heading_) * kWanderSpeed / kUploadRate;
+      const auto size =
+          UpdatePositionMessage::encode(message, sequence_++, {x_, y_});
+      if (!sendDatagram(message, size, false, kPositionKey, stats)) {
+        send(message, size, stats);
+      }
+
+      shootCredit_ += shootRate / kUploadRate;
+      if (shootCredit_ >= 1.0) {
+        shootCredit_ -= 1.0;
+        std::uniform_real_distribution<float> aim{-3.14159265f, 3.14159265f};
+        // A bot sees the world as the latest snapshot left it:
+        const auto size =
+            BulletShootMessage::encode(message, aim(random), lastSnapshot_);
+        if (!sendDatagram(message, size, true, 0, stats)) {
+          send(message, size, stats);
+        }
+      }
+    }
+
+    if (slow_) {
+      // The pongs are never measured, they only pile up on the server, which
+      // cannot drop them as it drops the updates:
+      send(message, PingMessage::encode(message, ping_++), stats);
+    } else if ((tick + phase_) % kPingInterval == 0) {
+      auto& ping = pings_[ping_ % pings_.size()];
+      if (ping.pending) ++stats.pingsLost;
+      ping = {clock::now(), ping_, true};
+      const auto size = PingMessage::encode(message, ping_++);
+      if (!sendDatagram(message, size, true, 0, stats)) {
+        send(message, size, stats);
+      }
+    }
+
+    return !unreachable_ && flush();
+  }
+};
+
+/**
+ * \brief The bots of a thread, and the counters it hands over every tick. The
+ * bots are dealt to the threads in turns, so the k-th bot of a thread is the
+ * (k * stride + index)-th one to connect.
+ */
+struct worker_t {
+  std::vector<std::unique_ptr<Bot>> bots{};
+  size_t index{0};
+  size_t stride{1};
+  std::mutex mutex{};
+  stats_t stats{};
+  std::atomic<size_t> connected{0};
+  std::atomic<size_t> slow{0};
+};
+
+void drive(worker_t& worker, const options_t& options,
+           const std::atomic<bool>& stop) noexcept {
+  Poller poller{};
+  if (!poller.valid()) {
+    std::cerr << "Poller: " << Socket::lastError() << '\n';
+    return;
+  }
+
+  stats_t stats{};
+  std::vector<Bot*> alive;
+  size_t connecting = 0;
+  const auto start = TickScheduler::clock::now();
+
+  // The slow readers are read every tick instead, as a socket that is never
+  // drained would wake the poller up over and over:
+  const auto watch = [&poller](Bot* bot) {
+    return bot->slow() || poller.add(bot->socket(), bot);
+  };
+
+  const auto connect = [&]() {
+    const std::chrono::duration<double> elapsed =
+        TickScheduler::clock::now() - start;
+    while (connecting < worker.bots.size() &&
+           !stop.load(std::memory_order_relaxed)) {
+      const auto order = connecting * worker.stride + worker.index;
+      if (options.ramp > 0.0 &&
+          static_cast<double>(order) > elapsed.count() * options.ramp) {
+        break;
+      }
+
+      auto* bot = worker.bots[connecting++].get();
+      if (!bot->connect(options.address, options.port) || !watch(bot)) {
+        std::cerr << "Socket::connect: " << Socket::lastError() << '\n';
+        continue;
+      }
+
+      alive.push_back(bot);
+      worker.connected.fetch_add(1, std::memory_order_relaxed);
+      if (bot->slow()) worker.slow.fetch_add(1, std::memory_order_relaxed);
+    }
+  };
+  connect();
+
+  // Forgets the connection of a bot and connects it again as a new player:
+  const auto rejoin = [&](Bot* bot) {
+    poller.remove(bot->socket());
+    bot->reset();
+    if (bot->connect(options.address, options.port) && watch(bot)) {
+      return true;
+    }
+
+    std::cerr << "Socket::connect: " << Socket::lastError() << '\n';
+    return false;
+  };
+
+  const auto disconnect = [&](Bot* bot) {
+    ++stats.disconnections;
+    if (bot->slow() && bot->identified()) ++stats.evictions;
+
+    // With churn, the server may reject a bot while the slot of the one that
+    // just left is not released yet, so it tries again:
+    if (options.churn != 0 && rejoin(bot)) return;
+
+    poller.remove(bot->socket());
+    alive.erase(std::find(alive.begin(), alive.end(), bot));
+    worker.connected.fetch_sub(1, std::memory_order_relaxed);
+    if (bot->slow()) worker.slow.fetch_sub(1, std::memory_order_relaxed);
+  };
+
+  constexpr size_t maximumEvents = 256;
+  poller_event_t events[maximumEvents];
+  std::mt19937 random{std::random_device{}()};
+  TickScheduler scheduler{kUploadRate};
+  while (!stop.load(std::memory_order_relaxed)) {
+    const auto timeout = std::chrono::ceil<std::chrono::milliseconds>(
+        scheduler.remaining());
+    const auto count = poller.wait(events, maximumEvents,
+                                   static_cast<int32_t>(timeout.count()));
+    for (size_t i = 0; i < count; ++i) {
+      auto* bot = static_cast<Bot*>(events[i].data);
+      const auto open =
+          events[i].readable ? bot->receive(stats) : !events[i].closed;
+      if (!open) disconnect(bot);
+    }
+
+    if (!scheduler.poll()) continue;
+
+    connect();
+    size_t i = 0;
+    while (i < alive.size()) {
+      auto* bot = alive[i];
+      const auto budget = bot->identified()
+                              ? kSlowReadBytes
+                              : std::numeric_limits<size_t>::max();
+      bot->receiveDatagrams(stats);
+      if ((bot->slow() && !bot->receive(stats, budget)) ||
+          !bot->tick(scheduler.ticks(), options.shootRate, random, stats)) {
+        disconnect(bot);
+        continue;
+      }
+
+      // The bot leaves and connects again right away, so the server releases
+      // one client while it adopts the next:
+      if (options.churn != 0 && bot->age() >= options.churn) {
+        if (!rejoin(bot)) {
+          disconnect(bot);
+          continue;
+        }
+        ++stats.rejoins;
+      }
+
+      ++i;
+    }
+
+    std::lock_guard<std::mutex> guard(worker.mutex);
+    worker.stats.take(stats);
+  }
+}
+
+/**
+ * \brief Gets a percentile of sorted samples.
+ */
+float percentile(const std::vector<float>& sorted, double fraction) noexcept {
+  if (sorted.empty()) return 0.f;
+  const auto index =
+      static_cast<size_t>(fraction * static_cast<double>(sorted.size()));
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+/**
+ * \brief Reads the processor time a process used so far, in user and kernel
+ * mode.
+ * \return Whether or not it could be read, only Linux exposes it.
+ */
+bool processorTime(int32_t pid, double* seconds) noexcept {
+#if __linux__
+  char path[32];
+  snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+  auto* file = std::fopen(path, "r");
+  if (!file) return false;
+
+  char line[1024];
+  const auto read = std::fgets(line, sizeof(line), file) != nullptr;
+  std::fclose(file);
+  if (!read) return false;
+
+  // The name of the process may hold spaces, so the fields are counted from
+  // the parenthesis that closes it, the 14th and 15th being the times:
+  const auto* fields = std::strrchr(line, ')');
+  unsigned long long user, system;
+  if (!fields || sscanf(fields + 1,
+                        " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu "
+                        "%llu",
+                        &user, &system) != 2) {
+    return false;
+  }
+
+  *seconds = static_cast<double>(user + system) /
+             static_cast<double>(sysconf(_SC_CLK_TCK));
+  return true;
+#else
+  static_cast<void>(pid);
+  static_cast<void>(seconds);
+  return false;
+#endif
+}
+
+/**
+ * \param processor The share of a core the server used, negative when it is
+ * not measured.
+ * \param slow The slow readers still connected, out of slowReaders.
+ */
+void report(const char* label, stats_t& stats, double seconds,
+            size_t connected, size_t bots, double processor, size_t slow,
+            size_t slowReaders) noexcept {
+  char usage[32] = "";
+  if (processor >= 0.0) {
+    snprintf(usage, sizeof(usage), ", server CPU %.0f%%", processor * 100.0);
+  }
+
+  char churn[64] = "";
+  if (stats.rejoins != 0) {
+    snprintf(churn, sizeof(churn), ", %llu rejoin(s) and %llu identified",
+             static_cast<unsigned long long>(stats.rejoins),
+             static_cast<unsigned long long>(stats.identified));
+  }
+
+  // The server drops the updates of a slow reader, which gets a snapshot
+  // now and then, and evicts it once the messages it cannot drop pile up:
+  char readers[96] = "";
+  if (slowReaders != 0) {
+    snprintf(readers, sizeof(readers),
+             ", %zu/%zu slow reader(s) got %llu snapshot(s) and %llu evicted",
+             slow, slowReaders,
+             static_cast<unsigned long long>(stats.slowSnapshots),
+             static_cast<unsigned long long>(stats.evictions));
+  }
+
+  std::sort(stats.latencies.begin(), stats.latencies.end());
+  printf(
+      "[LOAD] %s: %zu/%zu bot(s)%s%s%s, out %.0f msg/s (%.1f KiB/s), in %.0f "
+      "msg/s (%.1f KiB/s), round trip p50 %.2fms p90 %.2fms p99 %.2fms max "
+      "%.2fms, dropped %llu snapshot(s), %llu ping(s) and %llu connection(s), "
+      "%llu message(s) never sent.\n",
+      label, connected, bots, usage, churn, readers,
+      static_cast<double>(stats.messagesOut) / seconds,
+      static_cast<double>(stats.bytesOut) / seconds / 1024.0,
+      static_cast<double>(stats.messagesIn) / seconds,
+      static_cast<double>(stats.bytesIn) / seconds / 1024.0,
+      percentile(stats.latencies, 0.5), percentile(stats.latencies, 0.9),
+      percentile(stats.latencies, 0.99),
+      stats.latencies.empty() ? 0.f : stats.latencies.back(),
+      static_cast<unsigned long long>(stats.snapshotsMissed),
+      static_cast<unsigned long long>(stats.pingsLost),
+      static_cast<unsigned long long>(stats.disconnections),
+      static_cast<unsigned long long>(stats.messagesBlocked));
+}
+
+bool parse(int argc, char** argv, options_t* options) noexcept {
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    const auto separator = argument.find('=');
+    if (argument.rfind("--", 0) != 0 || separator == std::string::npos) {
+      return false;
+    }
+
+    const auto name = argument.substr(2, separator - 2);
+    const auto* value = argv[i] + separator + 1;
+    if (name == "address") {
+      uint32_t a, b, c, d;
+      if (sscanf(value, "%u.%u.%u.%u", &a, &b, &c, &d) != 4 || a > 255 ||
+          b > 255 || c > 255 || d > 255) {
+        return false;
+      }
+      options->address = a << 24u | b << 16u | c << 8u | d;
+    } else if (name == "port") {
+      options->port = static_cast<uint16_t>(std::strtoul(value, nullptr, 10));
+    } else if (name == "bots") {
+      options->bots = std::strtoul(value, nullptr, 10);
+    } else if (name == "shoot-rate") {
+      options->shootRate = std::strtod(value, nullptr);
+    } else if (name == "seconds") {
+      options->seconds =
+          static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    } else if (name == "threads") {
+      options->threads = std::max<size_t>(std::strtoul(value, nullptr, 10), 1);
+    } else if (name == "ramp") {
+      options->ramp = std::strtod(value, nullptr);
+    } else if (name == "server-pid") {
+      options->serverPid =
+          static_cast<int32_t>(std::strtol(value, nullptr, 10));
+    } else if (name == "churn") {
+      options->churn = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    } else if (name == "slow-readers") {
+      options->slowReaders = std::strtoul(value, nullptr, 10);
+    } else if (name == "datagrams") {
+      options->datagrams = std::strtoul(value, nullptr, 10) != 0;
+    } else {
+      return false;
+    }
+  }
+
+  return true;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  options_t options{};
+  if (!parse(argc, argv, &options)) {
+    std::cerr << "Usage: LoadGenerator [--address=127.0.0.1] [--port=9999] "
+                 "[--bots=64] [--shoot-rate=1] [--seconds=30] "
+                 "[--threads=1] [--ramp=0] [--server-pid=0] "
+                 "[--churn=0] [--slow-readers=0] [--datagrams=0]\n";
+    return EXIT_FAILURE;
+  }
+
+#if _WIN32
+  WSADATA data;
+  if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+    std::cerr << "WSAStartup: " << Socket::lastError() << '\n';
+    return EXIT_FAILURE;
+  }
+#endif
+
+  printf(
+      "[LOAD] Connecting %zu bot(s) from %zu thread(s), each shooting %.2f "
+      "time(s) per second.\n",
+      options.bots, options.threads, options.shootRate);
+  if (options.ramp > 0.0) {
+    printf("[LOAD] Ramping up by %.1f bot(s) per second.\n", options.ramp);
+  }
+  if (options.churn != 0) {
+    printf("[LOAD] Every bot reconnects %u tick(s) after it is identified.\n",
+           options.churn);
+  }
+  if (options.slowReaders != 0) {
+    printf("[LOAD] The first %zu bot(s) read %zu byte(s) per tick.\n",
+           options.slowReaders, kSlowReadBytes);
+  }
+  if (options.datagrams) {
+    printf("[LOAD] Every bot binds a UDP socket once identified.\n");
+  }
+
+  double processorStart = 0.0;
+  if (options.serverPid != 0 &&
+      !processorTime(options.serverPid, &processorStart)) {
+    std::cerr << "Could not read the processor time of process "
+              << options.serverPid << ".\n";
+    return EXIT_FAILURE;
+  }
+
+  // Spread the pings and the shots of the bots over the ticks:
+  std::vector<std::unique_ptr<worker_t>> workers;
+  for (size_t i = 0; i < options.threads; ++i) {
+    workers.push_back(std::make_unique<worker_t>());
+    workers.back()->index = i;
+    workers.back()->stride = options.threads;
+  }
+  for (size_t i = 0; i < options.bots; ++i) {
+    workers[i % workers.size()]->bots.push_back(std::make_unique<Bot>(
+        static_cast<uint32_t>(i),
+        static_cast<double>(i % kUploadRate) / kUploadRate,
+        i < options.slowReaders, options.datagrams));
+  }
+
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> threads;
+  for (auto& worker : workers) {
+    threads.emplace_back([&worker = *worker, &options, &stop]() {
+      drive(worker, options, stop);
+    });
+  }
+
+  const auto collect = [&workers](stats_t* stats, size_t* connected,
+                                  size_t* slow) {
+    *connected = 0;
+    *slow = 0;
+    for (auto& worker : workers) {
+      std::lock_guard<std::mutex> guard(worker->mutex);
+      stats->take(worker->stats);
+      *connected += worker->connected.load(std::memory_order_relaxed);
+      *slow += worker->slow.load(std::memory_order_relaxed);
+    }
+  };
+
+  // The share of a core the server used since the previous call:
+  auto processorPrevious = processorStart;
+  const auto processor = [&options, &processorPrevious](double seconds) {
+    double now;
+    if (options.serverPid == 0 || !processorTime(options.serverPid, &now)) {
+      return -1.0;
+    }
+
+    const auto share = (now - processorPrevious) / seconds;
+    processorPrevious = now;
+    return share;
+  };
+
+  stats_t total{};
+  size_t connected = 0;
+  size_t slow = 0;
+  const auto start = TickScheduler::clock::now();
+  for (uint32_t second = 1; second <= options.seconds; ++second) {
+    std::this_thread::sleep_until(start + std::chrono::seconds(second));
+
+    stats_t stats{};
+    collect(&stats, &connected, &slow);
+    report(std::to_string(second).append("s").c_str(), stats, 1.0, connected,
+           options.bots, processor(1.0), slow, options.slowReaders);
+    total.take(stats);
+  }
+
+  stop.store(true, std::memory_order_relaxed);
+  for (auto& thread : threads) thread.join();
+
+  const auto seconds = std::max(options.seconds, 1u);
+  processorPrevious = processorStart;
+  report("Total", total, seconds, connected, options.bots,
+         processor(seconds), slow, options.slowReaders);
+
+  // Every bot the server identified must have been bound through UDP too,
+  // with the ID and the token it was identified with:
+  if (options.datagrams) {
+    printf("[LOAD] %llu of %llu identified bot(s) bound their datagrams.\n",
+           static_cast<unsigned long long>(total.bound),
+           static_cast<unsigned long long>(total.identified));
+    if (total.bound < total.identified) {
+#if _WIN32
+      WSACleanup();
+#endif
+      return EXIT_FAILURE;
+    }
+  }
+
+#if _WIN32
+  WSACleanup();
+#endif
+  return EXIT_SUCCESS;
+}
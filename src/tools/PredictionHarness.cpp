@@ -0,0 +1,182 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+// Plays a scripted walk of the local player against a model of the server,
+// which applies the reported positions a latency later, steers the player
+// towards them as Simulation does, and stops it at a wall the client does not
+// know about, so the server has to correct it. The walk is played three times,
+// reacting to the corrections the way the client did before prediction, by
+// replaying and snapping, and by replaying and smoothing, and compares how far
+// the player jumped in a single frame, the corrections received and the final
+// error:
+//
+// PredictionHarness [latency ms] [jitter ms] [seed]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+
+#include "networking/Prediction.h"
+#include "utils/Vector2.h"
+
+namespace {
+constexpr float kFrameRate = 60.f;
+constexpr float kDelta = 1.f / kFrameRate;
+
+/**
+ * \brief The speed of the player in the menu scene.
+ */
+constexpr float kSpeed = 100.f;
+
+/**
+ * \brief Mirror Simulation's constants.
+ */
+constexpr float kSpeedTolerance = 2.f;
+constexpr float kCorrectionDistance = 8.f;
+
+/**
+ * \brief Where the wall only the server knows about stands.
+ */
+constexpr float kWall = 150.f;
+
+/**
+ * \brief The seconds the walk lasts, and the input in each second of it.
+ */
+constexpr uint32_t kSeconds = 6;
+const Vector2<float> kScript[kSeconds] = {
+    {1.f, 0.f}, {1.f, 0.f}, {0.f, 1.f}, {-1.f, 0.f}, {-1.f, -1.f}, {0.f, 0.f}};
+
+enum class Mode : uint8_t { kFollow, kSnap, kSmooth };
+
+struct message_t {
+  float time;
+  uint32_t sequence;
+  Vector2<float> position;
+};
+
+struct result_t {
+  float largestJump{0.f};
+  uint32_t corrections{0};
+  float finalError{0.f};
+};
+
+/**
+ * \brief Delivers the messages in order, as the stream they travel through
+ * does, each of them no earlier than the latency and its jitter allow.
+ */
+class Link final {
+  std::deque<message_t> messages_{};
+  std::mt19937& random_;
+  std::uniform_real_distribution<float> jitter_;
+  float latency_;
+  float last_{0.f};
+
+ public:
+  Link(std::mt19937& random, float latency, float jitter) noexcept
+      : random_(random), jitter_(0.f, jitter), latency_(latency) {}
+
+  void send(float time, uint32_t sequence,
+            const Vector2<float>& position) noexcept {
+    last_ = std::max(last_, time + latency_ + jitter_(random_));
+    messages_.push_back({last_, sequence, position});
+  }
+
+  template <typename Callable>
+  void receive(float time, Callable&& callable) noexcept {
+    while (!messages_.empty() && messages_.front().time <= time) {
+      callable(messages_.front());
+      messages_.pop_front();
+    }
+  }
+};
+
+result_t play(Mode mode, float latency, float jitter,
+              uint32_t seed) noexcept {
+  std::mt19937 random{seed};
+  Link upload{random, latency, jitter};
+  Link download{random, latency, jitter};
+  Prediction prediction{};
+  result_t result{};
+
+  Vector2<float> client{};
+  Vector2<float> server{};
+  Vector2<float> target{};
+  uint32_t sequence = 0;
+
+  const auto frames = static_cast<uint32_t>(kSeconds * kFrameRate);
+  for (uint32_t frame = 0; frame < frames; ++frame) {
+    const auto time = static_cast<float>(frame) * kDelta;
+
+    // The server steps once per frame, so both run at the same rate:
+    upload.receive(time, [&](const message_t& message) {
+      sequence = message.sequence;
+      target = message.position;
+    });
+    const auto difference = target - server;
+    const auto distance = difference.magnitude();
+    const auto maximumDistance = kSpeed * kSpeedTolerance * kDelta;
+    server = distance > maximumDistance
+                 ? server + difference * (maximumDistance / distance)
+                 : target;
+    server = Vector2<float>{std::min(server.x(), kWall), server.y()};
+    if ((target - server).magnitude() > kCorrectionDistance) {
+      download.send(time, sequence, server);
+    }
+
+    const auto previous = client;
+    download.receive(time, [&](const message_t& message) {
+      ++result.corrections;
+      if (mode == Mode::kFollow) {
+        client = message.position;
+      } else {
+        prediction.reconcile(message.sequence, message.position, client);
+      }
+    });
+
+    const auto input = kScript[frame / static_cast<uint32_t>(kFrameRate)];
+    const auto magnitude = input.magnitude();
+    const auto velocity =
+        magnitude == 0.f ? Vector2<float>{} : input * kSpeed / magnitude;
+    client = client + velocity * kDelta;
+    if (mode != Mode::kFollow) {
+      // Snapping takes the whole error at once:
+      client = client + prediction.smooth(mode == Mode::kSnap ? 1.f : kDelta);
+    }
+
+    const auto jump = (client - previous - velocity * kDelta).magnitude();
+    result.largestJump = std::max(result.largestJump, jump);
+    upload.send(time, prediction.record(velocity, kDelta), client);
+  }
+
+  result.finalError = (client - server).magnitude();
+  return result;
+}
+
+void report(const char* label, const result_t& result) noexcept {
+  printf("[PREDICTION] %-18s %8.2f %12u %12.2f\n", label,
+         static_cast<double>(result.largestJump), result.corrections,
+         static_cast<double>(result.finalError));
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const auto latency =
+      static_cast<float>(argc >= 2 ? std::strtoul(argv[1], nullptr, 10) : 100);
+  const auto jitter =
+      static_cast<float>(argc >= 3 ? std::strtoul(argv[2], nullptr, 10) : 20);
+  const auto seed = static_cast<uint32_t>(
+      argc >= 4 ? std::strtoul(argv[3], nullptr, 10) : 1);
+
+  printf("[PREDICTION] %.0fms latency, up to %.0fms of jitter each way:\n",
+         static_cast<double>(latency), static_cast<double>(jitter));
+  printf("[PREDICTION] %-18s %8s %12s %12s\n", "", "Jump", "Corrections",
+         "Final error");
+  report("Follow:",
+         play(Mode::kFollow, latency / 1000.f, jitter / 1000.f, seed));
+  report("Replay and snap:",
+         play(Mode::kSnap, latency / 1000.f, jitter / 1000.f, seed));
+  report("Replay and smooth:",
+         play(Mode::kSmooth, latency / 1000.f, jitter / 1000.f, seed));
+  return 0;
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+// Measures what lag compensation costs a room: recording the hitboxes of its
+// players every tick, and rewinding a shot through them the way
+// Simulation::shoot() does, one bullet step per tick through the ticks the
+// shooter saw, up to the first hitbox it goes through. Every player wanders,
+// so each recorded tick differs from the previous one:
+//
+// RewindBenchmark [players] [rewind ticks] [shots]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "networking/HitboxHistory.h"
+#include "utils/Vector2.h"
+
+namespace {
+/**
+ * \brief Mirror Simulation's constants, and the size of the players of the
+ * menu scene.
+ */
+constexpr float kBulletStep = b2_maxTranslation;
+constexpr float kBulletSize = 8.f;
+constexpr float kPlayerSize = 32.f;
+
+/**
+ * \brief How far from the origin the players are spread, a few screens in
+ * every direction.
+ */
+constexpr float kSpread = 1024.f;
+
+/**
+ * \brief How far a player wanders per tick, the speed of the players of the
+ * menu scene at 60 Hz.
+ */
+constexpr float kWanderStep = 100.f / 60.f;
+
+/**
+ * \brief Measures the average time of a callable, in nanoseconds.
+ */
+template <typename Callable>
+double measure(uint32_t iterations, Callable&& callable) noexcept {
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; ++i) callable(i);
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const auto players = static_cast<uint32_t>(
+      argc >= 2 ? std::strtoul(argv[1], nullptr, 10) : 64);
+  const auto rewind = std::min<uint32_t>(
+      static_cast<uint32_t>(argc >= 3 ? std::strtoul(argv[2], nullptr, 10)
+                                      : 30),
+      HitboxHistory::kCapacity - 1);
+  const auto shots = static_cast<uint32_t>(
+      argc >= 4 ? std::strtoul(argv[3], nullptr, 10) : 100000);
+
+  std::mt19937 random{1};
+  std::uniform_real_distribution<float> coordinate{-kSpread, kSpread};
+  std::uniform_real_distribution<float> aim{-3.14159265f, 3.14159265f};
+
+  std::vector<Vector2<float>> positions;
+  std::vector<float> headings;
+  for (uint32_t i = 0; i < players; ++i) {
+    positions.push_back({coordinate(random), coordinate(random)});
+    headings.push_back(aim(random));
+  }
+
+  HitboxHistory history{};
+  history.extent({kPlayerSize / 2.f, kPlayerSize / 2.f});
+
+  // Fill the whole history first, so recording a tick does not grow it:
+  uint32_t tick = 0;
+  const auto record = [&](uint32_t) {
+    history.begin(tick);
+    for (uint32_t i = 0; i < players; ++i) {
+      headings[i] += 0.1f;
+      positions[i] = Vector2<float>{
+          positions[i].x() + std::cos(headings[i]) * kWanderStep,
+          positions[i].y() + std::sin(headings[i]) * kWanderStep};
+      history.add(tick, i, positions[i]);
+    }
+    ++tick;
+  };
+  for (size_t i = 0; i < HitboxHistory::kCapacity; ++i) record(0);
+  const auto recording = measure(shots, record);
+
+  // Each shot leaves a random player towards a random direction, and is
+  // swept through the last ticks as Simulation::shoot() does:
+  const Vector2<float> size{kBulletSize / 2.f, kBulletSize / 2.f};
+  const auto now = tick - 1;
+  uint64_t hits = 0;
+  uint64_t sweeps = 0;
+  const auto shoot = [&](uint32_t shot) {
+    const auto shooter = shot % players;
+    const auto angle = aim(random);
+    const Vector2<float> direction{std::cos(angle), std::sin(angle)};
+    const auto start = positions[shooter] + direction * kPlayerSize;
+
+    HitboxHistory::hit_t hit{};
+    for (uint32_t i = 0; i < rewind; ++i) {
+      const auto past = now - rewind + i;
+      const auto from = kBulletStep * static_cast<float>(i);
+      ++sweeps;
+      if (history.sweep(past, start + direction * from,
+                        start + direction * (from + kBulletStep), size,
+                        shooter, &hit)) {
+        ++hits;
+        return;
+      }
+    }
+  };
+  const auto shooting = measure(shots, shoot);
+
+  printf("[REWIND] %u player(s), rewinding %u tick(s) of %zu kept:\n",
+         players, rewind, HitboxHistory::kCapacity);
+  printf("[REWIND] %-10s %9.1f ns per tick\n", "Record:", recording);
+  printf("[REWIND] %-10s %9.1f ns per shot, %.1f ns per tick swept\n",
+         "Rewind:", shooting,
+         shooting * static_cast<double>(shots) /
+             static_cast<double>(std::max<uint64_t>(sweeps, 1)));
+  printf("[REWIND] %llu of %u shot(s) hit a player.\n",
+         static_cast<unsigned long long>(hits), shots);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,211 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+// Compares the quantized wire format of positions and angles against the raw
+// floats it replaced: the size of every message that carries them, the size
+// of a room's snapshot, the time it takes to encode and decode one, and the
+// precision lost on the way:
+//
+// SerializerBenchmark [players] [bullets] [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "networking/Protocol.h"
+#include "networking/Snapshot.h"
+#include "utils/Buffer.h"
+
+namespace {
+/**
+ * \brief The size of an updated entry when positions were two raw floats.
+ */
+constexpr size_t kRawEntrySize =
+    Snapshot::kRemovedEntrySize + sizeof(float) * 2;
+
+/**
+ * \brief How far from the origin the entities are spread, the interest area
+ * of a room is a few screens wide.
+ */
+constexpr float kSpread = 2048.f;
+
+/**
+ * \brief The rate at which a client receives snapshots.
+ */
+constexpr double kSnapshotRate = 60.0;
+
+// The reference codec, the way Snapshot wrote and read the entries of a full
+// snapshot before the positions were quantized:
+void encodeRaw(const Snapshot::entities_t& entities,
+               std::vector<uint8_t>* entries) noexcept {
+  static const Snapshot::entities_t empty{};
+  Buffer buffer{};
+  Snapshot::diff(
+      empty, entities,
+      [&](const Snapshot::entity_t& entity) {
+        const auto offset = entries->size();
+        entries->resize(offset + kRawEntrySize);
+        auto* entry = entries->data() + offset;
+        buffer.writeUint8(
+            entry, static_cast<uint8_t>(Snapshot::type(entity.key)), 0);
+        buffer.writeUint32(entry, Snapshot::id(entity.key), sizeof(uint8_t));
+        buffer.writeFloat(entry, entity.position.x(),
+                          Snapshot::kRemovedEntrySize);
+        buffer.writeFloat(entry, entity.position.y(),
+                          Snapshot::kRemovedEntrySize + sizeof(float));
+      },
+      [](uint64_t) {});
+}
+
+bool decodeRaw(const std::vector<uint8_t>& entries,
+               Snapshot::entities_t* entities) noexcept {
+  Buffer buffer{};
+  entities->clear();
+
+  bool first = true;
+  uint64_t previous = 0;
+  for (size_t offset = 0; offset != entries.size(); offset += kRawEntrySize) {
+    if (kRawEntrySize > entries.size() - offset) return false;
+
+    const auto* entry = entries.data() + offset;
+    const auto key =
+        Snapshot::key(static_cast<Snapshot::EntityType>(entry[0]),
+                      buffer.readUInt32(entry, sizeof(uint8_t)));
+    if (!first && key <= previous) return false;
+    first = false;
+    previous = key;
+
+    entities->push_back(
+        {key,
+         {buffer.readFloat(entry, Snapshot::kRemovedEntrySize),
+          buffer.readFloat(entry,
+                           Snapshot::kRemovedEntrySize + sizeof(float))}});
+  }
+
+  return true;
+}
+
+/**
+ * \brief Measures the average time of a callable, in nanoseconds.
+ */
+template <typename Callable>
+double measure(uint32_t iterations, Callable&& callable) noexcept {
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; ++i) callable();
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+void compare(const char* label, size_t raw, size_t quantized) noexcept {
+  printf("[SERIALIZER] %-22s %6zu -> %6zu bytes (%.1f%% smaller)\n", label, raw,
+         quantized,
+         (1.0 - static_cast<double>(quantized) / static_cast<double>(raw)) *
+             100.0);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const auto players = argc >= 2 ? std::strtoul(argv[1], nullptr, 10) : 64;
+  const auto bullets = argc >= 3 ? std::strtoul(argv[2], nullptr, 10) : 256;
+  const auto iterations = static_cast<uint32_t>(
+      argc >= 4 ? std::strtoul(argv[3], nullptr, 10) : 2000);
+
+  std::mt19937 random{1};
+  std::uniform_real_distribution<float> coordinate{-kSpread, kSpread};
+  std::uniform_real_distribution<float> aim{-3.14159265f, 3.14159265f};
+
+  Snapshot::entities_t entities;
+  for (uint32_t i = 0; i < players; ++i) {
+    entities.push_back({Snapshot::key(Snapshot::EntityType::kPlayer, i),
+                        {coordinate(random), coordinate(random)}});
+  }
+  for (uint32_t i = 0; i < bullets; ++i) {
+    entities.push_back({Snapshot::key(Snapshot::EntityType::kBullet, i),
+                        {coordinate(random), coordinate(random)}});
+  }
+
+  // The messages a client and the server exchange about movement and shots,
+  // headers included:
+  constexpr auto header = Protocol::kHeaderSize;
+  compare("Update position:", header + sizeof(uint32_t) + sizeof(float) * 2,
+          header + sizeof(uint32_t) + Protocol::kPositionSize);
+  compare("Bullet shoot:", header + sizeof(float),
+          header + Protocol::kAngleSize);
+  constexpr auto ids = sizeof(uint32_t) * 2;
+  compare("Position correction:", header + ids + sizeof(float) * 2,
+          header + ids + Protocol::kPositionSize);
+
+  std::vector<uint8_t> raw;
+  std::vector<uint8_t> quantized;
+  encodeRaw(entities, &raw);
+  Snapshot::encode(nullptr, entities, &quantized);
+
+  const auto frames = [](size_t size) {
+    const auto parts =
+        (size + Snapshot::kMaximumPartSize - 1) / Snapshot::kMaximumPartSize;
+    return size + parts * (Protocol::kHeaderSize + Snapshot::kHeaderSize);
+  };
+
+  printf("[SERIALIZER] A snapshot of %lu player(s) and %lu bullet(s):\n",
+         players, bullets);
+  compare("Entries:", raw.size(), quantized.size());
+  compare("Frames:", frames(raw.size()), frames(quantized.size()));
+  printf("[SERIALIZER] %-22s %6.1f -> %6.1f KiB/s per client\n", "Bandwidth:",
+         static_cast<double>(frames(raw.size())) * kSnapshotRate / 1024.0,
+         static_cast<double>(frames(quantized.size())) * kSnapshotRate /
+             1024.0);
+
+  Snapshot::entities_t decoded;
+  const auto rawEncode = measure(iterations, [&]() {
+    raw.clear();
+    encodeRaw(entities, &raw);
+  });
+  const auto quantizedEncode = measure(iterations, [&]() {
+    quantized.clear();
+    Snapshot::encode(nullptr, entities, &quantized);
+  });
+  const auto rawDecode = measure(iterations, [&]() {
+    static_cast<void>(decodeRaw(raw, &decoded));
+  });
+  const auto quantizedDecode = measure(iterations, [&]() {
+    static_cast<void>(Snapshot::decode(nullptr, quantized.data(),
+                                       quantized.size(), &decoded));
+  });
+
+  const auto count = static_cast<double>(entities.size());
+  printf(
+      "[SERIALIZER] %-22s %6.1f -> %6.1f ns per entity\n"
+      "[SERIALIZER] %-22s %6.1f -> %6.1f ns per entity\n",
+      "Encode:", rawEncode / count, quantizedEncode / count,
+      "Decode:", rawDecode / count, quantizedDecode / count);
+
+  // The precision lost to quantization, at most half a step:
+  float positionError = 0.f;
+  for (size_t i = 0; i < entities.size(); ++i) {
+    positionError = std::max(
+        {positionError,
+         std::abs(entities[i].position.x() - decoded[i].position.x()),
+         std::abs(entities[i].position.y() - decoded[i].position.y())});
+  }
+
+  float angleError = 0.f;
+  uint8_t angle[Protocol::kAngleSize];
+  for (uint32_t i = 0; i < iterations; ++i) {
+    const auto value = aim(random);
+    Protocol::writeAngle(angle, value, 0);
+    auto error = std::abs(Protocol::readAngle(angle, 0) - value);
+    error = std::min(error, 6.28318531f - error);
+    angleError = std::max(angleError, error);
+  }
+
+  printf(
+      "[SERIALIZER] Largest error: %.4f units on positions, %.5f degrees on "
+      "angles.\n",
+      static_cast<double>(positionError),
+      static_cast<double>(angleError) * 180.0 / 3.14159265);
+  return EXIT_SUCCESS;
+}
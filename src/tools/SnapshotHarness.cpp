@@ -0,0 +1,416 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+// Measures the bytes per tick of a room's snapshots, the way
+// Server::Room::broadcastSnapshot() builds them: every client is sent the
+// entities around its player, delta-encoded against the last snapshot it
+// acknowledged, and split in parts that fit a frame. The parts cross a link
+// that loses some of them, and the acknowledgements of the snapshots that
+// arrive whole reach the server a few ticks late. The room is played with
+// every player moving, with a quarter of them and with the world idle, and
+// every snapshot a client decodes is checked against the view it was built
+// from:
+//
+// SnapshotHarness [players] [loss %] [ack delay ticks] [seconds] [seed]
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "networking/InterestGrid.h"
+#include "networking/Protocol.h"
+#include "networking/Snapshot.h"
+#include "utils/Vector2.h"
+
+namespace {
+/**
+ * \brief Mirror Server's constants.
+ */
+constexpr uint32_t kTickRate = 60;
+constexpr uint32_t kSnapshotInterval = kTickRate / 20;
+constexpr float kInterestWidth = 640.f;
+constexpr float kInterestHeight = 480.f;
+constexpr float kInterestMargin = 64.f;
+
+/**
+ * \brief How far from the origin the entities are spread, a few areas of
+ * interest in every direction.
+ */
+constexpr float kSpread = 2048.f;
+
+/**
+ * \brief The speeds of the players in the menu scene and of their bullets,
+ * in units per second.
+ */
+constexpr float kPlayerSpeed = 100.f;
+constexpr float kBulletSpeed = 400.f;
+
+constexpr uint32_t kBullets = 8;
+constexpr uint32_t kWalls = 32;
+
+/**
+ * \brief The ticks played before the bytes are counted, so the full
+ * snapshots every client starts with do not weigh on the steady state.
+ */
+constexpr uint32_t kWarmUpTicks = kTickRate;
+
+struct view_t {
+  uint32_t tick{Snapshot::kNoBase};
+  Snapshot::entities_t entities{};
+};
+
+using history_t = std::array<view_t, Snapshot::kHistorySize>;
+
+const view_t* findView(const history_t& history, uint32_t tick,
+                       uint32_t now) noexcept {
+  if (tick == Snapshot::kNoBase || now - tick >= history.size()) {
+    return nullptr;
+  }
+
+  const auto& view = history[tick % history.size()];
+  return view.tick == tick ? &view : nullptr;
+}
+
+/**
+ * \brief Gets the bytes of the frames the server splits the entries of a
+ * snapshot in, cutting the parts at entry boundaries.
+ */
+size_t frame(const std::vector<uint8_t>& entries, size_t* parts) noexcept {
+  size_t bytes = 0;
+  size_t end = 0;
+  *parts = 0;
+  do {
+    const auto start = end;
+    while (end != entries.size()) {
+      const auto length = Snapshot::entrySize(entries.data() + end);
+      if (end + length - start > Snapshot::kMaximumPartSize) break;
+      end += length;
+    }
+    bytes += Protocol::kHeaderSize + Snapshot::kHeaderSize + end - start;
+    ++*parts;
+  } while (end != entries.size());
+
+  return bytes;
+}
+
+struct client_t {
+  // What the server sent, and what the client decoded, by tick:
+  history_t views{};
+  history_t decoded{};
+  uint32_t acknowledged{Snapshot::kNoBase};
+};
+
+struct acknowledgement_t {
+  uint32_t arrival;
+  size_t client;
+  uint32_t tick;
+};
+
+struct result_t {
+  uint64_t bytes{0};
+  uint64_t fullBytes{0};
+  uint64_t sent{0};
+  uint64_t full{0};
+  uint64_t skipped{0};
+  uint64_t lost{0};
+  uint64_t mismatched{0};
+  uint32_t ticks{0};
+};
+
+class Room final {
+  std::mt19937 random_;
+  std::vector<Vector2<float>> players_{};
+  std::vector<float> headings_{};
+  std::vector<Vector2<float>> bullets_{};
+  std::vector<float> bulletHeadings_{};
+  std::vector<Vector2<float>> walls_{};
+  Snapshot::entities_t world_{};
+  InterestGrid grid_{};
+  std::vector<uint32_t> visible_{};
+  std::vector<client_t> clients_{};
+  std::deque<acknowledgement_t> acknowledgements_{};
+  std::vector<uint8_t> entries_{};
+  std::vector<uint8_t> full_{};
+  std::vector<uint8_t> received_{};
+  Snapshot::entities_t expected_{};
+
+  [[nodiscard]] float coordinate() noexcept {
+    return std::uniform_real_distribution<float>{-kSpread, kSpread}(random_);
+  }
+
+  [[nodiscard]] float angle() noexcept {
+    return std::uniform_real_distribution<float>{-3.14159265f,
+                                                 3.14159265f}(random_);
+  }
+
+  static void advance(Vector2<float>& position, float heading,
+                      float speed) noexcept {
+    // The entities wrap around the edges of the world:
+    const auto wrap = [](float value) {
+      if (value > kSpread) return value - kSpread * 2.f;
+      if (value < -kSpread) return value + kSpread * 2.f;
+      return value;
+    };
+    position = Vector2<float>{
+        wrap(position.x() + std::cos(heading) * speed / kTickRate),
+        wrap(position.y() + std::sin(heading) * speed / kTickRate)};
+  }
+
+  void capture() {
+    // Built in key order, the players, then the bullets and then the walls:
+    world_.clear();
+    for (uint32_t i = 0; i < players_.size(); ++i) {
+      world_.push_back(
+          {Snapshot::key(Snapshot::EntityType::kPlayer, i), players_[i]});
+    }
+    for (uint32_t i = 0; i < bullets_.size(); ++i) {
+      world_.push_back(
+          {Snapshot::key(Snapshot::EntityType::kBullet, i), bullets_[i]});
+    }
+    for (uint32_t i = 0; i < walls_.size(); ++i) {
+      world_.push_back(
+          {Snapshot::key(Snapshot::EntityType::kWall, i), walls_[i]});
+    }
+  }
+
+  // As Server::Room::gatherView(), an entity that was sent is kept until it
+  // leaves the area of interest by more than the margin:
+  void gatherView(size_t player, const view_t* previous,
+                  Snapshot::entities_t* view) {
+    const auto& center = players_[player];
+    const Vector2<float> extent{kInterestWidth, kInterestHeight};
+    grid_.query(center,
+                {kInterestWidth + kInterestMargin,
+                 kInterestHeight + kInterestMargin},
+                &visible_);
+
+    view->clear();
+    Snapshot::entities_t::const_iterator sent{};
+    Snapshot::entities_t::const_iterator end{};
+    if (previous) {
+      sent = previous->entities.begin();
+      end = previous->entities.end();
+    }
+
+    for (const auto index : visible_) {
+      const auto& entity = world_[index];
+      while (sent != end && sent->key < entity.key) ++sent;
+      if ((sent != end && sent->key == entity.key) ||
+          InterestGrid::contains(center, extent, entity.position)) {
+        view->push_back(entity);
+      }
+    }
+  }
+
+  // The client decodes the entries against its copy of the base, which must
+  // give back the view the server encoded, quantized:
+  bool receive(client_t& client, uint32_t tick, uint32_t base,
+               const view_t& view) {
+    const auto* from = findView(client.decoded, base, tick);
+    if (base != Snapshot::kNoBase && !from) return false;
+
+    auto& decoded = client.decoded[tick % client.decoded.size()];
+    decoded.tick = tick;
+    if (!Snapshot::decode(from ? &from->entities : nullptr, entries_.data(),
+                          entries_.size(), &decoded.entities)) {
+      return false;
+    }
+
+    received_.clear();
+    Snapshot::encode(nullptr, view.entities, &received_);
+    if (!Snapshot::decode(nullptr, received_.data(), received_.size(),
+                          &expected_) ||
+        expected_.size() != decoded.entities.size()) {
+      return false;
+    }
+
+    for (size_t i = 0; i < expected_.size(); ++i) {
+      const auto& a = expected_[i];
+      const auto& b = decoded.entities[i];
+      if (a.key != b.key || a.position.x() != b.position.x() ||
+          a.position.y() != b.position.y()) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  void broadcastSnapshot(uint32_t tick, double loss, uint32_t delay,
+                         bool counted, result_t& result) {
+    capture();
+    grid_.build(world_);
+
+    std::uniform_real_distribution<double> chance{0.0, 1.0};
+    for (size_t i = 0; i < clients_.size(); ++i) {
+      auto& client = clients_[i];
+      const auto acknowledged = client.acknowledged;
+      const auto* base = findView(client.views, acknowledged, tick);
+      auto& current = client.views[tick % client.views.size()];
+      gatherView(i, findView(client.views, tick - kSnapshotInterval, tick),
+                 &current.entities);
+      current.tick = tick;
+
+      entries_.clear();
+      Snapshot::encode(base ? &base->entities : nullptr, current.entities,
+                       &entries_);
+
+      if (base && entries_.empty() &&
+          tick - acknowledged < Snapshot::kHistorySize / 2) {
+        if (counted) ++result.skipped;
+        continue;
+      }
+
+      // Each part may be lost on its own, which loses the whole snapshot:
+      size_t parts;
+      const auto bytes = frame(entries_, &parts);
+      bool whole = true;
+      for (size_t part = 0; part < parts; ++part) {
+        if (chance(random_) < loss) whole = false;
+      }
+
+      if (counted) {
+        full_.clear();
+        Snapshot::encode(nullptr, current.entities, &full_);
+        result.bytes += bytes;
+        result.fullBytes += frame(full_, &parts);
+        ++result.sent;
+        if (!base) ++result.full;
+        if (!whole) ++result.lost;
+      }
+
+      if (!whole) continue;
+      if (!receive(client, tick, base ? acknowledged : Snapshot::kNoBase,
+                   current)) {
+        ++result.mismatched;
+        continue;
+      }
+
+      // The acknowledgement crosses the same link:
+      if (chance(random_) >= loss) {
+        acknowledgements_.push_back({tick + delay, i, tick});
+      }
+    }
+  }
+
+ public:
+  Room(size_t players, uint32_t seed) : random_(seed), clients_(players) {
+    for (size_t i = 0; i < players; ++i) {
+      players_.push_back({coordinate(), coordinate()});
+      headings_.push_back(angle());
+    }
+    for (uint32_t i = 0; i < kBullets; ++i) {
+      bullets_.push_back({coordinate(), coordinate()});
+      bulletHeadings_.push_back(angle());
+    }
+    for (uint32_t i = 0; i < kWalls; ++i) {
+      walls_.push_back({coordinate(), coordinate()});
+    }
+  }
+
+  /**
+   * \brief Plays the room for a while.
+   * \param moving The share of the players that move, the bullets only fly
+   * when some do.
+   */
+  result_t play(double moving, double loss, uint32_t delay,
+                uint32_t ticks) {
+    result_t result{};
+    const auto walkers =
+        static_cast<size_t>(moving * static_cast<double>(players_.size()));
+    std::uniform_real_distribution<float> turn{-0.3f, 0.3f};
+    for (uint32_t tick = 0; tick < kWarmUpTicks + ticks; ++tick) {
+      while (!acknowledgements_.empty() &&
+             acknowledgements_.front().arrival <= tick) {
+        const auto& acknowledgement = acknowledgements_.front();
+        auto& client = clients_[acknowledgement.client];
+        if (client.acknowledged == Snapshot::kNoBase ||
+            acknowledgement.tick > client.acknowledged) {
+          client.acknowledged = acknowledgement.tick;
+        }
+        acknowledgements_.pop_front();
+      }
+
+      for (size_t i = 0; i < walkers; ++i) {
+        headings_[i] += turn(random_);
+        advance(players_[i], headings_[i], kPlayerSpeed);
+      }
+      if (walkers != 0) {
+        for (size_t i = 0; i < bullets_.size(); ++i) {
+          advance(bullets_[i], bulletHeadings_[i], kBulletSpeed);
+        }
+      }
+
+      if (tick % kSnapshotInterval == 0) {
+        broadcastSnapshot(tick, loss, delay, tick >= kWarmUpTicks, result);
+      }
+    }
+
+    result.ticks = ticks;
+    return result;
+  }
+};
+
+void report(const char* label, const result_t& result,
+            size_t players) noexcept {
+  const auto ticks = static_cast<double>(std::max(result.ticks, 1u));
+  const auto perTick = static_cast<double>(result.bytes) / ticks;
+  const auto perClient = perTick / static_cast<double>(std::max(players, 1lu));
+  printf(
+      "[SNAPSHOT] %-12s %7.0f bytes per tick, %5.0f per client (%.1f KiB/s), "
+      "%.0f%% of a full snapshot, %llu sent, %llu full, %llu skipped, %llu "
+      "lost\n",
+      label, perTick, perClient, perClient * kTickRate / 1024.0,
+      static_cast<double>(result.bytes) /
+          static_cast<double>(std::max<uint64_t>(result.fullBytes, 1)) *
+          100.0,
+      static_cast<unsigned long long>(result.sent),
+      static_cast<unsigned long long>(result.full),
+      static_cast<unsigned long long>(result.skipped),
+      static_cast<unsigned long long>(result.lost));
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const auto players = argc >= 2 ? std::strtoul(argv[1], nullptr, 10) : 64;
+  const auto loss =
+      (argc >= 3 ? std::strtod(argv[2], nullptr) : 10.0) / 100.0;
+  const auto delay = static_cast<uint32_t>(
+      argc >= 4 ? std::strtoul(argv[3], nullptr, 10) : 6);
+  const auto seconds = static_cast<uint32_t>(
+      argc >= 5 ? std::strtoul(argv[4], nullptr, 10) : 30);
+  const auto seed = static_cast<uint32_t>(
+      argc >= 6 ? std::strtoul(argv[5], nullptr, 10) : 1);
+
+  printf(
+      "[SNAPSHOT] %lu player(s), %u bullet(s) and %u wall(s), %.0f%% of the "
+      "parts and acknowledgements lost, acknowledged %u tick(s) late:\n",
+      players, kBullets, kWalls, loss * 100.0, delay);
+
+  const struct {
+    const char* label;
+    double moving;
+  } scenarios[] = {{"All moving:", 1.0}, {"A quarter:", 0.25}, {"Idle:", 0.0}};
+
+  uint64_t mismatched = 0;
+  for (const auto& scenario : scenarios) {
+    Room room{players, seed};
+    const auto result =
+        room.play(scenario.moving, loss, delay, seconds * kTickRate);
+    report(scenario.label, result, players);
+    mismatched += result.mismatched;
+  }
+
+  if (mismatched != 0) {
+    printf("[SNAPSHOT] %llu snapshot(s) did not decode to their view.\n",
+           static_cast<unsigned long long>(mismatched));
+    return EXIT_FAILURE;
+  }
+
+  printf("[SNAPSHOT] Every snapshot received decoded to its view.\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,25 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+#include "utils/Allocations.h"
+
+#if OBSTACLE_RUN_COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local size_t allocations = 0;
+}  // namespace
+
+void* operator new(size_t size) {
+  ++allocations;
+  if (auto* pointer = std::malloc(size == 0 ? 1 : size)) return pointer;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+
+size_t Allocations::count() noexcept { return allocations; }
+#else
+size_t Allocations::count() noexcept { return 0; }
+#endif
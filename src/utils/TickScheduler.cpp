@@ -0,0 +1,48 @@
+// Copyright (c) 2020 Antonio Román. All rights reserved.
+
+#include "utils/TickScheduler.h"
+
+#include <thread>
+
+TickScheduler::TickScheduler(uint32_t rate) noexcept
+    : interval_(std::chrono::duration_cast<clock::duration>(
+          std::chrono::duration<double>(1.0 / rate))),
+      next_(clock::now() + interval_) {}
+
+void TickScheduler::wait() noexcept {
+  const auto now = clock::now();
+  if (now >= next_) {
+    ++overruns_;
+    advance(now);
+    return;
+  }
+
+  if (next_ - now > kSpinMargin) {
+    std::this_thread::sleep_until(next_ - kSpinMargin);
+  }
+
+  while (clock::now() < next_) std::this_thread::yield();
+  advance(next_);
+}
+
+bool TickScheduler::poll() noexcept {
+  const auto now = clock::now();
+  if (now < next_) return false;
+
+  advance(now);
+  return true;
+}
+
+TickScheduler::clock::duration TickScheduler::remaining() const noexcept {
+  const auto now = clock::now();
+  return now < next_ ? next_ - now : clock::duration::zero();
+}
+
+void TickScheduler::advance(clock::time_point now) noexcept {
+  ++ticks_;
+
+  // The deadlines are a whole interval apart, regardless of when the tick
+  // actually ran, unless the loop fell too far behind to ever catch up:
+  next_ += interval_;
+  if (now - next_ > interval_ * kMaximumLag) next_ = now + interval_;
+}